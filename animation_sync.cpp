@@ -0,0 +1,355 @@
+#include "gdnet.h"
+
+//Blend values are scaled into [-1, 1] by the blend range and stored as signed 8 or 16 bit steps
+static void write_blend_value(MessageWriter &writer, float value, float blendRange, bool lod) {
+	float scaled = CLAMP(value / blendRange, -1.0f, 1.0f);
+	if(lod){
+		writer.write<int8_t>(static_cast<int8_t>(Math::round(scaled * INT8_MAX)));
+	}else{
+		writer.write<int16_t>(static_cast<int16_t>(Math::round(scaled * INT16_MAX)));
+	}
+}
+
+static float read_blend_value(MessageReader &reader, float blendRange, bool lod) {
+	if(lod){
+		int8_t steps = 0;
+		reader.read(steps);
+		return static_cast<float>(steps) / INT8_MAX * blendRange;
+	}
+
+	int16_t steps = 0;
+	reader.read(steps);
+	return static_cast<float>(steps) / INT16_MAX * blendRange;
+}
+
+AnimationSync::AnimationSync() {
+	m_animationTree = nullptr;
+	m_blendRange = 1.0f;
+	m_resolved = false;
+	m_pendingSends = 0;
+	m_sendCount = 0;
+}
+
+void AnimationSync::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_animation_tree"), &AnimationSync::get_animation_tree);
+	ClassDB::bind_method(D_METHOD("get_state_machines"), &AnimationSync::get_state_machines);
+	ClassDB::bind_method(D_METHOD("get_parameters"), &AnimationSync::get_parameters);
+	ClassDB::bind_method(D_METHOD("get_blend_range"), &AnimationSync::get_blend_range);
+	ClassDB::bind_method(D_METHOD("set_animation_tree", "animation_tree"), &AnimationSync::set_animation_tree);
+	ClassDB::bind_method(D_METHOD("set_state_machines", "state_machines"), &AnimationSync::set_state_machines);
+	ClassDB::bind_method(D_METHOD("set_parameters", "parameters"), &AnimationSync::set_parameters);
+	ClassDB::bind_method(D_METHOD("set_blend_range", "blend_range"), &AnimationSync::set_blend_range);
+
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "animation_tree", PROPERTY_HINT_RESOURCE_TYPE, "AnimationTree"), "set_animation_tree", "get_animation_tree");
+	//Playback parameters of the state machines to sync, e.g. "parameters/playback" or "parameters/Locomotion/playback"
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_STRING_ARRAY, "state_machines"), "set_state_machines", "get_state_machines");
+	//Float, Vector2 or bool tree parameters to sync, e.g. "parameters/Locomotion/Move/blend_position"
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_STRING_ARRAY, "parameters"), "set_parameters", "get_parameters");
+	//Blend values are expected to stay within [-blend_range, blend_range], anything outside of it gets clamped
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "blend_range", PROPERTY_HINT_RANGE, "0.01,100,0.01,or_greater"), "set_blend_range", "get_blend_range");
+}
+
+//===============Module===============//
+
+//Must be called from main thread only. Reads the state lists and parameter types out of the tree.
+bool AnimationSync::resolve_tree() {
+	if(m_resolved){
+		return true;
+	}
+
+	if(!m_animationTree || m_animationTree->get_tree_root().is_null()){
+		return false;
+	}
+
+	m_stateMachines.clear();
+	m_parameters.clear();
+
+	for(const String &playbackPath : m_stateMachinePaths){
+		//"parameters/Locomotion/playback" belongs to the Locomotion node of the tree root, "parameters/playback" to the root itself
+		Ref<AnimationNode> node = m_animationTree->get_tree_root();
+		PackedStringArray nodeNames = playbackPath.trim_prefix("parameters/").trim_suffix("playback").split("/", false);
+		for(int i = 0; i < nodeNames.size() && node.is_valid(); i++){
+			node = node->get_child_by_name(nodeNames[i]);
+		}
+
+		Ref<AnimationNodeStateMachine> stateMachine = node;
+		ERR_CONTINUE_MSG(stateMachine.is_null() || !playbackPath.ends_with("playback"), vformat("\"%s\" is not the playback of a state machine!", playbackPath));
+
+		//Sorted so every peer gives the states the same ids no matter what order they were added in
+		List<StringName> states;
+		stateMachine->get_node_list(&states);
+		states.sort_custom<StringName::AlphCompare>();
+
+		SyncedStateMachine_t syncedStateMachine;
+		syncedStateMachine.playbackPath = playbackPath;
+		for(const StringName &state : states){
+			syncedStateMachine.stateIds.insert(state, syncedStateMachine.states.size());
+			syncedStateMachine.states.push_back(state);
+		}
+		m_stateMachines.push_back(syncedStateMachine);
+	}
+
+	for(const String &parameterPath : m_parameterPaths){
+		Variant::Type type = m_animationTree->get(parameterPath).get_type();
+		ERR_CONTINUE_MSG(type != Variant::FLOAT && type != Variant::VECTOR2 && type != Variant::BOOL, vformat("Animation parameter \"%s\" has a type that cannot be synced!", parameterPath));
+
+		SyncedAnimationParameter_t parameter;
+		parameter.path = parameterPath;
+		parameter.type = type;
+		m_parameters.push_back(parameter);
+	}
+
+	m_resolved = true;
+	return true;
+}
+
+//Must be called from main thread only. Returns the size of the encoded snapshot, 0 if it didnt fit.
+int AnimationSync::encode_state(unsigned char *buffer, int capacity, bool lod) {
+	MessageWriter writer(buffer, capacity);
+
+	for(const SyncedStateMachine_t &stateMachine : m_stateMachines){
+		uint32_t stateIdx = 0U;
+		Ref<AnimationNodeStateMachinePlayback> playback = m_animationTree->get(stateMachine.playbackPath);
+		if(playback.is_valid()){
+			const uint32_t *stateId = stateMachine.stateIds.getptr(playback->get_current_node());
+			stateIdx = stateId ? *stateId + 1 : 0U;
+		}
+		writer.write_varint(stateIdx);
+	}
+
+	for(const SyncedAnimationParameter_t &parameter : m_parameters){
+		Variant value = m_animationTree->get(parameter.path);
+		switch(parameter.type){
+			case Variant::FLOAT:
+				write_blend_value(writer, value, m_blendRange, lod);
+				break;
+			case Variant::VECTOR2:{
+				Vector2 blendPosition = value;
+				write_blend_value(writer, blendPosition.x, m_blendRange, lod);
+				write_blend_value(writer, blendPosition.y, m_blendRange, lod);
+				break;
+			}
+			default:
+				writer.write_bool(value);
+				break;
+		}
+	}
+
+	return writer.has_overflowed() ? 0 : writer.get_size();
+}
+
+void AnimationSync::build_snapshot_update(EntityUpdateInfo_t &updateInfo, const LocalVector<uint8_t> &encodedState, uint8_t flags) {
+	unsigned char *payload = allocate_payload(updateInfo, 1 + encodedState.size());
+	payload[0] = flags;
+	memcpy(payload + 1, encodedState.ptr(), encodedState.size());
+
+	updateInfo.parentZone = m_parentNetworkEntity->m_info->m_entityInfo.parentZone;
+	updateInfo.networkId = m_parentNetworkEntity->m_info->m_entityInfo.networkId;
+	updateInfo.authorityEpoch = m_parentNetworkEntity->m_info->m_entityInfo.authorityEpoch;
+	updateInfo.updateType = ANIMATION_SYNC_UPDATE;
+}
+
+//The tree is sampled on the main thread (see SERVER_SIDE_sample_state), so all the tick has to do is send it
+void AnimationSync::tick() {
+	m_tickCount %= m_maxTickCount;
+
+	if(m_tickCount == 0 && GDNet::singleton->m_isServer){
+		std::lock_guard<std::mutex> lock(m_stateMutex);
+
+		//Every so often resend the snapshot, covering players that loaded the entity in after it last changed
+		if(++m_sendCount >= ANIMATION_SYNC_REFRESH_SENDS){
+			if(!m_encodedState.is_empty()){
+				m_pendingSends = MAX(m_pendingSends, 1);
+			}
+			m_sendCount = 0;
+		}
+
+		if(m_pendingSends > 0){
+			m_pendingSends--;
+
+			Zone *zone = m_parentNetworkEntity->m_parentZone;
+			EntityUpdateInfo_t updateInfo;
+			build_snapshot_update(updateInfo, m_encodedState, 0);
+			GDNet::singleton->world->queue_zone_broadcast(updateInfo, false);
+
+			//Viewers in neighbouring zones are far enough away that the coarse parameters will do
+			EntityUpdateInfo_t lodUpdateInfo;
+			bool lodBuilt = false;
+			for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : zone->m_playersInZone){
+				if(player.value->get_current_loaded_zone() == zone){
+					continue;
+				}
+
+				if(!lodBuilt){
+					build_snapshot_update(lodUpdateInfo, m_encodedLodState, ANIMATION_SYNC_FLAG_LOD);
+					lodBuilt = true;
+				}
+				GDNet::singleton->world->queue_entity_update(player.value->get_player_conn(), lodUpdateInfo);
+			}
+		}
+	}
+
+	m_tickCount++;
+}
+
+bool AnimationSync::build_update(EntityUpdateInfo_t &updateInfo) {
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+
+	if(m_encodedState.is_empty()){
+		return false;
+	}
+
+	build_snapshot_update(updateInfo, m_encodedState, 0);
+	return true;
+}
+
+//Must be called from main thread only
+bool AnimationSync::recieve_data(EntityUpdateInfo_t updateInfo) {
+	//Animation is server authoritative, clients never get to change it
+	if(GDNet::singleton->m_isServer || !resolve_tree()){
+		return false;
+	}
+
+	MessageReader reader(updateInfo.payload, updateInfo.payloadSize);
+	uint8_t flags = 0;
+	reader.read(flags);
+	bool lod = flags & ANIMATION_SYNC_FLAG_LOD;
+
+	//Read everything before touching the tree so a malformed update never gets half applied
+	uint32_t stateIdxs[MAX_ANIMATION_SYNC_STATE_MACHINES];
+	for(uint32_t i = 0; i < m_stateMachines.size(); i++){
+		reader.read_varint(stateIdxs[i]);
+	}
+
+	Variant values[MAX_ANIMATION_SYNC_PARAMETERS];
+	for(uint32_t i = 0; i < m_parameters.size(); i++){
+		switch(m_parameters[i].type){
+			case Variant::FLOAT:
+				values[i] = read_blend_value(reader, m_blendRange, lod);
+				break;
+			case Variant::VECTOR2:{
+				float x = read_blend_value(reader, m_blendRange, lod);
+				float y = read_blend_value(reader, m_blendRange, lod);
+				values[i] = Vector2(x, y);
+				break;
+			}
+			default:{
+				bool value = false;
+				reader.read_bool(value);
+				values[i] = value;
+				break;
+			}
+		}
+	}
+
+	if(reader.has_failed()){
+		return false;
+	}
+
+	for(uint32_t i = 0; i < m_stateMachines.size(); i++){
+		const SyncedStateMachine_t &stateMachine = m_stateMachines[i];
+		Ref<AnimationNodeStateMachinePlayback> playback = m_animationTree->get(stateMachine.playbackPath);
+		if(stateIdxs[i] == 0U || stateIdxs[i] > stateMachine.states.size() || playback.is_null()){
+			continue;
+		}
+
+		const StringName &state = stateMachine.states[stateIdxs[i] - 1];
+		if(!playback->is_playing()){
+			playback->start(state);
+			continue;
+		}
+
+		//Travel instead of jumping so the state machine's own transitions blend the change in
+		Vector<StringName> travelPath = playback->get_travel_path();
+		bool travelling = !travelPath.is_empty() && travelPath[travelPath.size() - 1] == state;
+		if(playback->get_current_node() != state && !travelling){
+			playback->travel(state);
+		}
+	}
+
+	for(uint32_t i = 0; i < m_parameters.size(); i++){
+		m_animationTree->set(m_parameters[i].path, values[i]);
+	}
+
+	return true;
+}
+
+//Must be called from main thread only
+void AnimationSync::reset() {
+	NetworkModule::reset();
+
+	//Forget the sent snapshot so a reused entity sends its animation again
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+	m_encodedState.clear();
+	m_encodedLodState.clear();
+	m_pendingSends = 0;
+	m_sendCount = 0;
+}
+
+//Must be called from main thread only. Snapshots the tree and marks it for sending if it changed since the last sample.
+void AnimationSync::SERVER_SIDE_sample_state() {
+	if(!resolve_tree()){
+		return;
+	}
+
+	//Leave room for the flags byte
+	unsigned char encoded[MAX_INBOUND_PAYLOAD_SIZE];
+	int encodedSize = encode_state(encoded, MAX_INBOUND_PAYLOAD_SIZE - 1, false);
+	if(encodedSize == 0){
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+
+	//Only the full snapshot decides whether anything changed, the coarse one just goes out alongside it
+	if(encodedSize == static_cast<int>(m_encodedState.size()) && memcmp(encoded, m_encodedState.ptr(), encodedSize) == 0){
+		return;
+	}
+
+	m_encodedState.resize(encodedSize);
+	memcpy(m_encodedState.ptr(), encoded, encodedSize);
+
+	int lodSize = encode_state(encoded, MAX_INBOUND_PAYLOAD_SIZE - 1, true);
+	m_encodedLodState.resize(lodSize);
+	memcpy(m_encodedLodState.ptr(), encoded, lodSize);
+
+	m_pendingSends = ANIMATION_SYNC_REDUNDANCY;
+	m_parentNetworkEntity->wake();
+}
+
+AnimationTree *AnimationSync::get_animation_tree() const {
+	return m_animationTree;
+}
+
+PackedStringArray AnimationSync::get_state_machines() const {
+	return m_stateMachinePaths;
+}
+
+PackedStringArray AnimationSync::get_parameters() const {
+	return m_parameterPaths;
+}
+
+float AnimationSync::get_blend_range() const {
+	return m_blendRange;
+}
+
+void AnimationSync::set_animation_tree(AnimationTree *animationTree) {
+	m_animationTree = animationTree;
+	m_resolved = false;
+}
+
+void AnimationSync::set_state_machines(const PackedStringArray &stateMachines) {
+	ERR_FAIL_COND_MSG(stateMachines.size() > MAX_ANIMATION_SYNC_STATE_MACHINES, vformat("An AnimationSync can sync at most %d state machines!", MAX_ANIMATION_SYNC_STATE_MACHINES));
+	m_stateMachinePaths = stateMachines;
+	m_resolved = false;
+}
+
+void AnimationSync::set_parameters(const PackedStringArray &parameters) {
+	ERR_FAIL_COND_MSG(parameters.size() > MAX_ANIMATION_SYNC_PARAMETERS, vformat("An AnimationSync can sync at most %d parameters!", MAX_ANIMATION_SYNC_PARAMETERS));
+	m_parameterPaths = parameters;
+	m_resolved = false;
+}
+
+void AnimationSync::set_blend_range(float blendRange) {
+	m_blendRange = MAX(blendRange, 0.01f);
+}
@@ -0,0 +1,72 @@
+#include "gdnet.h"
+
+ClockSync::ClockSync() {
+	reset();
+}
+
+void ClockSync::reset() {
+	m_sampleCount = 0;
+	m_nextSample = 0;
+	m_pingsSent = 0;
+	m_nextPingTime = 0;
+	m_offset.store(0);
+	m_roundTrip.store(0);
+	m_synced.store(false);
+}
+
+bool ClockSync::should_ping(SteamNetworkingMicroseconds now) {
+	if (now < m_nextPingTime) {
+		return false;
+	}
+
+	//Fill the sample window quickly at first so the estimate is usable right away
+	m_pingsSent++;
+	m_nextPingTime = now + (m_pingsSent < CLOCK_SYNC_SAMPLE_COUNT ? CLOCK_SYNC_FAST_INTERVAL_USEC : CLOCK_SYNC_INTERVAL_USEC);
+	return true;
+}
+
+void ClockSync::add_sample(SteamNetworkingMicroseconds pingSent, SteamNetworkingMicroseconds serverTime, SteamNetworkingMicroseconds pongRecieved) {
+	//Throw out anything that cant be right or spent too long in flight to say much about the offset
+	int64_t roundTrip = pongRecieved - pingSent;
+	if (roundTrip < 0 || roundTrip > CLOCK_SYNC_MAX_ROUND_TRIP_USEC) {
+		return;
+	}
+
+	//Assume the server read its clock halfway through the round trip
+	m_samples[m_nextSample].offset = serverTime - (pingSent + roundTrip / 2);
+	m_samples[m_nextSample].roundTrip = roundTrip;
+	m_nextSample = (m_nextSample + 1) % CLOCK_SYNC_SAMPLE_COUNT;
+	m_sampleCount = MIN(m_sampleCount + 1, CLOCK_SYNC_SAMPLE_COUNT);
+
+	//The sample with the shortest round trip had the least queueing delay in it, so its offset is the most trustworthy
+	int bestSample = 0;
+	int64_t roundTrips[CLOCK_SYNC_SAMPLE_COUNT];
+	for (int i = 0; i < m_sampleCount; i++) {
+		roundTrips[i] = m_samples[i].roundTrip;
+		if (m_samples[i].roundTrip < m_samples[bestSample].roundTrip) {
+			bestSample = i;
+		}
+	}
+
+	//The median keeps a single delayed ping from throwing off the reported round trip time
+	std::sort(roundTrips, roundTrips + m_sampleCount);
+	set_estimate(m_samples[bestSample].offset, roundTrips[m_sampleCount / 2]);
+}
+
+void ClockSync::set_estimate(int64_t offset, int64_t roundTrip) {
+	m_offset.store(offset, std::memory_order_relaxed);
+	m_roundTrip.store(roundTrip, std::memory_order_relaxed);
+	m_synced.store(true, std::memory_order_release);
+}
+
+int64_t ClockSync::get_offset() const {
+	return m_offset.load(std::memory_order_relaxed);
+}
+
+int64_t ClockSync::get_round_trip_time() const {
+	return m_roundTrip.load(std::memory_order_relaxed);
+}
+
+bool ClockSync::is_synced() const {
+	return m_synced.load(std::memory_order_acquire);
+}
@@ -2,4 +2,12 @@ def can_build(env, platform):
     return True
 
 def configure(env):
-    pass
\ No newline at end of file
+    pass
+
+def get_opts(platform):
+    from SCons.Variables import BoolVariable, PathVariable
+
+    return [
+        BoolVariable("gdnet_fuzz", "Build the libFuzzer harness for the server message parsers (clang only)", False),
+        PathVariable("gdnet_fuzz_runtime", "Path to libclang_rt.fuzzer_no_main (found through the compiler if left empty)", "", PathVariable.PathAccept),
+    ]
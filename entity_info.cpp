@@ -74,8 +74,8 @@ void EntityInfo::serialize_info() {
 
 	//Size the data buffer
 	// request type + name char len + name + path char len + path + parent zone id
-	// + entity id + network id + ass. player id
-	int bufferSize = 1 + (6 * sizeof(uint32_t)) + nameLen + pathLen + sizeof(Vector3) + sizeof(Vector2);
+	// + entity id + network id + ass. player id + authority epoch
+	int bufferSize = 1 + (6 * sizeof(uint32_t)) + 1 + nameLen + pathLen + sizeof(Vector3) + sizeof(Vector2);
 	m_entityInfo.dataBuffer.resize(bufferSize);
 
 	//Start an idx counter and keep note of 32 bit integer size (it should almost always be 4 bytes, idk why I did this)
@@ -91,10 +91,7 @@ void EntityInfo::serialize_info() {
 	bufferIdx += numericSize;
 
 	//Add the name string to the buffer
-	const char* nameData = name.get_data();
-	for(int i = 0; i < nameLen; i++){
-		m_entityInfo.dataBuffer.set(bufferIdx + i, static_cast<unsigned char>(nameData[i]));
-	}
+	memcpy(m_entityInfo.dataBuffer.ptrw() + bufferIdx, name.get_data(), nameLen);
 	bufferIdx += nameLen;
 
 	//Add the string lenthg of the entity relative path to the buffer
@@ -102,10 +99,7 @@ void EntityInfo::serialize_info() {
 	bufferIdx += numericSize;
 
 	//Add the path string to the buffer
-	const char* pathData = path.get_data();
-	for(int i = 0; i < pathLen; i++){
-		m_entityInfo.dataBuffer.set(bufferIdx + i, static_cast<unsigned char>(pathData[i]));
-	}
+	memcpy(m_entityInfo.dataBuffer.ptrw() + bufferIdx, path.get_data(), pathLen);
 	bufferIdx += pathLen;
 
 	//Add the parent zone id to the buffer
@@ -124,6 +118,10 @@ void EntityInfo::serialize_info() {
 	serialize_uint(m_entityInfo.owner, bufferIdx, m_entityInfo.dataBuffer);
 	bufferIdx += numericSize;
 
+	//Add the authority epoch to the buffer, so players loading the entity after a handoff start out on the right one
+	m_entityInfo.dataBuffer.set(bufferIdx, m_entityInfo.authorityEpoch);
+	bufferIdx += 1;
+
 	//Add the initial position 3D to the buffer
 	serialize_basic(m_entityInfo.initialPosition3D, bufferIdx, m_entityInfo.dataBuffer);
 	bufferIdx += sizeof(Vector3);
@@ -132,46 +130,50 @@ void EntityInfo::serialize_info() {
 	serialize_basic(m_entityInfo.initialPosition2D, bufferIdx, m_entityInfo.dataBuffer);
 }
 
-void EntityInfo::deserialize_info(const unsigned char *data) {
+bool EntityInfo::deserialize_info(const unsigned char *data, const int dataLen) {
 	//Clear the buffer
 	m_entityInfo.dataBuffer.clear();
-	int bufferIdx = 1;
-	std::size_t numericSize = sizeof(uint32_t);
+
+	//Every field is length checked against the message, so a malformed message just fails to deserialize
+	MessageReader reader(data, dataLen, 1);
+	int32_t nameLen;
+	int32_t pathLen;
+	const unsigned char *nameData;
+	const unsigned char *pathData;
+	const unsigned char *position3DData;
+	const unsigned char *position2DData;
 
 	//Get the entity name
-	int nameLen = deserialize_int(bufferIdx, data);
-	bufferIdx += numericSize;
-	m_entityInfo.entityName = deserialize_string(bufferIdx, nameLen, data);
-	bufferIdx += nameLen;
+	if(!reader.read(nameLen) || nameLen < 0 || !reader.read_bytes(nameData, nameLen)){
+		return false;
+	}
 
 	//Get the parent relative path
-	int pathLen = deserialize_int(bufferIdx, data);
-	bufferIdx += numericSize;
-	m_entityInfo.parentRelativePath = deserialize_string(bufferIdx, pathLen, data);
-	bufferIdx += pathLen;
-
-	//Get the parent zone id
-	m_entityInfo.parentZone = deserialize_uint(bufferIdx, data);
-	bufferIdx += numericSize;
+	if(!reader.read(pathLen) || pathLen < 0 || !reader.read_bytes(pathData, pathLen)){
+		return false;
+	}
 
-	//Get the entity id
-	m_entityInfo.entityId = deserialize_uint(bufferIdx, data);
-	bufferIdx += numericSize;
+	//Get the parent zone id, entity id, the entity's network id, the owner id and the authority epoch
+	reader.read(m_entityInfo.parentZone);
+	reader.read(m_entityInfo.entityId);
+	reader.read(m_entityInfo.networkId);
+	reader.read(m_entityInfo.owner);
+	reader.read(m_entityInfo.authorityEpoch);
 
-	//Get the entity's network id
-	m_entityInfo.networkId = deserialize_uint(bufferIdx, data);
-	bufferIdx += numericSize;
+	//Get the initial positions
+	reader.read_bytes(position3DData, sizeof(Vector3));
+	reader.read_bytes(position2DData, sizeof(Vector2));
 
-	//Get the owner id
-	m_entityInfo.owner = deserialize_uint(bufferIdx, data);
-	bufferIdx += numericSize;
+	if(reader.has_failed()){
+		return false;
+	}
 
-	//Get the initial position 3D
-	m_entityInfo.initialPosition3D = deserialize_basic<Vector3>(bufferIdx, data);
-	bufferIdx += sizeof(Vector3);
+	m_entityInfo.entityName = deserialize_string(0, nameLen, nameData);
+	m_entityInfo.parentRelativePath = deserialize_string(0, pathLen, pathData);
+	m_entityInfo.initialPosition3D = deserialize_basic<Vector3>(0, position3DData);
+	m_entityInfo.initialPosition2D = deserialize_basic<Vector2>(0, position2DData);
 
-	//Get the initial position 2D
-	m_entityInfo.initialPosition2D = deserialize_basic<Vector2>(bufferIdx, data);
+	return true;
 }
 
 //==================GETTERS AND SETTERS==================//
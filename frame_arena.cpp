@@ -0,0 +1,67 @@
+#include "gdnet.h"
+
+const size_t FrameArena::DEFAULT_CAPACITY = 64 * 1024;
+
+FrameArena::FrameArena() {
+	m_block = nullptr;
+	m_capacity = 0;
+	m_offset = 0;
+	m_requestedSize = 0;
+}
+
+FrameArena::~FrameArena() {
+	reset();
+
+	if (m_block) {
+		memfree(m_block);
+	}
+}
+
+unsigned char *FrameArena::allocate(size_t size) {
+	//Keep every allocation 16 byte aligned so any type can be serialized straight into it
+	size = (size + 15) & ~static_cast<size_t>(15);
+	m_requestedSize += size;
+
+	//Grab the block the first time this arena gets used on its thread
+	if (!m_block) {
+		m_capacity = MAX(DEFAULT_CAPACITY, size);
+		m_block = static_cast<unsigned char *>(memalloc(m_capacity));
+	}
+
+	//Bump allocate from the block while there is still room
+	if (m_offset + size <= m_capacity) {
+		unsigned char *allocation = m_block + m_offset;
+		m_offset += size;
+		return allocation;
+	}
+
+	//The block ran out for this frame. Fall back to the heap until the next reset, which grows the
+	//block to fit the demand so this only happens until the arena has warmed up.
+	unsigned char *allocation = static_cast<unsigned char *>(memalloc(size));
+	m_overflowAllocations.push_back(allocation);
+	return allocation;
+}
+
+void FrameArena::reset() {
+	//Release everything that didnt fit in the block this frame
+	for (unsigned char *allocation : m_overflowAllocations) {
+		memfree(allocation);
+	}
+
+	//Grow the block so the overflow wont happen again
+	if (m_overflowAllocations.size() > 0) {
+		m_overflowAllocations.clear();
+
+		memfree(m_block);
+		m_capacity = next_power_of_2(static_cast<unsigned int>(m_requestedSize));
+		m_block = static_cast<unsigned char *>(memalloc(m_capacity));
+	}
+
+	m_offset = 0;
+	m_requestedSize = 0;
+}
+
+FrameArena &FrameArena::get_thread_arena() {
+	static thread_local FrameArena s_threadArena;
+	return s_threadArena;
+}
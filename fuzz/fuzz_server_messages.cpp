@@ -0,0 +1,68 @@
+#include "../gdnet.h"
+#include "core/os/os.h"
+
+//libFuzzer harness for the parsers that see raw client bytes on the server. Only built with gdnet_fuzz=yes.
+//The engine has its own main, so libFuzzer gets linked without one and is started from the module instead:
+//	godot --headless -- --gdnet-fuzz <libFuzzer args, e.g. a corpus directory>
+
+extern "C" int LLVMFuzzerRunDriver(int *argc, char ***argv, int (*callback)(const uint8_t *data, size_t size));
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if(size > static_cast<size_t>(INT32_MAX)){
+		return 0;
+	}
+	const unsigned char *mssgData = data;
+	const int mssgLen = static_cast<int>(size);
+
+	//State frames, read the same way SERVER_SIDE_handle_entity_update does
+	EntityUpdateInfo_t updateInfo;
+	int dataIdx = StateFrameBuilder::HEADER_SIZE;
+	while(dataIdx < mssgLen && StateFrameBuilder::read_update(mssgData, mssgLen, dataIdx, updateInfo)){
+		//The payload has to stay inside the message
+		CRASH_COND(updateInfo.payload < mssgData || updateInfo.payload + updateInfo.payloadSize > mssgData + mssgLen);
+	}
+
+	//Entity creation requests
+	Ref<EntityInfo> entityInfo;
+	entityInfo.instantiate();
+	entityInfo->deserialize_info(mssgData, mssgLen);
+
+	//Typed values, as they show up in rpc batches and property updates. The first byte picks the type.
+	if(mssgLen > 0 && mssgData[0] < Variant::VARIANT_MAX && is_codec_supported_type(static_cast<Variant::Type>(mssgData[0]))){
+		MessageReader reader(mssgData, mssgLen, 1);
+		Variant value;
+		int remaining;
+		do{
+			remaining = reader.get_remaining();
+		}while(remaining > 0 && decode_typed_value(reader, static_cast<Variant::Type>(mssgData[0]), value) && reader.get_remaining() < remaining);
+	}
+
+	return 0;
+}
+
+//Call this once the module classes are registered. Runs libFuzzer with everything after --gdnet-fuzz and returns its exit code.
+int gdnet_run_fuzzer() {
+	List<String> userArgs = OS::get_singleton()->get_cmdline_user_args();
+
+	//libFuzzer wants argv[0] to be the program
+	LocalVector<CharString> args;
+	args.push_back(OS::get_singleton()->get_executable_path().utf8());
+	bool fuzzArgs = false;
+	for(const String &arg : userArgs){
+		if(fuzzArgs){
+			args.push_back(arg.utf8());
+		}else if(arg == "--gdnet-fuzz"){
+			fuzzArgs = true;
+		}
+	}
+
+	LocalVector<char *> argv;
+	for(CharString &arg : args){
+		argv.push_back(arg.ptrw());
+	}
+	argv.push_back(nullptr);
+
+	int argc = args.size();
+	char **argvPtr = argv.ptr();
+	return LLVMFuzzerRunDriver(&argc, &argvPtr, LLVMFuzzerTestOneInput);
+}
@@ -10,6 +10,7 @@ GDNet::GDNet() {
 	m_isInitialized = false;
 	m_isClient = false;
 	m_isServer = false;
+	m_headlessServer = false;
 }
 
 GDNet::~GDNet() {
@@ -18,6 +19,7 @@ GDNet::~GDNet() {
 
 void GDNet::cleanup() {
 	world->cleanup();
+	clear_entity_pools();
 }
 
 void GDNet::_bind_methods() {
@@ -26,6 +28,9 @@ void GDNet::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_world_singleton"), &GDNet::get_world_singleton);
 	ClassDB::bind_method(D_METHOD("is_client"), &GDNet::is_client);
 	ClassDB::bind_method(D_METHOD("is_server"), &GDNet::is_server);
+	ClassDB::bind_method(D_METHOD("is_headless_server"), &GDNet::is_headless_server);
+	ClassDB::bind_method(D_METHOD("set_headless_server", "headless_server"), &GDNet::set_headless_server);
+	ClassDB::bind_method(D_METHOD("configure_entity_pool", "entity_name", "warmup_count", "max_count"), &GDNet::configure_entity_pool);
 }
 
 bool GDNet::register_network_entities() {
@@ -73,6 +78,16 @@ bool GDNet::register_network_entities() {
 					info.id = info.name.hash();
 					info.scene = network_entity_scene;
 
+					//Cache the sync module setup so a headless server can relay the entity without instantiating it
+					NetworkEntity *rootEntity = Object::cast_to<NetworkEntity>(root_node);
+					info.serverLogic = rootEntity->get_server_logic();
+					if(rootEntity->get_transform2d_sync().is_valid()){
+						info.transform2DTickInterval = rootEntity->get_transform2d_sync()->get_tick_interval();
+					}
+					if(rootEntity->get_transform3d_sync().is_valid()){
+						info.transform3DTickInterval = rootEntity->get_transform3d_sync()->get_tick_interval();
+					}
+
 					//Make sure the name hash is not already a key in the hashmap (dublicate name value)
 					if(m_networkEntityRegistry.has(info.id)){
 						ERR_PRINT(vformat("ERROR: Cannot have two entites with the name '%s'!", info.name));
@@ -93,6 +108,15 @@ bool GDNet::register_network_entities() {
 	return true;
 }
 
+void GDNet::clear_entity_pools() {
+	for(KeyValue<EntityID_t, NetworkEntityInfo_t> &element : m_networkEntityRegistry){
+		for(NetworkEntity *instance : element.value.pooledInstances){
+			memdelete(instance);
+		}
+		element.value.pooledInstances.clear();
+	}
+}
+
 World *GDNet::get_world_singleton() {
 	return world;
 }
@@ -149,6 +173,20 @@ bool GDNet::is_server() {
 	return m_isServer;
 }
 
+bool GDNet::is_headless_server() {
+	return m_headlessServer;
+}
+
+void GDNet::set_headless_server(bool headlessServer) {
+	//Zones that were already instantiated wouldnt be able to switch over
+	if(m_isServer){
+		ERR_PRINT("Cannot change headless mode while a world is being hosted!");
+		return;
+	}
+
+	m_headlessServer = headlessServer;
+}
+
 bool GDNet::zone_exists(ZoneID_t zoneId) {
 	return m_zoneRegistry.find(zoneId) != m_zoneRegistry.end();
 }
@@ -167,4 +205,82 @@ EntityID_t GDNet::get_entity_id_by_name(String entityName) {
 	return 0;
 }
 
+static NetworkEntity *instantiate_entity(const NetworkEntityInfo_t &entityInfo) {
+	Node *instance = entityInfo.scene->instantiate();
+	NetworkEntity *instanceAsEntity = Object::cast_to<NetworkEntity>(instance);
+	if(!instanceAsEntity){
+		ERR_PRINT(vformat("Scene for network entity '%s' does not have a NetworkEntity root!", entityInfo.name));
+		memdelete(instance);
+		return nullptr;
+	}
+
+	return instanceAsEntity;
+}
+
+bool GDNet::configure_entity_pool(String entityName, int warmupCount, int maxCount) {
+	EntityID_t entityId = get_entity_id_by_name(entityName);
+	NetworkEntityInfo_t *entityInfo = m_networkEntityRegistry.getptr(entityId);
+	if(!entityInfo){
+		ERR_PRINT(vformat("Cannot configure pool, no network entity named '%s' is registered!", entityName));
+		return false;
+	}
+
+	entityInfo->poolMax = MAX(maxCount, 0);
+	warmupCount = CLAMP(warmupCount, 0, static_cast<int>(entityInfo->poolMax));
 
+	//Shrink the pool if the new maximum is smaller than what is already in it
+	while(entityInfo->pooledInstances.size() > entityInfo->poolMax){
+		memdelete(entityInfo->pooledInstances[entityInfo->pooledInstances.size() - 1]);
+		entityInfo->pooledInstances.remove_at(entityInfo->pooledInstances.size() - 1);
+	}
+
+	//Reserve the full pool up front so releasing an instance never has to grow it
+	entityInfo->pooledInstances.reserve(entityInfo->poolMax);
+
+	//Instantiate the warm up instances now rather than during gameplay
+	while(static_cast<int>(entityInfo->pooledInstances.size()) < warmupCount){
+		NetworkEntity *instance = instantiate_entity(*entityInfo);
+		if(!instance){
+			return false;
+		}
+		entityInfo->pooledInstances.push_back(instance);
+	}
+
+	return true;
+}
+
+NetworkEntity *GDNet::acquire_entity_instance(EntityID_t entityId) {
+	NetworkEntityInfo_t *entityInfo = m_networkEntityRegistry.getptr(entityId);
+	if(!entityInfo){
+		ERR_PRINT(vformat("No network entity with ID %d is registered!", entityId));
+		return nullptr;
+	}
+
+	//Reuse a despawned instance if there is one
+	if(!entityInfo->pooledInstances.is_empty()){
+		NetworkEntity *instance = entityInfo->pooledInstances[entityInfo->pooledInstances.size() - 1];
+		entityInfo->pooledInstances.remove_at(entityInfo->pooledInstances.size() - 1);
+
+		//Ready only runs once per node unless its asked for again
+		instance->request_ready();
+		return instance;
+	}
+
+	return instantiate_entity(*entityInfo);
+}
+
+void GDNet::release_entity_instance(EntityID_t entityId, NetworkEntity *instance) {
+	//Take the instance out of the scene, but keep it alive so it can be reused
+	if(instance->get_parent()){
+		instance->get_parent()->remove_child(instance);
+	}
+
+	NetworkEntityInfo_t *entityInfo = m_networkEntityRegistry.getptr(entityId);
+	if(entityInfo && entityInfo->pooledInstances.size() < entityInfo->poolMax){
+		//Wipe everything the last spawn left behind so the instance comes back out like a fresh one
+		instance->reset_for_reuse();
+		entityInfo->pooledInstances.push_back(instance);
+	}else{
+		instance->queue_free();
+	}
+}
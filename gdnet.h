@@ -2,8 +2,10 @@
 #define GDNET_H
 
 #include "core/object/ref_counted.h"
+#include "core/object/worker_thread_pool.h"
 #include "core/templates/hash_map.h"
 #include "core/templates/list.h"
+#include "core/templates/local_vector.h"
 #include "core/templates/vector.h"
 #include "core/math/transform_2d.h"
 #include "core/math/transform_3d.h"
@@ -11,14 +13,21 @@
 #include "include/steam/isteamnetworkingutils.h"
 #include "include/steam/steamnetworkingsockets.h"
 #include "scene/main/node.h"
+#include "scene/main/scene_tree.h"
 #include "scene/3d/node_3d.h"
+#include "scene/animation/animation_node_state_machine.h"
+#include "scene/animation/animation_tree.h"
 #include "scene/2d/node_2d.h"
 #include "scene/resources/packed_scene.h"
+#include "scene/resources/shape_2d.h"
+#include "scene/resources/shape_3d.h"
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <stack>
 #include <thread>
 #include <mutex>
+#include <type_traits>
 #include <unordered_set>
 
 //===============Data and Types===============//
@@ -33,15 +42,95 @@
 
 #define CREATE_ZONE_PLAYER_INFO_REQUEST static_cast<unsigned char>(0x07)
 #define CREATE_ZONE_PLAYER_INFO_ACKNOWLEDGE static_cast<unsigned char>(0x08)
+#define SET_ACTIVE_ZONE static_cast<unsigned char>(0x09)
+#define CLOCK_SYNC_PING static_cast<unsigned char>(0x0A)
+#define CLOCK_SYNC_PONG static_cast<unsigned char>(0x0B)
 
 #define CREATE_ENTITY_REQUEST static_cast<unsigned char>(0x10)
 #define CREATE_ENTITY_DENY static_cast<unsigned char>(0x11)
 #define CREATE_ENTITY_ACKNOWLEDGE static_cast<unsigned char>(0x12)
 #define CREATE_ENTITY_COMPLETE static_cast<unsigned char>(0x13)
+#define ENTITY_MIGRATED static_cast<unsigned char>(0x14)
+#define ENTITY_OWNERSHIP_TRANSFERRED static_cast<unsigned char>(0x15)
+
+#define RPC_BATCH static_cast<unsigned char>(0x20)
 
 #define NETWORK_ENTITY_UPDATE static_cast<unsigned char>(0x30)
 #define TRANSFORM3D_SYNC_UPDATE static_cast<unsigned char>(0x31)
 #define TRANSFORM2D_SYNC_UPDATE static_cast<unsigned char>(0x32)
+#define PROPERTY_SYNC_UPDATE static_cast<unsigned char>(0x33)
+#define PROPERTY_SYNC_OWNER_UPDATE static_cast<unsigned char>(0x34)
+#define ANIMATION_SYNC_UPDATE static_cast<unsigned char>(0x35)
+
+//Connection Lanes (each connection is split into these lanes so state sync and control traffic never wait behind reliable messages)
+//Lane 0 carries the most messages, so it is used for state sync to avoid the per message lane overhead on the wire.
+//Reliable messages are only ordered within a lane, so messages that depend on each other (zone players, the entity
+//lifecycle: creation, migration, ownership, players leaving, and the rpcs that target those entities) all go down the
+//gameplay lane on purpose. A zone join burst can hold up the joining player's rpcs until their entities exist, which
+//they would need anyway. Lanes are per connection, so nobody else waits on it.
+#define LANE_STATE_SYNC static_cast<MessageLane_t>(0)
+#define LANE_CONTROL static_cast<MessageLane_t>(1)
+#define LANE_GAMEPLAY static_cast<MessageLane_t>(2)
+#define LANE_COUNT 3
+
+//Largest state frame that gets built before it is sent off. Staying under the path MTU keeps the
+//library from fragmenting unreliable state frames (losing one fragment would lose the whole frame).
+#define STATE_FRAME_MTU 1200
+
+//Largest module payload that can be handed from the network thread to the main thread
+#define MAX_INBOUND_PAYLOAD_SIZE 128
+//Time each zone gets per frame for spawning and despawning entities (in microseconds)
+#define DEFAULT_SPAWN_BUDGET_USEC 2000
+//Neighbouring zones a player is loaded into get every n-th entity update
+#define DEFAULT_NEIGHBOR_ZONE_UPDATE_INTERVAL 4
+//Network ticks an entity can go without changes before it goes dormant (0 keeps it awake)
+#define DEFAULT_DORMANCY_TICKS 1000
+//How far back (in seconds) the server keeps entity positions around for lag compensation
+#define DEFAULT_REWIND_HISTORY_DURATION 1.0f
+
+//Dead reckoning defaults. Updates are skipped while the prediction stays within the threshold, but never for longer than the max silence.
+#define DEFAULT_DEAD_RECKONING_THRESHOLD 0.1f
+#define DEAD_RECKONING_ROTATION_THRESHOLD 0.05f //Radians
+#define DEFAULT_DEAD_RECKONING_MAX_SILENCE 1.0f //Seconds
+
+//Property sync. Changed properties go out in this many sends in a row so a lost update doesnt leave them stale,
+//and every property gets resent every so often for players that loaded the entity in later.
+#define MAX_SYNCED_PROPERTIES 64
+#define PROPERTY_SYNC_REDUNDANCY 3
+#define PROPERTY_SYNC_REFRESH_SENDS 40
+
+//Animation sync. Blend parameters are quantized to 16 bits, or to 8 bits for viewers in neighbouring zones.
+//Changes are sent redundantly and everything gets refreshed every so often, the same as property sync.
+#define MAX_ANIMATION_SYNC_STATE_MACHINES 8
+#define MAX_ANIMATION_SYNC_PARAMETERS 16
+#define ANIMATION_SYNC_REDUNDANCY 3
+#define ANIMATION_SYNC_REFRESH_SENDS 40
+#define ANIMATION_SYNC_FLAG_LOD 0x1 //Parameters were quantized to 8 bits
+
+//Rpc calls bound for a connection are batched into messages of up to this size and sent once per tick
+#define RPC_BATCH_MTU STATE_FRAME_MTU
+//Largest single rpc call that can be encoded (in bytes)
+#define MAX_RPC_SIZE 65536
+//Rpc entry flags
+#define RPC_FLAG_ENTITY 0x1 //Targets an entity instead of a zone
+
+//How many entity modules can have an update waiting for the main thread at once (must be a power of 2)
+#define INBOUND_UPDATE_QUEUE_SIZE 8192
+//How many recieved rpc batches can wait for the main thread at once, batches past that are dropped (must be a power of 2)
+#define INBOUND_RPC_QUEUE_SIZE 1024
+
+//How many messages the client takes off the connection per recieve call
+#define DEFAULT_RECEIVE_BATCH_SIZE 64
+#define MAX_RECEIVE_BATCH_SIZE 256
+//Longest the client listen thread sleeps when nothing is coming in (in microseconds)
+#define MAX_RECEIVE_IDLE_SLEEP_USEC 2000
+
+//Clock sync. The first few pings go out quickly so the clock settles right after joining, then they slow down.
+#define CLOCK_SYNC_SAMPLE_COUNT 8
+#define CLOCK_SYNC_FAST_INTERVAL_USEC 100000
+#define CLOCK_SYNC_INTERVAL_USEC 1000000
+//Samples that took longer than this to make the round trip are thrown out
+#define CLOCK_SYNC_MAX_ROUND_TRIP_USEC 2000000
 
 using PlayerID_t = uint32_t;
 using EntityNetworkID_t = uint32_t ;
@@ -49,6 +138,7 @@ using EntityID_t = uint32_t;
 using ZoneID_t = uint32_t;
 using PropertyID_t = uint32_t;
 using MessageType_t = uint8_t ;
+using MessageLane_t = uint16_t;
 
 //Forward declarations
 class Zone;
@@ -57,6 +147,8 @@ class EntityInfo;
 class NetworkEntity;
 class Transform3DSync;
 class Transform2DSync;
+class PropertySync;
+class AnimationSync;
 struct ZoneInfo_t;
 
 //Enum Declarations
@@ -66,26 +158,54 @@ enum SyncAuthority{
 	SERVER_AUTHORITATIVE
 };
 
+//Reasons the server can reject a message recieved from a client
+enum MessageRejection{
+	REJECTION_NONE,
+	REJECTION_MALFORMED,
+	REJECTION_UNKNOWN_TYPE,
+	REJECTION_UNKNOWN_PLAYER,
+	REJECTION_UNKNOWN_ZONE,
+	REJECTION_UNKNOWN_ENTITY,
+	REJECTION_UNAUTHORIZED,
+	REJECTION_COUNT
+};
+
 //Enum registrations
 VARIANT_ENUM_CAST(SyncAuthority)
+VARIANT_ENUM_CAST(MessageRejection)
+
+//Load state of a player in one of the zones they are loaded into
+struct ZoneSubscription_t {
+	Zone* zone;
+	//Server-side relavent info only
+	bool loadedPlayersInZone;
+	bool loadedEntitiesInZone;
+	List<EntityNetworkID_t> entitiesWaitingForLoadAck;
+	List<PlayerID_t> playersWaitingForLoadAck;
+};
 
 //This struct is used for server side data storage only
 struct PlayerInfo_t {
 	PlayerID_t id;
+	//The zone the player is actually in. The other loaded zones (neighbours) are kept warm at a lower update rate.
 	Zone* currentLoadedZone;
+	HashMap<ZoneID_t, ZoneSubscription_t> loadedZones;
 	HashMap<EntityNetworkID_t, Ref<EntityInfo>> ownedEntities;
 	//Server-side relavent info only
 	HSteamNetConnection playerConnection; // Connection Handle
-	bool loadedPlayersInZone;
-	bool loadedEntitiesInZone;
-	List<EntityNetworkID_t> entitiesWaitingForLoadAck;
-	List<PlayerID_t> playersWaitingForLoadAck;
 };
 
 struct NetworkEntityInfo_t {
 	EntityID_t id;
 	String name;
 	Ref<PackedScene> scene;
+	//Despawned instances waiting to be reused (main thread only). Pooling is off until configured for the type.
+	LocalVector<NetworkEntity *> pooledInstances;
+	uint32_t poolMax;
+	//Cached from the scene at registration so a headless server can run the entity without instantiating it
+	bool serverLogic;
+	int transform2DTickInterval; //0 if the entity has no Transform2DSync
+	int transform3DTickInterval; //0 if the entity has no Transform3DSync
 };
 
 struct ZoneInfo_t {
@@ -101,6 +221,12 @@ struct EntityInfo_t {
 	EntityID_t entityId;
 	EntityNetworkID_t networkId;
 	PlayerID_t owner;
+	//Goes up every time the entity changes owner. Updates carry the epoch they were sent under, so ones the previous
+	//owner sent before the handoff can be told apart from the new owner's and dropped.
+	uint8_t authorityEpoch;
+	//Inbound update sequence at the time the entity was created. Anything queued up to it was sent to an earlier
+	//entity that had the same network id, so it gets dropped instead of applied to this one.
+	uint64_t inboundSequence;
 	Vector3 initialPosition3D;
 	Vector2 initialPosition2D;
 	Vector<unsigned char> dataBuffer;
@@ -108,13 +234,250 @@ struct EntityInfo_t {
 	NetworkEntity *entityInstance;
 };
 
+//Holds a single module update. The payload only carries the module data, the metadata gets written into
+//the state frame the update is packed into. Outgoing payloads live in the thread's frame arena and incoming
+//payloads point straight into the recieved message, so they are only valid until the tick/recieve batch ends.
 struct EntityUpdateInfo_t{
 	ZoneID_t parentZone;
 	EntityNetworkID_t networkId;
 	unsigned char updateType;
-	Vector<unsigned char> dataBuffer;
+	uint8_t authorityEpoch;
+	const unsigned char *payload;
+	int payloadSize;
+};
+
+//Where an entity was on a past physics frame. 2D entities have a z of 0.
+struct RewindEntry_t{
+	EntityNetworkID_t networkId;
+	Vector3 position;
+};
+
+//Every entity position in a zone on one physics frame, tagged with the server time it was recorded at (the same
+//clock World.get_server_time() reads, so clients can say when they saw something). Frames are reused once the
+//history wraps around, so the entries keep their capacity.
+struct RewindFrame_t{
+	SteamNetworkingMicroseconds time;
+	LocalVector<RewindEntry_t> entries;
+};
+
+//Shape to test rewound positions against. Points are moved into shape space first, so boxes can be rotated.
+struct RewindShape_t{
+	Transform3D inverseTransform;
+	Vector3 halfExtents; //Box only
+	real_t radius; //Sphere only
+	bool box;
+};
+
+//Data record standing in for a sync module of an entity that was not instantiated on a headless server.
+//Holds the latest payload recieved for the module, which gets relayed to the zone at the module's rate.
+struct HeadlessEntity_t{
+	EntityNetworkID_t networkId;
+	unsigned char updateType;
+	uint8_t authorityEpoch;
+	uint8_t payloadSize;
+	int tickCount;
+	int tickInterval;
+	unsigned char payload[MAX_INBOUND_PAYLOAD_SIZE];
+};
+
+//===============Binary Codec===============//
+//Everything goes over the wire little-endian. Values are moved with a single (unaligned safe) memcpy and
+//only get byte swapped on big-endian targets.
+
+template<typename T>
+inline T codec_byte_order(T value){
+	static_assert(std::is_arithmetic<T>::value, "Only arithmetic types have a byte order!");
+#ifdef BIG_ENDIAN_ENABLED
+	if constexpr (sizeof(T) == 2) {
+		uint16_t bits;
+		memcpy(&bits, &value, sizeof(T));
+		bits = BSWAP16(bits);
+		memcpy(&value, &bits, sizeof(T));
+	} else if constexpr (sizeof(T) == 4) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(T));
+		bits = BSWAP32(bits);
+		memcpy(&value, &bits, sizeof(T));
+	} else if constexpr (sizeof(T) == 8) {
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(T));
+		bits = BSWAP64(bits);
+		memcpy(&value, &bits, sizeof(T));
+	}
+#endif
+	return value;
+}
+
+inline uint64_t zigzag_encode(int64_t value){
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value){
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+//Writes into a caller owned buffer. Writes past the end of the buffer are dropped and mark the writer as overflowed
+//instead of corrupting memory, so callers only have to check once at the end.
+class MessageWriter {
+private:
+	unsigned char *m_buffer;
+	int m_capacity;
+	int m_size;
+	bool m_overflowed;
+
+	//Consecutive bools get packed into a shared byte
+	int m_bitByteIdx;
+	int m_bitCount;
+
+	unsigned char *reserve(int size);
+
+public:
+	MessageWriter(unsigned char *buffer, int capacity);
+
+	template<typename T>
+	void write(T value){
+		unsigned char *dest = reserve(sizeof(T));
+		if(dest){
+			value = codec_byte_order(value);
+			memcpy(dest, &value, sizeof(T));
+		}
+	}
+
+	void write_bytes(const void *data, int size);
+	void write_varint(uint64_t value);
+	void write_zigzag(int64_t value);
+	void write_bool(bool value);
+	void write_string(const String &value);
+
+	int get_size() const;
+	bool has_overflowed() const;
+};
+
+//Reads straight out of a message buffer without copying. Every read is bounds checked, and once a read fails
+//every read after it fails too, so a whole message can be parsed before checking for errors once.
+class MessageReader {
+private:
+	const unsigned char *m_buffer;
+	int m_size;
+	int m_idx;
+	bool m_failed;
+
+	//Consecutive bools are packed into a shared byte
+	int m_bitByteIdx;
+	int m_bitCount;
+
+	const unsigned char *consume(int size);
+
+public:
+	MessageReader(const unsigned char *buffer, int size, int startIdx = 0);
+
+	template<typename T>
+	bool read(T &value){
+		const unsigned char *src = consume(sizeof(T));
+		if(!src){
+			return false;
+		}
+		memcpy(&value, src, sizeof(T));
+		value = codec_byte_order(value);
+		return true;
+	}
+
+	bool read_bytes(const unsigned char *&data, int size);
+	bool read_varint(uint64_t &value);
+	bool read_varint(uint32_t &value);
+	bool read_zigzag(int64_t &value);
+	bool read_bool(bool &value);
+	bool read_string(String &value);
+	bool skip(int size);
+
+	int get_position() const;
+	int get_remaining() const;
+	bool has_failed() const;
 };
 
+//Binary codecs for engine values, used where both ends know the type up front (synced properties, rpc arguments)
+bool is_codec_supported_type(Variant::Type type);
+bool encode_typed_value(MessageWriter &writer, Variant::Type type, const Variant &value);
+bool decode_typed_value(MessageReader &reader, Variant::Type type, Variant &value);
+
+//===============SPSC Queue===============//
+
+//Lock free, fixed capacity queue with a single producer thread and a single consumer thread.
+template<typename T, uint32_t Capacity>
+class SPSCQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of 2!");
+	static_assert(std::is_trivially_copyable<T>::value, "SPSCQueue only holds plain data!");
+
+private:
+	T m_items[Capacity];
+
+	//Keep the indices on seperate cache lines so the two threads dont fight over them
+	alignas(64) std::atomic<uint32_t> m_head{0};
+	alignas(64) std::atomic<uint32_t> m_tail{0};
+
+public:
+	//Producer only. Returns false (and drops the item) if the queue is full.
+	bool push(const T &item){
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		if(tail - m_head.load(std::memory_order_acquire) == Capacity){
+			return false;
+		}
+
+		m_items[tail & (Capacity - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer only. Returns false if the queue is empty.
+	bool pop(T &item){
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		if(head == m_tail.load(std::memory_order_acquire)){
+			return false;
+		}
+
+		item = m_items[head & (Capacity - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+//===============Update Mailbox===============//
+
+//Latest-wins slot for one module of one entity. The network thread keeps overwriting it and the main thread
+//takes whatever is newest once per frame, so older updates that were never applied just get skipped.
+//Property updates only carry the properties that changed, so those get merged into the newer update instead.
+//Triple buffered so neither side ever waits on the other.
+class UpdateMailbox {
+private:
+	struct Slot {
+		ZoneID_t parentZone;
+		uint64_t sequence;
+		uint8_t authorityEpoch;
+		uint8_t payloadSize;
+		unsigned char payload[MAX_INBOUND_PAYLOAD_SIZE];
+	};
+
+	static const uint8_t SLOT_FRESH = 0x4;
+
+	Slot m_slots[3];
+	uint8_t m_writeSlot; //Network thread only
+	uint8_t m_readSlot; //Main thread only
+	std::atomic<uint8_t> m_sharedSlot; //Slot index that gets swapped between the threads (+ SLOT_FRESH if it has not been taken yet)
+	std::atomic<bool> m_queued;
+
+	EntityNetworkID_t m_networkId;
+	unsigned char m_updateType;
+
+public:
+	UpdateMailbox(EntityNetworkID_t networkId, unsigned char updateType);
+
+	//Network thread. Returns true if the mailbox just became dirty and has to be queued for the main thread.
+	bool post(const EntityUpdateInfo_t &updateInfo, uint64_t sequence);
+	//Network thread. Marks the mailbox clean again when it could not be queued.
+	void cancel_queued();
+	//Main thread. Fills in the newest update and the sequence it was posted with, returns false if there was nothing new.
+	bool take(EntityUpdateInfo_t &updateInfo, uint64_t &sequence);
+};
 
 //===============Messaging===============//
 SteamNetworkingMessage_t *allocate_message(const unsigned char *data, const int sizeOfData, const HSteamNetConnection &destination);
@@ -122,12 +485,14 @@ SteamNetworkingMessage_t *create_mini_message(MessageType_t messageType, unsigne
 SteamNetworkingMessage_t *create_small_message(MessageType_t messageType, unsigned int value1, unsigned int value2, const HSteamNetConnection &destination);
 //SteamNetworkingMessage_t *instantiate_entity_message(const EntityID_t entityID, String parentNode, const HSteamNetConnection &destination);
 
+int serialize_varint(uint32_t value, unsigned char *buffer);
 void serialize_int(int value, int startIdx, Vector<unsigned char> &buffer);
 void serialize_uint(unsigned int value, int startIdx, Vector<unsigned char> &buffer);
 //TODO: Implement - void serialize_string();
 void serialize_vector3(const Vector3 &vec, int startIdx, Vector<unsigned char> &buffer);
 void serialize_vector2(const Vector2 &vec, int startIdx, Vector<unsigned char> &buffer);
 void serialize_transform3d(const Transform3D &transform, int startIdx, Vector<unsigned char> &buffer);
+void serialize_transform3d(const Transform3D &transform, int startIdx, unsigned char *buffer);
 void serialize_transform2d(const Transform2D &transform, int startIdx, Vector<unsigned char> &buffer);
 
 template<typename T>
@@ -135,6 +500,23 @@ void serialize_basic(const T &value, int startIdx, Vector<unsigned char> &buffer
 	memcpy(buffer.ptrw() + startIdx, &value, sizeof(T));
 }
 
+template<typename T>
+void serialize_basic(const T &value, int startIdx, unsigned char *buffer){
+	memcpy(buffer + startIdx, &value, sizeof(T));
+}
+
+//Bounds checked variant, returns false instead of writing past the end of the buffer
+template<typename T>
+bool serialize_basic(const T &value, int startIdx, unsigned char *buffer, int bufferLen){
+	static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be serialized directly!");
+	if(startIdx < 0 || bufferLen - startIdx < static_cast<int>(sizeof(T))){
+		return false;
+	}
+
+	memcpy(buffer + startIdx, &value, sizeof(T));
+	return true;
+}
+
 template<typename T>
 T deserialize_basic(int startIdx, const unsigned char *buffer){
 	T incomingVal;
@@ -145,6 +527,19 @@ T deserialize_basic(int startIdx, const unsigned char *buffer){
 	return incomingVal;
 }
 
+//Bounds checked variant, returns false instead of reading past the end of the buffer
+template<typename T>
+bool deserialize_basic(int startIdx, const unsigned char *buffer, int bufferLen, T &value){
+	static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be deserialized directly!");
+	if(startIdx < 0 || bufferLen - startIdx < static_cast<int>(sizeof(T))){
+		return false;
+	}
+
+	memcpy(&value, buffer + startIdx, sizeof(T));
+	return true;
+}
+
+bool deserialize_varint(const unsigned char *buffer, int bufferLen, int &idx, uint32_t &value);
 int deserialize_int(int startIdx, const unsigned char *buffer);
 unsigned int deserialize_uint(int startIdx, const unsigned char *buffer);
 String deserialize_string(int startIdx, int stringLength, const unsigned char *buffer);
@@ -154,8 +549,114 @@ Transform3D deserialize_transform3d(int startIdx, const unsigned char *buffer);
 unsigned int deserialize_mini(const unsigned char *data);
 void deserialize_small(const unsigned char *data, unsigned int &value1, unsigned int &value2);
 
-void send_message_reliable(SteamNetworkingMessage_t *message);
-void send_message_unreliable(SteamNetworkingMessage_t *message);
+bool configure_connection_lanes(const HSteamNetConnection &connection);
+void send_message_reliable(SteamNetworkingMessage_t *message, MessageLane_t lane = LANE_CONTROL);
+void send_message_unreliable(SteamNetworkingMessage_t *message, MessageLane_t lane = LANE_STATE_SYNC);
+//Sends the same message to several connections without copying its data for each one
+void send_shared_message_unreliable(SteamNetworkingMessage_t *message, const HSteamNetConnection *destinations, int destinationCount, MessageLane_t lane = LANE_STATE_SYNC);
+
+//===============Frame Arena===============//
+
+//Bump allocator for transient serialization buffers. Every thread gets its own arena, which gets reset at
+//the end of each tick or recieve batch, so the network threads dont touch the heap in steady state.
+class FrameArena {
+private:
+	unsigned char *m_block;
+	size_t m_capacity;
+	size_t m_offset;
+	size_t m_requestedSize;
+	LocalVector<unsigned char *> m_overflowAllocations;
+
+public:
+	static const size_t DEFAULT_CAPACITY;
+
+	FrameArena();
+	~FrameArena();
+
+	unsigned char *allocate(size_t size);
+	void reset();
+
+	static FrameArena &get_thread_arena();
+};
+
+//===============Rpc Table===============//
+
+//Where an rpc call goes
+enum RpcTarget{
+	RPC_TARGET_SERVER,
+	RPC_TARGET_OWNER,
+	RPC_TARGET_ZONE
+};
+
+//Methods of a zone or entity that can be called over the network. Methods are sent by id, which is just the order
+//they were registered in, so both ends have to register the same methods in the same order.
+class RpcTable {
+private:
+	struct Method_t {
+		StringName name;
+		bool reliable;
+	};
+
+	LocalVector<Method_t> m_methods;
+	HashMap<StringName, uint32_t> m_methodIds;
+
+public:
+	//Returns false if the method is already registered with a different reliability
+	bool register_method(const StringName &method, bool reliable);
+	bool find_method(const StringName &method, uint32_t &methodId, bool &reliable) const;
+	const StringName *get_method_name(uint32_t methodId) const;
+	int get_method_count() const;
+
+	//Pulls the method name out of the first argument of a vararg rpc call
+	static bool get_call_method(const Variant **args, int argCount, Callable::CallError &error, StringName &method);
+};
+
+//Outgoing rpc calls for one connection, batched separately depending on how they get sent
+struct RpcBatch_t {
+	LocalVector<uint8_t> reliable;
+	LocalVector<uint8_t> unreliable;
+};
+
+//Recieved rpc batch waiting for the main thread to make its calls
+struct InboundRpcBatch_t {
+	PackedByteArray batch;
+	PlayerID_t sender; //0 for calls from the server
+};
+
+//===============Clock Sync===============//
+
+//NTP style estimate of how far the server clock is ahead of the local one. Keeps the last few ping samples
+//and takes the offset from the one with the shortest round trip, since it had the least queueing in it.
+//Samples are added from one thread only. The estimate can be read from anywhere.
+class ClockSync {
+private:
+	struct Sample {
+		int64_t offset;
+		int64_t roundTrip;
+	};
+
+	Sample m_samples[CLOCK_SYNC_SAMPLE_COUNT];
+	int m_sampleCount;
+	int m_nextSample;
+	int m_pingsSent;
+	SteamNetworkingMicroseconds m_nextPingTime;
+
+	std::atomic<int64_t> m_offset;
+	std::atomic<int64_t> m_roundTrip;
+	std::atomic<bool> m_synced;
+
+public:
+	ClockSync();
+
+	void reset();
+	bool should_ping(SteamNetworkingMicroseconds now);
+	void add_sample(SteamNetworkingMicroseconds pingSent, SteamNetworkingMicroseconds serverTime, SteamNetworkingMicroseconds pongRecieved);
+	void set_estimate(int64_t offset, int64_t roundTrip);
+
+	int64_t get_offset() const;
+	int64_t get_round_trip_time() const;
+	bool is_synced() const;
+};
 
 //===============GDNet Debug===============//
 
@@ -172,6 +673,7 @@ private:
 	static ZoneID_t m_zoneIDCounter;
 
 	bool register_network_entities();
+	void clear_entity_pools();
 	World *get_world_singleton();
 
 protected:
@@ -185,6 +687,8 @@ public:
 	bool m_isInitialized;
 	bool m_isClient;
 	bool m_isServer;
+	//Server only instantiates the zones and entities that opt into server side logic
+	bool m_headlessServer;
 
 	GDNet();
 	~GDNet();
@@ -198,10 +702,17 @@ public:
 
 	bool is_client();
 	bool is_server();
+	bool is_headless_server();
+	void set_headless_server(bool headlessServer);
 
 	bool zone_exists(ZoneID_t zoneId);
 	bool entity_exists(EntityID_t entityId);
 	EntityID_t get_entity_id_by_name(String entityName);
+
+	//Main thread only
+	bool configure_entity_pool(String entityName, int warmupCount, int maxCount);
+	NetworkEntity *acquire_entity_instance(EntityID_t entityId);
+	void release_entity_instance(EntityID_t entityId, NetworkEntity *instance);
 };
 
 //===============Player Info===============//
@@ -213,21 +724,30 @@ protected:
 
 public:
 	PlayerInfo_t m_playerInfo;
+	//Client side this is the local clock estimate. Server side it holds what the player last reported.
+	ClockSync m_clock;
 
 	PlayerInfo();
 	~PlayerInfo();
 
-	void load_player(Ref<PlayerInfo> playerInfo);
+	void load_player(Ref<PlayerInfo> playerInfo, Zone *zone);
 	void load_entity(Ref<EntityInfo> entityInfo);
-	void load_entities_in_current_zone();
+	void load_entities_in_zone(Zone *zone);
 	void add_owned_entity(Ref<EntityInfo> associatedEntity);
-	void confirm_player_load(PlayerID_t playerId);
-	void confirm_entity_load(EntityNetworkID_t entityNetworkId);
-	void reset_zone_info();
+	void remove_owned_entity(EntityNetworkID_t networkId);
+	void confirm_player_load(PlayerID_t playerId, ZoneID_t zoneId);
+	void confirm_entity_load(EntityNetworkID_t entityNetworkId, ZoneID_t zoneId);
+	void subscribe_zone(Zone *zone);
+	void unsubscribe_zone(Zone *zone);
+	bool is_zone_loaded(ZoneID_t zoneId);
+	bool is_zone_relevant(ZoneID_t zoneId, uint64_t sendCount);
 
 	PlayerID_t get_player_id();
 	HSteamNetConnection get_player_conn();
 	Zone* get_current_loaded_zone();
+	ZoneSubscription_t *get_zone_subscription(ZoneID_t zoneId);
+	double get_clock_offset() const;
+	double get_round_trip_time() const;
 
 	void set_player_id(PlayerID_t playerId);
 	void set_player_conn(HSteamNetConnection playerConnection);
@@ -250,7 +770,7 @@ public:
 
 	bool verify_info();
 	void serialize_info();
-	void deserialize_info(const unsigned char *data);
+	bool deserialize_info(const unsigned char *data, const int dataLen);
 
 	//void add_();
 
@@ -279,6 +799,20 @@ class NetworkEntity : public Node {
 private:
 	Ref<Transform3DSync> m_transform3DSync;
 	Ref<Transform2DSync> m_transform2DSync;
+	Ref<PropertySync> m_propertySync;
+	Ref<AnimationSync> m_animationSync;
+	RpcTable m_rpcTable;
+
+	//Dormant entities are disconnected from the transmit signal, so the tick thread skips them entirely
+	int m_dormancyTicks;
+	int m_idleTicks; //Tick thread only, stops counting at m_dormancyTicks
+	std::atomic<bool> m_dormancyRequested; //Set while an _enter_dormancy call is queued up
+	std::atomic<bool> m_changed;
+	std::atomic<bool> m_dormant;
+
+	void tick_dormancy();
+	void enter_dormancy();
+	void exit_dormancy();
 
 	void _ready();
 	void _process(float delta);
@@ -290,24 +824,44 @@ protected:
 public:
 	Ref<EntityInfo> m_info;
 	Zone* m_parentZone;
+	bool m_serverLogic;
 
 	NetworkEntity();
 
+	void reset_for_reuse();
 	bool has_ownership();
+	void on_ownership_changed(PlayerID_t previousOwner);
+	void connect_transmit();
+	void disconnect_transmit();
+	void wake();
+	bool is_dormant() const;
 	void SERVER_SIDE_tick();
-	void SERVER_SIDE_recieve_data(EntityUpdateInfo_t updateInfo);
+	bool SERVER_SIDE_recieve_data(EntityUpdateInfo_t updateInfo);
 	void SERVER_SIDE_transmit_data();
 	void CLINET_SIDE_tick();
-	void CLIENT_SIDE_recieve_data(EntityUpdateInfo_t updateInfo);
+	bool CLIENT_SIDE_recieve_data(EntityUpdateInfo_t updateInfo);
 	void CLIENT_SIDE_transmit_data();
 
 	Ref<Transform3DSync> get_transform3d_sync();
 	Ref<Transform2DSync> get_transform2d_sync();
+	Ref<PropertySync> get_property_sync();
+	Ref<AnimationSync> get_animation_sync();
 	Ref<EntityInfo> get_entity_info();
+	bool get_server_logic() const;
+	int get_dormancy_ticks() const;
 
+	void set_server_logic(bool serverLogic);
+	void set_dormancy_ticks(int dormancyTicks);
 	void set_transform3d_sync(Ref<Transform3DSync> transform3DSync);
 	void set_transform2d_sync(Ref<Transform2DSync> transform2DSync);
-
+	void set_property_sync(Ref<PropertySync> propertySync);
+	void set_animation_sync(Ref<AnimationSync> animationSync);
+
+	bool register_rpc(const StringName &method, bool reliable = true);
+	const RpcTable &get_rpc_table() const;
+	Error _rpc_server_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
+	Error _rpc_owner_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
+	Error _rpc_zone_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
 };
 
 //===============Network Module===============//
@@ -317,7 +871,7 @@ class NetworkModule : public RefCounted{
 
 private:
 	virtual void serialize_payload(EntityUpdateInfo_t &updateInfo);
-	virtual void deserialize_payload(const EntityUpdateInfo_t &updateInfo);
+	virtual bool deserialize_payload(const EntityUpdateInfo_t &updateInfo);
 protected:
 	int m_tickCount = 0;
 
@@ -328,31 +882,218 @@ protected:
 
 	static void _bind_methods();
 public:
-	static const int METADATA_SIZE;
 	NetworkEntity *m_parentNetworkEntity = nullptr;
 
+	int get_tick_interval() const;
+
 	virtual void tick();
+	virtual bool build_update(EntityUpdateInfo_t &updateInfo);
 	virtual void transmit_data(HSteamNetConnection destination);
-	virtual void recieve_data(EntityUpdateInfo_t updateInfo);
-	static void serialize_update_metadata(EntityUpdateInfo_t &updateInfo);
-	static EntityUpdateInfo_t deserialize_update_metadata(const unsigned char* mssgData, const int mssgLen);
+	virtual bool recieve_data(EntityUpdateInfo_t updateInfo);
+	virtual void reset();
+	void SERVER_SIDE_broadcast_data();
+	static unsigned char *allocate_payload(EntityUpdateInfo_t &updateInfo, int payloadSize);
 
 	int get_transmission_rate() const;
 
 	void set_transmission_rate(const int &transmissionRate);
 };
 
+//===============State Frame Builder===============//
+
+//Packs every entity update bound for one connection during a tick into as few MTU sized messages as possible.
+//Frame layout: [NETWORK_ENTITY_UPDATE][zone id] followed by entries of [varint network id][update type][authority epoch][varint payload size][payload]
+class StateFrameBuilder {
+private:
+	HSteamNetConnection m_destination;
+	ZoneID_t m_zoneId;
+	SteamNetworkingMessage_t *m_frameMssg;
+	int m_size;
+	int m_idleFlushes;
+
+	void begin_frame(ZoneID_t zoneId);
+
+public:
+	static const int HEADER_SIZE;
+
+	StateFrameBuilder();
+	~StateFrameBuilder();
+
+	//The builder owns the message it is building the frame in, so it can only be moved
+	StateFrameBuilder(const StateFrameBuilder &) = delete;
+	StateFrameBuilder &operator=(const StateFrameBuilder &) = delete;
+	StateFrameBuilder(StateFrameBuilder &&other);
+	StateFrameBuilder &operator=(StateFrameBuilder &&other);
+
+	void queue_update(const EntityUpdateInfo_t &updateInfo);
+	void flush();
+	void flush_shared(const LocalVector<HSteamNetConnection> &destinations);
+	bool is_empty() const;
+	int get_idle_flushes() const;
+
+	void set_destination(HSteamNetConnection destination);
+
+	static bool read_update(const unsigned char *mssgData, const int mssgLen, int &dataIdx, EntityUpdateInfo_t &updateInfo);
+	static bool fits_in_frame(int payloadSize);
+};
+
+//===============Property Sync===============//
+
+//One node property replicated by a PropertySync. The value is kept in its wire encoding, so changes are
+//found by comparing bytes and sends just copy the bytes into the payload.
+struct SyncedProperty_t {
+	StringName name;
+	Variant::Type type;
+	int tickInterval; //Ticks between sends of the property, 0 sends it at the module rate
+	bool ownerOnly;
+	uint8_t pendingSends; //Sends left before the property stops being dirty
+	uint64_t nextSendTick;
+	LocalVector<uint8_t> encodedValue;
+};
+
+//Replicates a declared list of properties of the target node from the server to the clients. Properties are
+//sampled on the main thread, only the ones that changed get sent, and owner only properties only go to the owner.
+//Payload layout: entries of [varint property index][variant type][value], the value encoding depends on the type.
+//Both ends have to declare the same properties in the same order. Values whose type doesnt match the local property are skipped.
+class PropertySync : public NetworkModule {
+	GDCLASS(PropertySync, NetworkModule);
+
+private:
+	Node *m_target;
+	LocalVector<SyncedProperty_t> m_properties;
+	PackedStringArray m_propertyNames;
+	uint64_t m_dirtyBits;
+	int m_sendCount;
+
+	//Guards the properties between the main thread sampling them and the tick thread sending them
+	std::mutex m_propertyMutex;
+
+	bool build_property_update(EntityUpdateInfo_t &updateInfo, bool ownerOnly, uint64_t serverTick);
+
+protected:
+	static void _bind_methods();
+
+public:
+	PropertySync();
+
+	void tick() override;
+	bool build_update(EntityUpdateInfo_t &updateInfo) override;
+	bool recieve_data(EntityUpdateInfo_t updateInfo) override;
+	void reset() override;
+	void SERVER_SIDE_sample_properties();
+
+	bool add_property(const StringName &property, int transmissionRate = 0, bool ownerOnly = false);
+	int get_property_count() const;
+
+	//Safe to call from any thread
+	static bool merge_updates(const unsigned char *older, int olderSize, const unsigned char *newer, int newerSize, unsigned char *merged, int &mergedSize);
+
+	Node *get_target() const;
+	PackedStringArray get_properties() const;
+
+	void set_target(Node *target);
+	void set_properties(const PackedStringArray &properties);
+};
+
+//===============Animation Sync===============//
+
+//A state machine replicated by an AnimationSync. States are sent as their index in the sorted state list.
+struct SyncedStateMachine_t {
+	StringName playbackPath; //Tree parameter holding the state machine's playback
+	LocalVector<StringName> states;
+	HashMap<StringName, uint32_t> stateIds;
+};
+
+//A blend parameter replicated by an AnimationSync (float, Vector2 or bool)
+struct SyncedAnimationParameter_t {
+	StringName path;
+	Variant::Type type;
+};
+
+//Replicates the current states of an AnimationTree's state machines and its blend parameters from the server to the
+//clients. The tree is sampled on the main thread and only sent when what would be sent changed, so idle characters
+//cost next to nothing. Players in the entity's zone get 16 bit parameters, neighbouring zones get 8 bit ones.
+//Payload layout: [flags] then a [varint state index + 1] per state machine (0 if it isnt in a known state),
+//then the parameters in declaration order (each float or Vector2 component as a signed 8 or 16 bit value).
+class AnimationSync : public NetworkModule {
+	GDCLASS(AnimationSync, NetworkModule);
+
+private:
+	AnimationTree *m_animationTree;
+	PackedStringArray m_stateMachinePaths;
+	PackedStringArray m_parameterPaths;
+	float m_blendRange;
+
+	//State lists are read out of the tree the first time it gets used
+	LocalVector<SyncedStateMachine_t> m_stateMachines;
+	LocalVector<SyncedAnimationParameter_t> m_parameters;
+	bool m_resolved;
+
+	//Encoded snapshots of the tree, without the flags byte
+	LocalVector<uint8_t> m_encodedState;
+	LocalVector<uint8_t> m_encodedLodState;
+	uint8_t m_pendingSends;
+	int m_sendCount;
+
+	//Guards the snapshots between the main thread sampling them and the tick thread sending them
+	std::mutex m_stateMutex;
+
+	bool resolve_tree();
+	int encode_state(unsigned char *buffer, int capacity, bool lod);
+	void build_snapshot_update(EntityUpdateInfo_t &updateInfo, const LocalVector<uint8_t> &encodedState, uint8_t flags);
+
+protected:
+	static void _bind_methods();
+
+public:
+	AnimationSync();
+
+	void tick() override;
+	bool build_update(EntityUpdateInfo_t &updateInfo) override;
+	bool recieve_data(EntityUpdateInfo_t updateInfo) override;
+	void reset() override;
+	void SERVER_SIDE_sample_state();
+
+	AnimationTree *get_animation_tree() const;
+	PackedStringArray get_state_machines() const;
+	PackedStringArray get_parameters() const;
+	float get_blend_range() const;
+
+	void set_animation_tree(AnimationTree *animationTree);
+	void set_state_machines(const PackedStringArray &stateMachines);
+	void set_parameters(const PackedStringArray &parameters);
+	void set_blend_range(float blendRange);
+};
+
 //===============Transform 3D Sync===============//
 class Transform3DSync : public NetworkModule {
 	GDCLASS(Transform3DSync, NetworkModule);
 
 private:
 	Transform3D global_transform;
+	//Transform the target had when it was handed to this module, restored when the entity gets reused
+	Transform3D m_spawnTransform;
 	Node3D* m_target;
 	SyncAuthority m_authority;
 
+	//Dead reckoning. The sender keeps what it last sent so it can tell when the recievers prediction drifted too far,
+	//the reciever extrapolates from the last update with the velocities that came with it.
+	bool m_deadReckoning;
+	float m_deadReckoningThreshold;
+	float m_deadReckoningMaxSilence;
+	bool m_hasVelocity;
+	Vector3 m_linearVelocity;
+	Vector3 m_angularVelocity;
+	Transform3D m_lastSample;
+	uint64_t m_lastSampleUsec;
+	Transform3D m_lastSent;
+	Vector3 m_lastSentLinearVelocity;
+	Vector3 m_lastSentAngularVelocity;
+	uint64_t m_lastSentUsec;
+
+	bool prediction_still_valid();
 	void serialize_payload(EntityUpdateInfo_t &updateInfo) override;
-	void deserialize_payload(const EntityUpdateInfo_t &updateInfo) override;
+	bool deserialize_payload(const EntityUpdateInfo_t &updateInfo) override;
 protected:
 	static void _bind_methods();
 
@@ -364,8 +1105,10 @@ public:
 
 	Transform3DSync();
 
-	void transmit_data(HSteamNetConnection destination) override;
-	void recieve_data(EntityUpdateInfo_t updateInfo) override;
+	void tick() override;
+	bool build_update(EntityUpdateInfo_t &updateInfo) override;
+	bool recieve_data(EntityUpdateInfo_t updateInfo) override;
+	void reset() override;
 	void interpolate_origin(float delta);
 	bool has_authority();
 	bool has_target();
@@ -374,10 +1117,16 @@ public:
 	Node3D* get_target();
 	Vector3 get_position() const;
 	SyncAuthority get_authority() const;
+	bool get_dead_reckoning() const;
+	float get_dead_reckoning_threshold() const;
+	float get_dead_reckoning_max_silence() const;
 
 	void set_target(Node3D* target);
 	void set_position(const Vector3 &position);
 	void set_authority(SyncAuthority authority);
+	void set_dead_reckoning(bool deadReckoning);
+	void set_dead_reckoning_threshold(float threshold);
+	void set_dead_reckoning_max_silence(float maxSilence);
 };
 
 //===============Transform 2D Sync===============//
@@ -387,11 +1136,29 @@ class Transform2DSync : public NetworkModule {
 private:
 	bool m_interpolate;
 	Transform2D global_transform;
+	//Transform the target had when it was handed to this module, restored when the entity gets reused
+	Transform2D m_spawnTransform;
 	Node2D* m_target;
 	SyncAuthority m_authority;
 
+	//Dead reckoning. The sender keeps what it last sent so it can tell when the recievers prediction drifted too far,
+	//the reciever extrapolates from the last update with the velocities that came with it.
+	bool m_deadReckoning;
+	float m_deadReckoningThreshold;
+	float m_deadReckoningMaxSilence;
+	bool m_hasVelocity;
+	Vector2 m_linearVelocity;
+	real_t m_angularVelocity;
+	Transform2D m_lastSample;
+	uint64_t m_lastSampleUsec;
+	Transform2D m_lastSent;
+	Vector2 m_lastSentLinearVelocity;
+	real_t m_lastSentAngularVelocity;
+	uint64_t m_lastSentUsec;
+
+	bool prediction_still_valid();
 	void serialize_payload(EntityUpdateInfo_t &updateInfo) override;
-	void deserialize_payload(const EntityUpdateInfo_t &updateInfo) override;
+	bool deserialize_payload(const EntityUpdateInfo_t &updateInfo) override;
 protected:
 	static void _bind_methods();
 
@@ -404,8 +1171,9 @@ public:
 	Transform2DSync();
 
 	void tick() override;
-	void transmit_data(HSteamNetConnection destination) override;
-	void recieve_data(EntityUpdateInfo_t updateInfo) override;
+	bool build_update(EntityUpdateInfo_t &updateInfo) override;
+	bool recieve_data(EntityUpdateInfo_t updateInfo) override;
+	void reset() override;
 	void interpolate_origin(float delta);
 	bool has_authority();
 	bool has_target();
@@ -416,11 +1184,17 @@ public:
 	Node2D* get_target() ;
 	Vector2 get_position() const;
 	SyncAuthority get_authority() const;
+	bool get_dead_reckoning() const;
+	float get_dead_reckoning_threshold() const;
+	float get_dead_reckoning_max_silence() const;
 
 	void set_interpolate(const bool &interpolate);
 	void set_target(Node2D* target);
 	void set_position(const Vector2 &position);
 	void set_authority(SyncAuthority authority);
+	void set_dead_reckoning(bool deadReckoning);
+	void set_dead_reckoning_threshold(float threshold);
+	void set_dead_reckoning_max_silence(float maxSilence);
 };
 
 //===============Zone===============//
@@ -434,12 +1208,83 @@ private:
 	bool m_instantiated;
 	Node *m_zoneInstance;
 
+	//Client side streaming. The scene gets loaded and instantiated off the main thread and only
+	//attached to the zone once it is ready.
+	enum StreamState {
+		STREAM_IDLE,
+		STREAM_LOADING,
+		STREAM_INSTANTIATING
+	};
+	String m_zoneScenePath;
+	StreamState m_streamState;
+	bool m_sceneLoadRequested;
+	bool m_zoneSceneFromPath; //Whether m_zoneScene was loaded from m_zoneScenePath (and can be let go of)
+	Ref<PackedScene> m_streamedScene;
+	Node *m_streamedInstance;
+	WorkerThreadPool::TaskID m_instantiateTask;
+
+	//Entities are created and destroyed from the network threads, but the scene tree can only be touched
+	//from the main thread. They get queued up here and worked off in batches every frame.
+	std::mutex m_entityQueueMutex;
+	LocalVector<Ref<EntityInfo>> m_pendingSpawns;
+	LocalVector<NetworkEntity *> m_pendingDespawns;
+	//Main thread copies of the queues, so the lock is only held while swapping
+	LocalVector<Ref<EntityInfo>> m_spawnBacklog;
+	LocalVector<NetworkEntity *> m_despawnBacklog;
+	uint32_t m_spawnBacklogIdx;
+	uint32_t m_despawnBacklogIdx;
+	int m_spawnBudgetUsec;
+
+	//Headless server state. Entities that are not instantiated live in the transform table instead,
+	//which is shared between the main thread and the tick thread.
+	bool m_serverLogic;
+	bool m_headless;
+	std::mutex m_headlessMutex;
+	LocalVector<HeadlessEntity_t> m_headlessEntities;
+	HashMap<uint64_t, uint32_t> m_headlessEntityIndices;
+
+	//Hibernation (server only). Once the zone has gone without players for the delay, its entities get
+	//packed into the snapshot and the scene is freed until the zone is loaded again.
+	float m_hibernationDelay;
+	float m_idleTime;
+	bool m_hibernated;
+	Vector<uint8_t> m_hibernationSnapshot;
+
+	//Lag compensation history (server only, main thread only). A ring of frames, one per physics tick.
+	float m_rewindHistoryDuration;
+	LocalVector<RewindFrame_t> m_rewindFrames;
+	uint32_t m_rewindHead; //Next frame to be overwritten
+	uint32_t m_rewindFrameCount;
+
+	RpcTable m_rpcTable;
+
+	static void instantiate_streamed_scene(void *zone);
+	Ref<PackedScene> resolve_zone_scene();
+	void process_streaming();
+	void fail_streaming();
+	void cancel_streaming();
+	void attach_zone_instance(Node *zoneInstance);
+
+	void process_entity_queues(bool ignoreBudget);
+	void spawn_entity(Ref<EntityInfo> entityInfo);
+	void despawn_entity(NetworkEntity *instance);
+	void add_headless_entity(Ref<EntityInfo> entityInfo, const NetworkEntityInfo_t &entityType);
+	void remove_headless_entity(EntityNetworkID_t networkId);
+	void update_hibernation(float delta);
+	void capture_entity_state(const Ref<EntityInfo> &entityInfo);
+	void hibernate();
+	void restore_from_hibernation();
+	void record_rewind_frame();
+	const RewindFrame_t *find_rewind_frame(SteamNetworkingMicroseconds time) const;
+
 protected:
 	static void _bind_methods();
 	void _notification(int n_type);
 
 public:
 	HashMap<PlayerID_t, Ref<PlayerInfo>> m_playersInZone;
+	//Written from the network threads as well as the main thread, only touch it with m_entityQueueMutex held
+	//(or go through get_entity/get_entities)
 	HashMap<EntityNetworkID_t, Ref<EntityInfo>> m_entitiesInZone;
 
 	Zone();
@@ -447,23 +1292,145 @@ public:
 
 	bool instantiate_zone();
 	void uninstantiate_zone();
+	void preload_zone_scene();
+	void begin_streaming();
+	bool has_zone_scene() const;
+	bool is_streaming() const;
 	void add_player(Ref<PlayerInfo> playerInfo);
 	void remove_player(Ref<PlayerInfo> playerInfo);
-	void load_entity(Ref<EntityInfo> entityInfo);
+	bool load_entity(Ref<EntityInfo> entityInfo);
 	void create_entity(Ref<EntityInfo> entityInfo);
 	void destroy_entity(Ref<EntityInfo> entityInfo);
+	bool migrate_entity(Ref<EntityInfo> entityInfo, Zone *targetZone);
+	void set_entity_owner(Ref<EntityInfo> entityInfo, PlayerID_t newOwner, uint8_t authorityEpoch);
+	void wake_entity(EntityNetworkID_t networkId);
 
 	void player_loaded_callback(Ref<PlayerInfo> playerInfo);
 
 	bool player_in_zone(PlayerID_t player);
 	bool is_instantiated();
+	bool is_headless() const;
+	bool is_hibernated() const;
+
+	bool SERVER_SIDE_store_headless_update(Ref<EntityInfo> entityInfo, const EntityUpdateInfo_t &updateInfo);
+	void SERVER_SIDE_broadcast_update(const EntityUpdateInfo_t &updateInfo, int tickInterval);
+	void SERVER_SIDE_headless_tick();
+	void SERVER_SIDE_capture_snapshot(WorldSnapshotBuilder &builder);
+	int SERVER_SIDE_rewind_query(SteamNetworkingMicroseconds time, const RewindShape_t &shape, EntityNetworkID_t *results, int maxResults) const;
+	PackedInt32Array rewind_query(double serverTime, const Ref<Shape3D> &shape, const Transform3D &shapeTransform) const;
+	PackedInt32Array rewind_query_2d(double serverTime, const Ref<Shape2D> &shape, const Transform2D &shapeTransform) const;
 
 	Ref<PackedScene> get_zone_scene() const;
+	String get_zone_scene_path() const;
 	Ref<PlayerInfo> get_player(PlayerID_t playerId) const;
+	Ref<EntityInfo> get_entity(EntityNetworkID_t networkId);
+	bool get_entity_authority(EntityNetworkID_t networkId, PlayerID_t &owner, uint8_t &authorityEpoch);
+	void get_entities(LocalVector<Ref<EntityInfo>> &entities);
 	ZoneID_t get_zone_id() const;
+	int get_spawn_budget_usec() const;
+	bool get_server_logic() const;
+	float get_hibernation_delay() const;
+	float get_rewind_history_duration() const;
 
 	void set_zone_scene(const Ref<PackedScene> &zoneScene);
+	void set_zone_scene_path(const String &zoneScenePath);
 	void set_zone_id(const ZoneID_t zoneId);
+	void set_spawn_budget_usec(int spawnBudgetUsec);
+	void set_server_logic(bool serverLogic);
+	void set_hibernation_delay(float hibernationDelay);
+	void set_rewind_history_duration(float duration);
+
+	bool register_rpc(const StringName &method, bool reliable = true);
+	const RpcTable &get_rpc_table() const;
+	Error _rpc_server_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
+	Error _rpc_zone_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error);
+};
+
+//===============World Snapshot===============//
+//Persistent world state for server restarts. Layout (all little-endian):
+//[header][zone table][entity records][string table]
+//Entity records are fixed size and grouped by zone, so a zone's entities can be read straight out of the
+//mapped file without touching the rest of it. Strings are stored as offset + length into the string table.
+
+#define WORLD_SNAPSHOT_MAGIC 0x53574447 //"GDWS"
+#define WORLD_SNAPSHOT_VERSION 2
+
+struct WorldSnapshotHeader_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t zoneCount;
+	uint32_t entityCount;
+	uint32_t stringTableSize;
+	uint32_t maxNetworkId;
+};
+
+struct WorldSnapshotZone_t {
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t firstEntity;
+	uint32_t entityCount;
+};
+
+//Entities are stored by name, ids depend on the order the entities got registered in and can change between runs
+struct WorldSnapshotEntity_t {
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t networkId;
+	uint32_t owner;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+	float position3D[3];
+	float position2D[2];
+};
+
+//Collects the world state on the main thread. The finished buffer is copy-on-write, so it can be handed
+//to another thread to be written out without copying it again.
+class WorldSnapshotBuilder {
+private:
+	LocalVector<WorldSnapshotZone_t> m_zones;
+	LocalVector<WorldSnapshotEntity_t> m_entities;
+	LocalVector<uint8_t> m_strings;
+	uint32_t m_maxNetworkId;
+
+	uint32_t add_string(const String &value, uint32_t &length);
+
+public:
+	WorldSnapshotBuilder();
+
+	void begin_zone(const String &zoneName);
+	void add_entity(const Ref<EntityInfo> &entityInfo);
+	Vector<uint8_t> finish();
+};
+
+//Read only view of a snapshot file mapped into memory. Nothing gets parsed until it is asked for.
+class WorldSnapshot {
+private:
+	const uint8_t *m_data;
+	uint64_t m_size;
+	WorldSnapshotHeader_t m_header;
+#ifdef WINDOWS_ENABLED
+	void *m_fileHandle;
+	void *m_mappingHandle;
+#endif
+
+	bool read_zone(uint32_t zoneIdx, WorldSnapshotZone_t &zone) const;
+	String read_string(uint32_t offset, uint32_t length) const;
+
+public:
+	WorldSnapshot();
+	~WorldSnapshot();
+
+	bool open(const String &path);
+	void close();
+	bool is_open() const;
+
+	uint32_t get_zone_count() const;
+	uint32_t get_max_network_id() const;
+	int find_zone(const String &zoneName) const;
+	uint32_t get_zone_entity_count(uint32_t zoneIdx) const;
+	bool read_entity(uint32_t zoneIdx, uint32_t entityIdx, Ref<EntityInfo> &entityInfo) const;
+
+	static bool write_file(const String &path, const Vector<uint8_t> &snapshotData);
 };
 
 //===============World===============//
@@ -475,6 +1442,61 @@ private:
 	HashMap<HSteamNetConnection, Ref<PlayerInfo>> m_worldPlayerInfoByConnection;
 	HashMap<PlayerID_t, Ref<PlayerInfo>> m_worldPlayerInfoById;
 
+	//Outgoing state frames keyed by destination (only ever touched from the tick thread)
+	HashMap<HSteamNetConnection, StateFrameBuilder *> m_stateFrames;
+	//Outgoing state frames shared by every player in a zone, keyed by zone id and whether neighbouring players get them too.
+	//These are built once and sent to every player without being copied per player. (Tick thread only)
+	HashMap<uint64_t, StateFrameBuilder *> m_broadcastFrames;
+	LocalVector<HSteamNetConnection> m_broadcastDestinations;
+
+	//Inbound update mailbox per entity module, keyed by network id and update type (only ever touched from the listen thread)
+	HashMap<uint64_t, UpdateMailbox *> m_updateMailboxes;
+	//Mailboxes holding an update the main thread has not applied yet. A mailbox is only queued once until it gets drained.
+	SPSCQueue<UpdateMailbox *, INBOUND_UPDATE_QUEUE_SIZE> m_dirtyMailboxes;
+	//Goes up for every update posted to a mailbox (only advanced by the listen thread). Mailboxes outlive the entities
+	//they were made for, so this is what tells updates for a reused network id apart.
+	std::atomic<uint64_t> m_inboundSequence;
+
+	//Snapshot the server was resumed from. Zones are only restored from it once they get instantiated.
+	WorldSnapshot m_snapshot;
+	LocalVector<bool> m_snapshotZoneRestored;
+	std::thread m_snapshotWriterThread;
+
+	//Snapshot waiting to be written. Saving while a write is still going just replaces it, the writer picks it up once it is done.
+	std::mutex m_snapshotWriteMutex;
+	String m_pendingSnapshotPath;
+	Vector<uint8_t> m_pendingSnapshotData;
+	bool m_snapshotPending;
+	bool m_snapshotWriting;
+
+	void snapshot_writer_loop();
+
+	//Neighbouring zones a player is loaded into only get entity updates every this many server ticks
+	int m_neighborZoneUpdateInterval;
+
+	//Outgoing rpc batches keyed by destination. Calls get queued from the main thread and sent from the tick thread.
+	std::mutex m_rpcMutex;
+	HashMap<HSteamNetConnection, RpcBatch_t> m_rpcBatches;
+	LocalVector<uint8_t> m_rpcScratch; //Main thread only
+	PlayerID_t m_rpcSender; //Main thread only, set while incoming calls are being made
+
+	int encode_rpc(uint8_t flags, ZoneID_t zoneId, EntityNetworkID_t networkId, uint32_t methodId, const Variant **args, int argCount);
+	void queue_rpc(HSteamNetConnection destination, int entrySize, bool reliable);
+	void flush_rpc_batches();
+	void apply_rpc_batch(const PackedByteArray &batch, PlayerID_t sender);
+
+	//Recieved rpc batches, queued by the listen thread and applied along with the entity updates
+	SPSCQueue<InboundRpcBatch_t *, INBOUND_RPC_QUEUE_SIZE> m_inboundRpcBatches;
+	void queue_inbound_rpc_batch(const unsigned char *mssgData, const int mssgLen, PlayerID_t sender);
+	std::atomic<uint64_t> m_serverTick; //Only advanced by the tick thread
+
+	void flush_state_frames();
+	void queue_inbound_update(const EntityUpdateInfo_t &updateInfo);
+	void apply_inbound_updates();
+	void free_update_mailboxes();
+	void connect_frame_hook();
+	void disconnect_frame_hook();
+
 	//Server Side
 	bool m_serverRunLoop;
 	HSteamNetPollGroup m_hPollGroup;
@@ -482,19 +1504,27 @@ private:
 	std::thread m_serverListenThread;
 	std::thread m_serverTickThread;
 
+
 	static void SERVER_SIDE_CONN_CHANGE(SteamNetConnectionStatusChangedCallback_t *pInfo);
 	void player_connecting(HSteamNetConnection playerConnection);
 	void player_connected(HSteamNetConnection playerConnection);
 	void player_disconnected(HSteamNetConnection playerConnection);
 	void remove_player(HSteamNetConnection hConn);
 
-	void SERVER_SIDE_load_zone_request(const unsigned char *mssgData, HSteamNetConnection sourceConn);
-	void SERVER_SIDE_load_zone_acknowledge(const unsigned char *mssgData, HSteamNetConnection sourceConn);
-	void SERVER_SIDE_create_zone_player_info_acknowledge(const unsigned char *mssgData, HSteamNetConnection sourceConn);
-	void SERVER_SIDE_load_entity_request(const unsigned char *mssgData);
-	void SERVER_SIDE_load_entity_acknowledge(const unsigned char *mssgData, HSteamNetConnection sourceConn);
-	void SERVER_SIDE_handle_entity_update(const unsigned char *mssgData, const int mssgLen);
-	void SERVER_SIDE_player_left_zone(const unsigned char *mssgData);
+	//Rejected message counters (written by the listen thread, read from anywhere)
+	std::atomic<uint64_t> m_rejectedMessages[REJECTION_COUNT];
+
+	MessageRejection SERVER_SIDE_load_zone_request(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_load_zone_acknowledge(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_create_zone_player_info_acknowledge(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_load_entity_request(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_load_entity_acknowledge(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_handle_entity_update(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_player_left_zone(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_set_active_zone(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_clock_sync_ping(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_rpc_batch(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
+	MessageRejection SERVER_SIDE_dispatch_message(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn);
 
 	void SERVER_SIDE_connection_status_changed(SteamNetConnectionStatusChangedCallback_t *pInfo);
 	void SERVER_SIDE_poll_incoming_messages();
@@ -504,6 +1534,7 @@ private:
 	//Client Side
 	Ref<PlayerInfo> m_localPlayer;
 	bool m_clientRunLoop;
+	std::atomic<int> m_receiveBatchSize;
 	std::thread m_clientListenThread;
 	std::thread m_clientTickThread;
 
@@ -513,12 +1544,19 @@ private:
 	void CLIENT_SIDE_zone_load_complete(const unsigned char *mssgData);
 	void CLIENT_SIDE_load_zone_request(const unsigned char *mssgData);
 	void CLIENT_SIDE_process_create_zone_player_info_request(const unsigned char *mssgData);
-	void CLIENT_SIDE_load_entity_request(const unsigned char *mssgData);
+	void CLIENT_SIDE_load_entity_request(const unsigned char *mssgData, const int mssgLen);
 	void CLIENT_SIDE_handle_entity_update(const unsigned char *mssgData, const int mssgLen);
 	void CLIENT_SIDE_player_left_zone(const unsigned char *mssgData);
+	void CLIENT_SIDE_entity_migrated(const unsigned char *mssgData, const int mssgLen);
+	void CLIENT_SIDE_migrate_entity_callback(EntityNetworkID_t networkId, ZoneID_t sourceZoneId, ZoneID_t targetZoneId, String parentRelativePath);
+	void CLIENT_SIDE_ownership_transferred(const unsigned char *mssgData, const int mssgLen);
+	void CLIENT_SIDE_transfer_ownership_callback(EntityNetworkID_t networkId, ZoneID_t zoneId, PlayerID_t newOwner, uint8_t authorityEpoch);
+	void CLIENT_SIDE_clock_sync_pong(const unsigned char *mssgData, const int mssgLen);
+	void CLIENT_SIDE_sync_clock();
 
 	void CLIENT_SIDE_connection_status_changed(SteamNetConnectionStatusChangedCallback_t *pInfo);
-	void CLIENT_SIDE_poll_incoming_messages();
+	void CLIENT_SIDE_dispatch_message(SteamNetworkingMessage_t *pMessage);
+	int CLIENT_SIDE_poll_incoming_messages();
 	void client_listen_loop();
 	void client_tick_loop();
 
@@ -535,6 +1573,15 @@ public:
 	//Server side
 	void start_world(int port);
 	void stop_world();
+	bool save_snapshot(String path);
+	bool load_snapshot(String path);
+	void SERVER_SIDE_restore_zone_from_snapshot(Zone *zone);
+	bool migrate_entity(Ref<EntityInfo> entityInfo, ZoneID_t targetZoneId, String parentRelativePath = "");
+	bool transfer_ownership(Ref<EntityInfo> entityInfo, PlayerID_t newOwner);
+	uint64_t SERVER_SIDE_get_tick() const;
+	uint64_t get_inbound_sequence() const;
+	int get_neighbor_zone_update_interval() const;
+	void set_neighbor_zone_update_interval(int interval);
 
 	//Client side
 	HSteamNetConnection m_worldConnection;
@@ -545,12 +1592,27 @@ public:
 	void join_world(String world, int port);
 	void leave_world();
 
+	int get_receive_batch_size() const;
+	void set_receive_batch_size(int batchSize);
+
 	bool load_zone_by_name(String zoneName);
 	bool load_zone_by_id(ZoneID_t zoneId);
 	void unload_zone();
+	void unload_zone_by_id(ZoneID_t zoneId);
+	bool set_active_zone(ZoneID_t zoneId);
+	Zone *get_active_zone();
+	Array get_loaded_zones();
 
 	//Both
 	bool player_exists(PlayerID_t playerId);
+	uint64_t get_rejected_message_count(MessageRejection reason) const;
+	double get_server_time() const;
+	double get_round_trip_time() const;
+	double get_clock_offset() const;
+	void queue_entity_update(HSteamNetConnection destination, const EntityUpdateInfo_t &updateInfo);
+	void queue_zone_broadcast(const EntityUpdateInfo_t &updateInfo, bool includeNeighbors);
+	Error send_rpc(RpcTarget target, Zone *zone, NetworkEntity *entity, const StringName &method, const Variant **args, int argCount);
+	PlayerID_t get_rpc_sender_id() const;
 };
 
 //===============ID Generator===============//
@@ -570,6 +1632,7 @@ public:
 	static EntityNetworkID_t generateNetworkIdentityID();
 	static void freePlayerID(PlayerID_t playerID);
 	static void freeNetworkEntityID(EntityNetworkID_t networkEntityID);
+	static void reserveNetworkIdentityIDs(EntityNetworkID_t highestID);
 };
 
 #endif
@@ -58,3 +58,10 @@ void IDGenerator::freeNetworkEntityID(EntityNetworkID_t networkEntityID) {
 	usedNetworkEntityIDs.erase(networkEntityID);
 	freeNetworkEntityIDs.push(networkEntityID);
 }
+
+void IDGenerator::reserveNetworkIdentityIDs(EntityNetworkID_t highestID) {
+	//Make sure ids that are still in use somewhere (like an unrestored snapshot) never get handed out again
+	if (s_networkEntityIDCounter <= highestID) {
+		s_networkEntityIDCounter = highestID + 1;
+	}
+}
@@ -0,0 +1,400 @@
+#include "gdnet.h"
+
+//A 64 bit varint never takes more than 10 bytes
+static const int MAX_VARINT_SIZE = 10;
+
+//===============Message Writer===============//
+
+MessageWriter::MessageWriter(unsigned char *buffer, int capacity) {
+	m_buffer = buffer;
+	m_capacity = capacity;
+	m_size = 0;
+	m_overflowed = false;
+	m_bitByteIdx = 0;
+	m_bitCount = 8;
+}
+
+unsigned char *MessageWriter::reserve(int size) {
+	//Any other write ends the current run of packed bools
+	m_bitCount = 8;
+
+	if (m_overflowed || size < 0 || m_capacity - m_size < size) {
+		m_overflowed = true;
+		return nullptr;
+	}
+
+	unsigned char *dest = m_buffer + m_size;
+	m_size += size;
+	return dest;
+}
+
+void MessageWriter::write_bytes(const void *data, int size) {
+	unsigned char *dest = reserve(size);
+	if (dest) {
+		memcpy(dest, data, size);
+	}
+}
+
+void MessageWriter::write_varint(uint64_t value) {
+	unsigned char encoded[MAX_VARINT_SIZE];
+	int encodedSize = 0;
+
+	//Write 7 bits at a time, using the top bit to mark that more bytes follow
+	while (value >= 0x80) {
+		encoded[encodedSize++] = static_cast<unsigned char>(value | 0x80);
+		value >>= 7;
+	}
+	encoded[encodedSize++] = static_cast<unsigned char>(value);
+
+	write_bytes(encoded, encodedSize);
+}
+
+void MessageWriter::write_zigzag(int64_t value) {
+	write_varint(zigzag_encode(value));
+}
+
+void MessageWriter::write_bool(bool value) {
+	//Start a new packed byte once the current one is full
+	if (m_bitCount == 8) {
+		unsigned char *dest = reserve(1);
+		if (!dest) {
+			return;
+		}
+		*dest = 0;
+		m_bitByteIdx = m_size - 1;
+		m_bitCount = 0;
+	}
+
+	if (value) {
+		m_buffer[m_bitByteIdx] |= static_cast<unsigned char>(1 << m_bitCount);
+	}
+	m_bitCount++;
+}
+
+void MessageWriter::write_string(const String &value) {
+	const char32_t *chars = value.get_data();
+	int length = value.length();
+
+	//Work out the encoded size first so the string can be encoded directly into the buffer
+	int utf8Size = 0;
+	for (int i = 0; i < length; i++) {
+		char32_t c = chars[i];
+		utf8Size += c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+	}
+
+	write_varint(utf8Size);
+	unsigned char *dest = reserve(utf8Size);
+	if (!dest) {
+		return;
+	}
+
+	//Encode the string as UTF-8
+	for (int i = 0; i < length; i++) {
+		char32_t c = chars[i];
+		if (c < 0x80) {
+			*dest++ = static_cast<unsigned char>(c);
+		} else if (c < 0x800) {
+			*dest++ = static_cast<unsigned char>(0xC0 | (c >> 6));
+			*dest++ = static_cast<unsigned char>(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			*dest++ = static_cast<unsigned char>(0xE0 | (c >> 12));
+			*dest++ = static_cast<unsigned char>(0x80 | ((c >> 6) & 0x3F));
+			*dest++ = static_cast<unsigned char>(0x80 | (c & 0x3F));
+		} else {
+			*dest++ = static_cast<unsigned char>(0xF0 | (c >> 18));
+			*dest++ = static_cast<unsigned char>(0x80 | ((c >> 12) & 0x3F));
+			*dest++ = static_cast<unsigned char>(0x80 | ((c >> 6) & 0x3F));
+			*dest++ = static_cast<unsigned char>(0x80 | (c & 0x3F));
+		}
+	}
+}
+
+int MessageWriter::get_size() const {
+	return m_size;
+}
+
+bool MessageWriter::has_overflowed() const {
+	return m_overflowed;
+}
+
+//===============Message Reader===============//
+
+MessageReader::MessageReader(const unsigned char *buffer, int size, int startIdx) {
+	m_buffer = buffer;
+	m_size = size;
+	m_idx = startIdx;
+	m_failed = startIdx < 0 || startIdx > size;
+	m_bitByteIdx = 0;
+	m_bitCount = 8;
+}
+
+const unsigned char *MessageReader::consume(int size) {
+	//Any other read ends the current run of packed bools
+	m_bitCount = 8;
+
+	if (m_failed || size < 0 || m_size - m_idx < size) {
+		m_failed = true;
+		return nullptr;
+	}
+
+	const unsigned char *src = m_buffer + m_idx;
+	m_idx += size;
+	return src;
+}
+
+bool MessageReader::read_bytes(const unsigned char *&data, int size) {
+	data = consume(size);
+	return data != nullptr;
+}
+
+bool MessageReader::read_varint(uint64_t &value) {
+	value = 0U;
+
+	for (int shiftAmt = 0; shiftAmt < 7 * MAX_VARINT_SIZE; shiftAmt += 7) {
+		const unsigned char *src = consume(1);
+		if (!src) {
+			return false;
+		}
+
+		value |= static_cast<uint64_t>(*src & 0x7F) << shiftAmt;
+		if (!(*src & 0x80)) {
+			return true;
+		}
+	}
+
+	//Too many continuation bytes, the varint is malformed
+	m_failed = true;
+	return false;
+}
+
+bool MessageReader::read_varint(uint32_t &value) {
+	uint64_t wideValue;
+	if (!read_varint(wideValue)) {
+		return false;
+	}
+
+	//Reject values that dont fit instead of silently truncating them
+	if (wideValue > UINT32_MAX) {
+		m_failed = true;
+		return false;
+	}
+
+	value = static_cast<uint32_t>(wideValue);
+	return true;
+}
+
+bool MessageReader::read_zigzag(int64_t &value) {
+	uint64_t encoded;
+	if (!read_varint(encoded)) {
+		return false;
+	}
+
+	value = zigzag_decode(encoded);
+	return true;
+}
+
+bool MessageReader::read_bool(bool &value) {
+	//Move onto the next packed byte once the current one has been read through
+	if (m_bitCount == 8) {
+		const unsigned char *src = consume(1);
+		if (!src) {
+			return false;
+		}
+		m_bitByteIdx = m_idx - 1;
+		m_bitCount = 0;
+	}
+
+	value = (m_buffer[m_bitByteIdx] >> m_bitCount) & 1;
+	m_bitCount++;
+	return true;
+}
+
+bool MessageReader::read_string(String &value) {
+	uint32_t utf8Size;
+	const unsigned char *utf8Data;
+
+	if (!read_varint(utf8Size) || utf8Size > static_cast<uint32_t>(get_remaining()) || !read_bytes(utf8Data, utf8Size)) {
+		m_failed = true;
+		return false;
+	}
+
+	//Parse straight out of the message buffer
+	value.parse_utf8(reinterpret_cast<const char *>(utf8Data), utf8Size);
+	return true;
+}
+
+bool MessageReader::skip(int size) {
+	return consume(size) != nullptr;
+}
+
+int MessageReader::get_position() const {
+	return m_idx;
+}
+
+int MessageReader::get_remaining() const {
+	return m_failed ? 0 : m_size - m_idx;
+}
+
+bool MessageReader::has_failed() const {
+	return m_failed;
+}
+
+//===============Typed Values===============//
+
+bool is_codec_supported_type(Variant::Type type) {
+	switch (type) {
+		case Variant::BOOL:
+		case Variant::INT:
+		case Variant::FLOAT:
+		case Variant::STRING:
+		case Variant::STRING_NAME:
+		case Variant::VECTOR2:
+		case Variant::VECTOR2I:
+		case Variant::VECTOR3:
+		case Variant::VECTOR3I:
+		case Variant::COLOR:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//Values whose type both ends already agree on. Floats go over the wire as 32 bit floats and ints as zigzag varints, whatever the engine was built with
+bool encode_typed_value(MessageWriter &writer, Variant::Type type, const Variant &value) {
+	switch (type) {
+		case Variant::BOOL: {
+			writer.write<uint8_t>(static_cast<bool>(value) ? 1 : 0);
+			break;
+		}
+		case Variant::INT: {
+			writer.write_zigzag(static_cast<int64_t>(value));
+			break;
+		}
+		case Variant::FLOAT: {
+			writer.write<float>(static_cast<float>(static_cast<double>(value)));
+			break;
+		}
+		case Variant::STRING:
+		case Variant::STRING_NAME: {
+			writer.write_string(value);
+			break;
+		}
+		case Variant::VECTOR2: {
+			Vector2 vec = value;
+			writer.write<float>(vec.x);
+			writer.write<float>(vec.y);
+			break;
+		}
+		case Variant::VECTOR2I: {
+			Vector2i vec = value;
+			writer.write_zigzag(vec.x);
+			writer.write_zigzag(vec.y);
+			break;
+		}
+		case Variant::VECTOR3: {
+			Vector3 vec = value;
+			writer.write<float>(vec.x);
+			writer.write<float>(vec.y);
+			writer.write<float>(vec.z);
+			break;
+		}
+		case Variant::VECTOR3I: {
+			Vector3i vec = value;
+			writer.write_zigzag(vec.x);
+			writer.write_zigzag(vec.y);
+			writer.write_zigzag(vec.z);
+			break;
+		}
+		case Variant::COLOR: {
+			Color color = value;
+			writer.write<float>(color.r);
+			writer.write<float>(color.g);
+			writer.write<float>(color.b);
+			writer.write<float>(color.a);
+			break;
+		}
+		default:
+			return false;
+	}
+
+	return !writer.has_overflowed();
+}
+
+//Reads that fail leave their zeroed locals alone, the value is thrown away by the caller once the reader has failed
+bool decode_typed_value(MessageReader &reader, Variant::Type type, Variant &value) {
+	switch (type) {
+		case Variant::BOOL: {
+			uint8_t boolean = 0;
+			reader.read(boolean);
+			value = boolean != 0;
+			break;
+		}
+		case Variant::INT: {
+			int64_t integer = 0;
+			reader.read_zigzag(integer);
+			value = integer;
+			break;
+		}
+		case Variant::FLOAT: {
+			float real = 0.0f;
+			reader.read(real);
+			value = real;
+			break;
+		}
+		case Variant::STRING: {
+			String string;
+			reader.read_string(string);
+			value = string;
+			break;
+		}
+		case Variant::STRING_NAME: {
+			String string;
+			reader.read_string(string);
+			value = StringName(string);
+			break;
+		}
+		case Variant::VECTOR2: {
+			float x = 0.0f, y = 0.0f;
+			reader.read(x);
+			reader.read(y);
+			value = Vector2(x, y);
+			break;
+		}
+		case Variant::VECTOR2I: {
+			int64_t x = 0, y = 0;
+			reader.read_zigzag(x);
+			reader.read_zigzag(y);
+			value = Vector2i(x, y);
+			break;
+		}
+		case Variant::VECTOR3: {
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			reader.read(x);
+			reader.read(y);
+			reader.read(z);
+			value = Vector3(x, y, z);
+			break;
+		}
+		case Variant::VECTOR3I: {
+			int64_t x = 0, y = 0, z = 0;
+			reader.read_zigzag(x);
+			reader.read_zigzag(y);
+			reader.read_zigzag(z);
+			value = Vector3i(x, y, z);
+			break;
+		}
+		case Variant::COLOR: {
+			float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+			reader.read(r);
+			reader.read(g);
+			reader.read(b);
+			reader.read(a);
+			value = Color(r, g, b, a);
+			break;
+		}
+		default:
+			return false;
+	}
+
+	return !reader.has_failed();
+}
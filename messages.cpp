@@ -20,55 +20,83 @@ SteamNetworkingMessage_t *allocate_message(const unsigned char *data, const int
 	return pMessage;
 }
 
+static SteamNetworkingMessage_t *allocate_empty_message(const int sizeOfData, const HSteamNetConnection &destination) {
+	// Allocate a new message that the data will be written into directly
+	SteamNetworkingMessage_t *pMessage = SteamNetworkingUtils()->AllocateMessage(sizeOfData);
+
+	//Sanity check: make sure message was created
+	if (!pMessage) {
+		ERR_PRINT("Unable to create message!");
+		return nullptr;
+	}
+
+	//Set the message target connection
+	pMessage->m_conn = destination;
+
+	return pMessage;
+}
+
 SteamNetworkingMessage_t *create_mini_message(MessageType_t messageType, unsigned int value, const HSteamNetConnection &destination) {
-	//Create the message data
+	//Create the message (the data gets written straight into the message buffer, no temporary buffer needed)
 	const int sizeOfData = 1 + sizeof(unsigned int);
-	Vector<unsigned char> data;
-	data.resize(sizeOfData);
+	SteamNetworkingMessage_t *pMessage = allocate_empty_message(sizeOfData, destination);
+	if (!pMessage) {
+		return nullptr;
+	}
+	unsigned char *data = static_cast<unsigned char *>(pMessage->m_pData);
 
 	//Assign message type in the buffer
-	data.set(0, messageType);
+	data[0] = messageType;
 
 	//Populate message data
-	serialize_uint(value, 1, data);
-
-	unsigned char* test = data.ptrw();
+	serialize_basic(codec_byte_order(static_cast<uint32_t>(value)), 1, data);
 
 	// Return message
-	return allocate_message(data.ptr(), sizeOfData, destination);
+	return pMessage;
 }
 
 SteamNetworkingMessage_t *create_small_message(MessageType_t messageType, unsigned int value1, unsigned int value2, const HSteamNetConnection &destination) {
-	// Create the message data
-	const int sizeOfData = 1 + (2 * sizeof(unsigned int));
-	Vector<unsigned char> data;
-	data.resize(sizeOfData);
+	//Create the message (the data gets written straight into the message buffer, no temporary buffer needed)
+	const int sizeOfData = 1 + (2 * sizeof(uint32_t));
+	SteamNetworkingMessage_t *pMessage = allocate_empty_message(sizeOfData, destination);
+	if (!pMessage) {
+		return nullptr;
+	}
+	unsigned char *data = static_cast<unsigned char *>(pMessage->m_pData);
 
 	//Assign message type in the buffer
-	data.set(0, messageType);
+	data[0] = messageType;
 
 	// Populate the message data
-	//TODO: Maybe reconsider hardcoding the start index, different architectures could define the size of the types diffently and byte ;) me in the ass.
-	serialize_uint(value1, 1, data);
-	serialize_uint(value2, 5, data);
+	serialize_basic(codec_byte_order(static_cast<uint32_t>(value1)), 1, data);
+	serialize_basic(codec_byte_order(static_cast<uint32_t>(value2)), 1 + sizeof(uint32_t), data);
 
 	// Return the message
-	return allocate_message(data.ptr(), sizeOfData, destination);
+	return pMessage;
 }
 
 
-void serialize_int(int value, int startIdx, Vector<unsigned char> &buffer){
-	for (int i = startIdx; i < startIdx + sizeof(int); i++) {
-		buffer.set(i, static_cast<unsigned char>(value & 0xFF));
-		value >>= 8;
+int serialize_varint(uint32_t value, unsigned char *buffer) {
+	int bytesWritten = 0;
+
+	//Write 7 bits at a time, using the top bit to mark that more bytes follow
+	while (value >= 0x80) {
+		buffer[bytesWritten++] = static_cast<unsigned char>(value | 0x80);
+		value >>= 7;
 	}
+	buffer[bytesWritten++] = static_cast<unsigned char>(value);
+
+	return bytesWritten;
+}
+
+void serialize_int(int value, int startIdx, Vector<unsigned char> &buffer){
+	//One store in wire byte order (ptrw only does the copy on write check once)
+	serialize_basic(codec_byte_order(static_cast<int32_t>(value)), startIdx, buffer);
 }
 
 void serialize_uint(unsigned int value, int startIdx, Vector<unsigned char> &buffer) {
-	for (int i = startIdx; i < startIdx + sizeof(unsigned int); i++) {
-		buffer.set(i, static_cast<unsigned char>(value & 0xFF));
-		value >>= 8;
-	}
+	//One store in wire byte order (ptrw only does the copy on write check once)
+	serialize_basic(codec_byte_order(static_cast<uint32_t>(value)), startIdx, buffer);
 }
 
 void serialize_vector3(const Vector3 &vec, int startIdx, Vector<unsigned char> &buffer){
@@ -91,6 +119,18 @@ void serialize_transform3d(const Transform3D &transform, int startIdx, Vector<un
 	memcpy(buffer.ptrw() + startIdx, &basis, sizeof(Basis));
 }
 
+void serialize_transform3d(const Transform3D &transform, int startIdx, unsigned char *buffer){
+	Vector3 origin = transform.get_origin();
+	Basis basis = transform.get_basis();
+
+	//Serialize the origin
+	memcpy(buffer + startIdx, &origin, sizeof(Vector3));
+	startIdx += sizeof(Vector3);
+
+	//Serialize the basis
+	memcpy(buffer + startIdx, &basis, sizeof(Basis));
+}
+
 void serialize_transform2d(const Transform2D &transform, int startIdx, Vector<unsigned char> &buffer){
 	memcpy(buffer.ptrw() + startIdx, &transform, sizeof(Transform2D));
 }
@@ -110,39 +150,42 @@ void serialize_transform2d(const Transform2D &transform, int startIdx, Vector<un
 //	return incomingVal;
 //}
 
-int deserialize_int(int startIdx, const unsigned char* buffer){
-	int res = 0;
-	int shiftAmt = 0;
+bool deserialize_varint(const unsigned char *buffer, int bufferLen, int &idx, uint32_t &value) {
+	value = 0U;
+
+	//A 32 bit value never takes more than 5 bytes
+	for (int shiftAmt = 0; shiftAmt < 35; shiftAmt += 7) {
+		if (idx >= bufferLen) {
+			return false;
+		}
 
-	for(int i = startIdx; i < startIdx + sizeof(unsigned int); i++){
-		res |= buffer[i] << (8 * shiftAmt);
-		shiftAmt++;
+		unsigned char byte = buffer[idx++];
+		value |= static_cast<uint32_t>(byte & 0x7F) << shiftAmt;
+
+		if (!(byte & 0x80)) {
+			return true;
+		}
 	}
 
-	return res;
+	return false;
 }
 
-unsigned int deserialize_uint(int startIdx, const unsigned char* buffer){
-	unsigned int res = 0U;
-	int shiftAmt = 0;
-
-	for(int i = startIdx; i < startIdx + sizeof(unsigned int); i++){
-		res |= buffer[i] << (8 * shiftAmt);
-		shiftAmt++;
-	}
+int deserialize_int(int startIdx, const unsigned char* buffer){
+	//One load in wire byte order
+	return codec_byte_order(deserialize_basic<int32_t>(startIdx, buffer));
+}
 
-	return res;
+unsigned int deserialize_uint(int startIdx, const unsigned char* buffer){
+	//One load in wire byte order
+	return codec_byte_order(deserialize_basic<uint32_t>(startIdx, buffer));
 }
 
 String deserialize_string(int startIdx, int stringLength, const unsigned char* buffer){
-	Vector<unsigned char> strData;
-	strData.resize(stringLength);
-
-	for(int i = 0; i < stringLength; i++){
-		strData.set(i, buffer[startIdx + i]);
-	}
+	//Parse the UTF-8 straight out of the buffer
+	String str;
+	str.parse_utf8(reinterpret_cast<const char *>(buffer + startIdx), stringLength);
 
-	return String((const char*)strData.ptr());
+	return str;
 }
 
 Vector3 deserialize_vector3(int startIdx, const unsigned char *buffer){
@@ -180,16 +223,90 @@ void deserialize_small(const unsigned char *data, unsigned int &value1, unsigned
 }
 
 
-void send_message_reliable(SteamNetworkingMessage_t *message) {
-	//Send the message
-	SteamNetworkingSockets()->SendMessageToConnection(message->m_conn, message->m_pData, message->m_cbSize, k_nSteamNetworkingSend_Reliable, nullptr);
-	//Free memory from the message
-	message->Release();
+bool configure_connection_lanes(const HSteamNetConnection &connection) {
+	//Lower priority values are always serviced first. Lanes that share a priority split the bandwidth by weight.
+	//Control messages always go out first. State sync and gameplay share the rest of the bandwidth, so a burst of
+	//reliable gameplay messages cant starve state sync (or the other way around).
+	const int lanePriorities[LANE_COUNT] = { 10, 0, 10 };
+	const uint16 laneWeights[LANE_COUNT] = { 3, 1, 2 };
+
+	if (SteamNetworkingSockets()->ConfigureConnectionLanes(connection, LANE_COUNT, lanePriorities, laneWeights) != k_EResultOK) {
+		ERR_PRINT("Unable to configure connection lanes!");
+		return false;
+	}
+
+	return true;
 }
 
-void send_message_unreliable(SteamNetworkingMessage_t *message){
-	//Send the message
-	SteamNetworkingSockets()->SendMessageToConnection(message->m_conn, message->m_pData, message->m_cbSize, k_nSteamNetworkingSend_Unreliable, nullptr);
-	//Free memory from the message
-	message->Release();
+static void send_message(SteamNetworkingMessage_t *message, int sendFlags, MessageLane_t lane) {
+	//Set the delivery options for the message
+	message->m_nFlags = sendFlags;
+	message->m_idxLane = lane;
+
+	//Hand the message over to the library. It takes ownership of the message and frees it once sent,
+	//so the data doesnt have to be copied again like it would be with SendMessageToConnection.
+	int64 result;
+	SteamNetworkingSockets()->SendMessages(1, &message, &result);
+
+	if (result < 0 && (sendFlags & k_nSteamNetworkingSend_Reliable)) {
+		ERR_PRINT(vformat("Unable to send reliable message! (EResult %d)", -result));
+	}
+}
+
+void send_message_reliable(SteamNetworkingMessage_t *message, MessageLane_t lane) {
+	send_message(message, k_nSteamNetworkingSend_Reliable, lane);
+}
+
+void send_message_unreliable(SteamNetworkingMessage_t *message, MessageLane_t lane) {
+	send_message(message, k_nSteamNetworkingSend_Unreliable, lane);
+}
+
+//Keeps the original message (and the data it owns) alive until every message sharing its data has been released
+struct SharedMessage_t {
+	std::atomic<int> refCount;
+	SteamNetworkingMessage_t *owner;
+};
+
+static void release_shared_message_data(SteamNetworkingMessage_t *message) {
+	SharedMessage_t *sharedMessage = reinterpret_cast<SharedMessage_t *>(message->m_nUserData);
+	if(sharedMessage->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1){
+		sharedMessage->owner->Release();
+		memdelete(sharedMessage);
+	}
+}
+
+void send_shared_message_unreliable(SteamNetworkingMessage_t *message, const HSteamNetConnection *destinations, int destinationCount, MessageLane_t lane) {
+	if(destinationCount <= 0){
+		message->Release();
+		return;
+	}
+
+	//A single destination can just take the message itself
+	if(destinationCount == 1){
+		message->m_conn = destinations[0];
+		send_message_unreliable(message, lane);
+		return;
+	}
+
+	SharedMessage_t *sharedMessage = memnew(SharedMessage_t);
+	sharedMessage->refCount.store(destinationCount, std::memory_order_relaxed);
+	sharedMessage->owner = message;
+
+	//Every destination gets an empty message pointing at the original message's data. The last one to be released frees it.
+	LocalVector<SteamNetworkingMessage_t *> messages;
+	messages.resize(destinationCount);
+	for(int i = 0; i < destinationCount; i++){
+		SteamNetworkingMessage_t *sharedView = SteamNetworkingUtils()->AllocateMessage(0);
+		sharedView->m_pData = message->m_pData;
+		sharedView->m_cbSize = message->m_cbSize;
+		sharedView->m_pfnFreeData = &release_shared_message_data;
+		sharedView->m_nUserData = reinterpret_cast<int64>(sharedMessage);
+		sharedView->m_conn = destinations[i];
+		sharedView->m_nFlags = k_nSteamNetworkingSend_Unreliable;
+		sharedView->m_idxLane = lane;
+		messages[i] = sharedView;
+	}
+
+	//Hand them all over in one go
+	SteamNetworkingSockets()->SendMessages(destinationCount, messages.ptr(), nullptr);
 }
@@ -2,18 +2,82 @@
 
 NetworkEntity::NetworkEntity() {
 	m_parentZone = nullptr;
+	m_serverLogic = false;
+	m_dormancyTicks = DEFAULT_DORMANCY_TICKS;
+	m_idleTicks = 0;
+	m_dormancyRequested.store(false);
+	m_changed.store(false);
+	m_dormant.store(false);
+}
+
+//Must be called from main thread only
+void NetworkEntity::reset_for_reuse() {
+	m_info.unref();
+	m_parentZone = nullptr;
+	//Keeps a wake that is still queued up from reconnecting a despawned entity
+	m_dormant.store(false);
+
+	if(m_transform3DSync.is_valid()){
+		m_transform3DSync->reset();
+	}
+
+	if(m_transform2DSync.is_valid()){
+		m_transform2DSync->reset();
+	}
+
+	if(m_propertySync.is_valid()){
+		m_propertySync->reset();
+	}
+
+	if(m_animationSync.is_valid()){
+		m_animationSync->reset();
+	}
 }
 
 void NetworkEntity::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_transform3d_sync"), &NetworkEntity::get_transform3d_sync);
 	ClassDB::bind_method(D_METHOD("get_transform2d_sync"), &NetworkEntity::get_transform2d_sync);
+	ClassDB::bind_method(D_METHOD("get_property_sync"), &NetworkEntity::get_property_sync);
+	ClassDB::bind_method(D_METHOD("get_animation_sync"), &NetworkEntity::get_animation_sync);
 	ClassDB::bind_method(D_METHOD("get_entity_info"), &NetworkEntity::get_entity_info);
+	ClassDB::bind_method(D_METHOD("get_server_logic"), &NetworkEntity::get_server_logic);
+	ClassDB::bind_method(D_METHOD("set_server_logic", "server_logic"), &NetworkEntity::set_server_logic);
+	ClassDB::bind_method(D_METHOD("get_dormancy_ticks"), &NetworkEntity::get_dormancy_ticks);
+	ClassDB::bind_method(D_METHOD("set_dormancy_ticks", "dormancy_ticks"), &NetworkEntity::set_dormancy_ticks);
+	ClassDB::bind_method(D_METHOD("wake"), &NetworkEntity::wake);
+	ClassDB::bind_method(D_METHOD("is_dormant"), &NetworkEntity::is_dormant);
 
 	ClassDB::bind_method(D_METHOD("set_transform3d_sync", "transform3d_sync"), &NetworkEntity::set_transform3d_sync);
 	ClassDB::bind_method(D_METHOD("set_transform2d_sync", "transform2d_sync"), &NetworkEntity::set_transform2d_sync);
+	ClassDB::bind_method(D_METHOD("set_property_sync", "property_sync"), &NetworkEntity::set_property_sync);
+	ClassDB::bind_method(D_METHOD("set_animation_sync", "animation_sync"), &NetworkEntity::set_animation_sync);
+
+	ClassDB::bind_method(D_METHOD("register_rpc", "method", "reliable"), &NetworkEntity::register_rpc, DEFVAL(true));
+
+	{
+		MethodInfo mi;
+		mi.name = "rpc_server";
+		mi.arguments.push_back(PropertyInfo(Variant::STRING_NAME, "method"));
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "rpc_server", &NetworkEntity::_rpc_server_bind, mi);
+
+		mi.name = "rpc_owner";
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "rpc_owner", &NetworkEntity::_rpc_owner_bind, mi);
+
+		mi.name = "rpc_zone";
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "rpc_zone", &NetworkEntity::_rpc_zone_bind, mi);
+	}
 
 	ClassDB::bind_method(D_METHOD("client_side_transmit_data"), &NetworkEntity::CLIENT_SIDE_transmit_data);
 	ClassDB::bind_method(D_METHOD("server_side_transmit_data"), &NetworkEntity::SERVER_SIDE_transmit_data);
+	ClassDB::bind_method(D_METHOD("_enter_dormancy"), &NetworkEntity::enter_dormancy);
+	ClassDB::bind_method(D_METHOD("_exit_dormancy"), &NetworkEntity::exit_dormancy);
+
+	//Whether a headless server still has to instantiate this entity to run its logic
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "server_logic"), "set_server_logic", "get_server_logic");
+	//How many network ticks the entity can go unchanged before it stops being ticked and sent, 0 never lets it sleep
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "dormancy_ticks", PROPERTY_HINT_RANGE, "0,100000,1"), "set_dormancy_ticks", "get_dormancy_ticks");
+
+	ADD_SIGNAL(MethodInfo("ownership_changed", PropertyInfo(Variant::INT, "previous_owner_id"), PropertyInfo(Variant::INT, "owner_id")));
 }
 
 void NetworkEntity::_notification(int n_type) {
@@ -38,10 +102,25 @@ void NetworkEntity::_notification(int n_type) {
 			_process(get_process_delta_time());
 			break;
 		}
+		case NOTIFICATION_INTERNAL_PROCESS:{
+			//Pick up property and animation changes made this frame, the tick thread sends them
+			if(m_propertySync.is_valid()){
+				m_propertySync->SERVER_SIDE_sample_properties();
+			}
+			if(m_animationSync.is_valid()){
+				m_animationSync->SERVER_SIDE_sample_state();
+			}
+			break;
+		}
 	}
 }
 
 void NetworkEntity::_ready() {
+	//Synced properties and animation are sampled once per frame on the server
+	if(GDNet::singleton->m_isServer && (m_propertySync.is_valid() || m_animationSync.is_valid())){
+		set_process_internal(true);
+	}
+
 	if(GDNet::singleton->is_client()){
 		if(m_transform3DSync.is_valid() && m_transform3DSync->has_target()){
 			//Set the starting transform so it doesnt start interpolating from the origin
@@ -84,45 +163,161 @@ bool NetworkEntity::has_ownership() {
 	return false;
 }
 
-void NetworkEntity::SERVER_SIDE_recieve_data(EntityUpdateInfo_t updateInfo) {
+//Call this on the main thread, after the entity's owner changed
+void NetworkEntity::on_ownership_changed(PlayerID_t previousOwner) {
+	//Whoever starts (or stops) interpolating picks up from where the entity is now rather than from old sync data
+	if(GDNet::singleton->is_client()){
+		if(m_transform3DSync.is_valid() && m_transform3DSync->has_target()){
+			m_transform3DSync->update_transform_data();
+		}
+
+		if(m_transform2DSync.is_valid() && m_transform2DSync->has_target()){
+			m_transform2DSync->update_transform_data();
+		}
+	}
+
+	//The new owner is sending from its own copy, so make sure everyone hears about the entity again
+	wake();
+	emit_signal("ownership_changed", previousOwner, m_info->get_owner_id());
+}
+
+//Must be called from main thread only
+void NetworkEntity::connect_transmit() {
+	const char *signal = GDNet::singleton->m_isServer ? "_server_side_transmit_entity_data" : "_client_side_transmit_entity_data";
+	Callable transmitCallback = Callable(this, GDNet::singleton->m_isServer ? "server_side_transmit_data" : "client_side_transmit_data");
+
+	if(!GDNet::singleton->world->is_connected(signal, transmitCallback)){
+		GDNet::singleton->world->connect(signal, transmitCallback);
+	}
+
+	//Count the entity as changed so it sends its state at least once before it can go dormant again
+	m_dormant.store(false);
+	m_idleTicks = 0;
+	m_changed.store(true);
+}
+
+//Must be called from main thread only
+void NetworkEntity::disconnect_transmit() {
+	const char *signal = GDNet::singleton->m_isServer ? "_server_side_transmit_entity_data" : "_client_side_transmit_entity_data";
+	Callable transmitCallback = Callable(this, GDNet::singleton->m_isServer ? "server_side_transmit_data" : "client_side_transmit_data");
+
+	if(GDNet::singleton->world->is_connected(signal, transmitCallback)){
+		GDNet::singleton->world->disconnect(signal, transmitCallback);
+	}
+}
+
+//Call this from the tick thread, after the modules had their tick
+void NetworkEntity::tick_dormancy() {
+	if(m_changed.exchange(false)){
+		m_idleTicks = 0;
+		return;
+	}
+
+	int dormancyTicks = m_dormancyTicks;
+	if(dormancyTicks <= 0){
+		return;
+	}
+
+	if(m_idleTicks < dormancyTicks){
+		m_idleTicks++;
+	}
+
+	//The threshold can be lowered below the idle count at any time, so anything past it counts too.
+	//Disconnecting from the signal has to happen on the main thread, so only ask again once the last request was handled.
+	if(m_idleTicks >= dormancyTicks && !m_dormancyRequested.exchange(true)){
+		call_deferred("_enter_dormancy");
+	}
+}
+
+//Must be called from main thread only
+void NetworkEntity::enter_dormancy() {
+	m_dormancyRequested.store(false);
+
+	if(m_dormant.load() || m_changed.load() || m_info.is_null()){
+		return;
+	}
+
+	disconnect_transmit();
+	m_dormant.store(true);
+
+	//A change that came in while disconnecting would never have queued a wake
+	if(m_changed.load()){
+		exit_dormancy();
+	}
+}
+
+//Must be called from main thread only
+void NetworkEntity::exit_dormancy() {
+	//Despawned entities stay off the tick, even if a wake was still queued up for them
+	if(!m_dormant.exchange(false) || !is_inside_tree()){
+		return;
+	}
+
+	connect_transmit();
+}
+
+//Safe to call from any thread. Marks the entity as changed and, if it was dormant, puts it back on the tick.
+void NetworkEntity::wake() {
+	m_changed.store(true);
+	if(m_dormant.load()){
+		call_deferred("_exit_dormancy");
+	}
+}
+
+bool NetworkEntity::is_dormant() const {
+	return m_dormant.load();
+}
+
+bool NetworkEntity::SERVER_SIDE_recieve_data(EntityUpdateInfo_t updateInfo) {
 	switch (updateInfo.updateType) {
 		case TRANSFORM3D_SYNC_UPDATE:{
 			//Make sure a Transform3DSync module instance exists in case :p
 			if(m_transform3DSync.is_valid()){
-				m_transform3DSync->recieve_data(updateInfo);
+				return m_transform3DSync->recieve_data(updateInfo);
 			}
 			break;
 		}
 		case TRANSFORM2D_SYNC_UPDATE:{
 			if(m_transform2DSync.is_valid()){
-				m_transform2DSync->recieve_data(updateInfo);
+				return m_transform2DSync->recieve_data(updateInfo);
 			}
+			break;
 		}
 	}
+
+	//Either the update type is unknown or the entity doesnt have the module it is meant for.
+	//Properties and animation are server authoritative, so their updates from clients end up here too.
+	return false;
 }
 
 void NetworkEntity::SERVER_SIDE_transmit_data() {
-	//If a transform3dsync object was assigned, use it.
-//	if(m_transform3DSync.is_valid()){
-//		//Send the data to all players in the zone
-//		for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : m_parentZone->m_playersInZone){
-//			m_transform3DSync->transmit_data(player.value->get_player_conn());
-//		}
-//	}
+	if(m_transform3DSync.is_valid()){
+		m_transform3DSync->tick();
+	}
 
 	if(m_transform2DSync.is_valid()){
 		m_transform2DSync->tick();
 	}
+
+	if(m_propertySync.is_valid()){
+		m_propertySync->tick();
+	}
+
+	if(m_animationSync.is_valid()){
+		m_animationSync->tick();
+	}
+
+	tick_dormancy();
 }
 
-void NetworkEntity::CLIENT_SIDE_recieve_data(EntityUpdateInfo_t updateInfo) {
+bool NetworkEntity::CLIENT_SIDE_recieve_data(EntityUpdateInfo_t updateInfo) {
 	switch (updateInfo.updateType) {
 		case TRANSFORM3D_SYNC_UPDATE:{
 			//Make sure a Transform3DSync module instance exists in case :p
 			if(m_transform3DSync.is_valid()){
 				//Only read from the data if the endpoint does not have authority
 				if(!m_transform3DSync->has_authority()){
-					m_transform3DSync->recieve_data(updateInfo);
+					return m_transform3DSync->recieve_data(updateInfo);
 				}
 			}
 			break;
@@ -133,23 +328,39 @@ void NetworkEntity::CLIENT_SIDE_recieve_data(EntityUpdateInfo_t updateInfo) {
 			if(m_transform2DSync.is_valid()){
 				//Only read from the data if the endpoint does not have authority
 				if(!m_transform2DSync->has_authority()){
-					m_transform2DSync->recieve_data(updateInfo);
+					return m_transform2DSync->recieve_data(updateInfo);
 				}
 			}
 			break;
 		}
+		case PROPERTY_SYNC_UPDATE:
+		case PROPERTY_SYNC_OWNER_UPDATE:{
+			if(m_propertySync.is_valid()){
+				return m_propertySync->recieve_data(updateInfo);
+			}
+			break;
+		}
+		case ANIMATION_SYNC_UPDATE:{
+			if(m_animationSync.is_valid()){
+				return m_animationSync->recieve_data(updateInfo);
+			}
+			break;
+		}
 	}
+
+	return false;
 }
 
 void NetworkEntity::CLIENT_SIDE_transmit_data() {
-	//If a transform3dsync object was assigned, use it.
-//	if(m_transform3DSync.is_valid() && m_transform3DSync->has_authority()){
-//		m_transform3DSync->transmit_data(GDNet::singleton->world->m_worldConnection);
-//	}
+	if(m_transform3DSync.is_valid()){
+		m_transform3DSync->tick();
+	}
 
 	if(m_transform2DSync.is_valid()){
 		m_transform2DSync->tick();
 	}
+
+	tick_dormancy();
 }
 
 
@@ -161,10 +372,76 @@ Ref<Transform2DSync> NetworkEntity::get_transform2d_sync() {
 	return m_transform2DSync;
 }
 
+Ref<PropertySync> NetworkEntity::get_property_sync() {
+	return m_propertySync;
+}
+
+Ref<AnimationSync> NetworkEntity::get_animation_sync() {
+	return m_animationSync;
+}
+
 Ref<EntityInfo> NetworkEntity::get_entity_info() {
 	return m_info;
 }
 
+//Rpcs get sent as ids, so every peer has to register the same methods in the same order
+bool NetworkEntity::register_rpc(const StringName &method, bool reliable) {
+	ERR_FAIL_COND_V_MSG(!m_rpcTable.register_method(method, reliable), false, vformat("\"%s\" is already registered as an rpc with a different reliability!", method));
+	return true;
+}
+
+const RpcTable &NetworkEntity::get_rpc_table() const {
+	return m_rpcTable;
+}
+
+
+Error NetworkEntity::_rpc_server_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+	StringName method;
+	if(!RpcTable::get_call_method(p_args, p_argcount, r_error, method)){
+		return ERR_INVALID_PARAMETER;
+	}
+
+	return GDNet::singleton->world->send_rpc(RPC_TARGET_SERVER, nullptr, this, method, p_args + 1, p_argcount - 1);
+}
+
+Error NetworkEntity::_rpc_owner_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+	StringName method;
+	if(!RpcTable::get_call_method(p_args, p_argcount, r_error, method)){
+		return ERR_INVALID_PARAMETER;
+	}
+
+	return GDNet::singleton->world->send_rpc(RPC_TARGET_OWNER, nullptr, this, method, p_args + 1, p_argcount - 1);
+}
+
+Error NetworkEntity::_rpc_zone_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+	StringName method;
+	if(!RpcTable::get_call_method(p_args, p_argcount, r_error, method)){
+		return ERR_INVALID_PARAMETER;
+	}
+
+	return GDNet::singleton->world->send_rpc(RPC_TARGET_ZONE, nullptr, this, method, p_args + 1, p_argcount - 1);
+}
+
+bool NetworkEntity::get_server_logic() const {
+	return m_serverLogic;
+}
+
+void NetworkEntity::set_server_logic(bool serverLogic) {
+	m_serverLogic = serverLogic;
+}
+
+int NetworkEntity::get_dormancy_ticks() const {
+	return m_dormancyTicks;
+}
+
+void NetworkEntity::set_dormancy_ticks(int dormancyTicks) {
+	m_dormancyTicks = MAX(dormancyTicks, 0);
+	//Turning dormancy off has to bring a sleeping entity back
+	if(m_dormancyTicks == 0){
+		wake();
+	}
+}
+
 
 void NetworkEntity::set_transform3d_sync(Ref<Transform3DSync> transform3DSync) {
 	m_transform3DSync = transform3DSync;
@@ -176,6 +453,16 @@ void NetworkEntity::set_transform2d_sync(Ref<Transform2DSync> transform2DSync) {
 	m_transform2DSync->m_parentNetworkEntity = this;
 }
 
+void NetworkEntity::set_property_sync(Ref<PropertySync> propertySync) {
+	m_propertySync = propertySync;
+	m_propertySync->m_parentNetworkEntity = this;
+}
+
+void NetworkEntity::set_animation_sync(Ref<AnimationSync> animationSync) {
+	m_animationSync = animationSync;
+	m_animationSync->m_parentNetworkEntity = this;
+}
+
 
 
 
@@ -1,9 +1,7 @@
 #include "gdnet.h"
 
-const int NetworkModule::METADATA_SIZE = 1 + sizeof(ZoneID_t) + sizeof(EntityNetworkID_t) + 1;
-
 void NetworkModule::serialize_payload(EntityUpdateInfo_t &updateInfo) {}
-void NetworkModule::deserialize_payload(const EntityUpdateInfo_t &updateInfo) {}
+bool NetworkModule::deserialize_payload(const EntityUpdateInfo_t &updateInfo) { return false; }
 
 void NetworkModule::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_transmission_rate"), &NetworkModule::get_transmission_rate);
@@ -13,54 +11,45 @@ void NetworkModule::_bind_methods() {
 }
 
 void NetworkModule::tick() {}
-void NetworkModule::transmit_data(HSteamNetConnection destination) {}
-void NetworkModule::recieve_data(EntityUpdateInfo_t updateInfo) {}
-
-void NetworkModule::serialize_update_metadata(EntityUpdateInfo_t &updateInfo) {
-	updateInfo.dataBuffer.resize(METADATA_SIZE);
-	int bufferIdx = 0;
-
-	//Set the message type of the message data
-	updateInfo.dataBuffer.set(bufferIdx, NETWORK_ENTITY_UPDATE);
-	bufferIdx += 1;
+bool NetworkModule::build_update(EntityUpdateInfo_t &updateInfo) { return false; }
+bool NetworkModule::recieve_data(EntityUpdateInfo_t updateInfo) { return false; }
 
-	//Serialize the parent zone ID into the message data
-	serialize_uint(updateInfo.parentZone, bufferIdx, updateInfo.dataBuffer);
-	bufferIdx += sizeof(ZoneID_t );
-
-	//Serialize the network ID into the message data
-	serialize_uint(updateInfo.networkId, bufferIdx, updateInfo.dataBuffer);
-	bufferIdx += sizeof(EntityNetworkID_t);
+void NetworkModule::transmit_data(HSteamNetConnection destination) {
+	EntityUpdateInfo_t updateInfo;
+	if(!build_update(updateInfo)){
+		return;
+	}
 
-	//Add the update type tot he message data
-	updateInfo.dataBuffer.set(bufferIdx, updateInfo.updateType);
+	//Pack the update into the destination's state frame for this tick
+	GDNet::singleton->world->queue_entity_update(destination, updateInfo);
 }
 
-EntityUpdateInfo_t NetworkModule::deserialize_update_metadata(const unsigned char *mssgData, const int mssgLen) {
-	//Create a new entity update object
+//Serializes the update once and hands the same payload to every player in the zone
+void NetworkModule::SERVER_SIDE_broadcast_data() {
 	EntityUpdateInfo_t updateInfo;
-
-	//Load message data into the update info data buffer
-	updateInfo.dataBuffer.resize(mssgLen);
-	for(int i = 0; i < mssgLen; ++i){
-		updateInfo.dataBuffer.set(i, mssgData[i]);
+	if(!build_update(updateInfo)){
+		return;
 	}
 
-	//Use a data index counter in case data type sizes differ between architecture
-	int dataIdx = 1;
+	m_parentNetworkEntity->m_parentZone->SERVER_SIDE_broadcast_update(updateInfo, m_maxTickCount);
+}
 
-	//Deserialize the parent zone ID
-	updateInfo.parentZone = deserialize_uint(dataIdx, mssgData);
-	dataIdx += sizeof(ZoneID_t);
+void NetworkModule::reset() {
+	m_tickCount = 0;
+}
 
-	//Deserialize the entity network ID
-	updateInfo.networkId = deserialize_uint(dataIdx, mssgData);
-	dataIdx += sizeof(EntityNetworkID_t);
+unsigned char *NetworkModule::allocate_payload(EntityUpdateInfo_t &updateInfo, int payloadSize) {
+	//Payloads only need to live until they are packed into a state frame, so they come out of the thread's arena
+	unsigned char *payload = FrameArena::get_thread_arena().allocate(payloadSize);
 
-	//Deserialize (not really lol) the update type
-	updateInfo.updateType = mssgData[dataIdx];
+	updateInfo.payload = payload;
+	updateInfo.payloadSize = payloadSize;
+
+	return payload;
+}
 
-	return updateInfo;
+int NetworkModule::get_tick_interval() const {
+	return m_maxTickCount;
 }
 
 int NetworkModule::get_transmission_rate() const {
@@ -1,26 +1,39 @@
 #include "gdnet.h"
 
 PlayerInfo::PlayerInfo(){
-	m_playerInfo.loadedPlayersInZone = false;
-	m_playerInfo.loadedEntitiesInZone = false;
+	m_playerInfo.id = 0;
 	m_playerInfo.currentLoadedZone = nullptr;
+	m_playerInfo.playerConnection = k_HSteamNetConnection_Invalid;
 }
 PlayerInfo::~PlayerInfo(){}
 
-void PlayerInfo::_bind_methods() {}
+void PlayerInfo::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_clock_offset"), &PlayerInfo::get_clock_offset);
+	ClassDB::bind_method(D_METHOD("get_round_trip_time"), &PlayerInfo::get_round_trip_time);
+}
+
+void PlayerInfo::load_player(Ref<PlayerInfo> playerInfo, Zone *zone) {
+	ZoneSubscription_t *subscription = get_zone_subscription(zone->get_zone_id());
+	if(!subscription){
+		return;
+	}
 
-void PlayerInfo::load_player(Ref<PlayerInfo> playerInfo) {
-	//Add player (player ID) to the ACK waiting buffer
-	m_playerInfo.playersWaitingForLoadAck.push_back(playerInfo->get_player_id());
+	//Add player (player ID) to the zone's ACK waiting buffer
+	subscription->playersWaitingForLoadAck.push_back(playerInfo->get_player_id());
 
-	//Create a mini message containing the player id
-	SteamNetworkingMessage_t *playerRequestMssg = create_mini_message(CREATE_ZONE_PLAYER_INFO_REQUEST, playerInfo->get_player_id(), get_player_conn());
+	//Create a small message containing the player id and the zone they are being loaded into
+	SteamNetworkingMessage_t *playerRequestMssg = create_small_message(CREATE_ZONE_PLAYER_INFO_REQUEST, playerInfo->get_player_id(), zone->get_zone_id(), get_player_conn());
 
-	//Send the message to the loading player
-	send_message_reliable(playerRequestMssg);
+	//Send the message to the loading player (down the same lane as the entities the player might own)
+	send_message_reliable(playerRequestMssg, LANE_GAMEPLAY);
 }
 
 void PlayerInfo::load_entity(Ref<EntityInfo> entityInfo) {
+	ZoneSubscription_t *subscription = get_zone_subscription(entityInfo->m_entityInfo.parentZone);
+	if(!subscription){
+		return;
+	}
+
 	//Reserialize the entity info
 	entityInfo->serialize_info();
 
@@ -31,19 +44,22 @@ void PlayerInfo::load_entity(Ref<EntityInfo> entityInfo) {
 	const unsigned char* mssgData = entityInfo->m_entityInfo.dataBuffer.ptr();
 	int dataLen = entityInfo->m_entityInfo.dataBuffer.size();
 
-	//Add the entity (network id) to the ACK waiting buffer
-	m_playerInfo.entitiesWaitingForLoadAck.push_back(entityInfo->m_entityInfo.networkId);
+	//Add the entity (network id) to the zone's ACK waiting buffer
+	subscription->entitiesWaitingForLoadAck.push_back(entityInfo->m_entityInfo.networkId);
 
-	//Create and send the message
+	//Create and send the message. Migrations, ownership transfers and players leaving all refer to entities
+	//created here, so they share the gameplay lane to make sure the client always sees the creation first.
 	SteamNetworkingMessage_t *createMssg = allocate_message(mssgData, dataLen, get_player_conn());
-	send_message_reliable(createMssg);
+	send_message_reliable(createMssg, LANE_GAMEPLAY);
 }
 
-void PlayerInfo::load_entities_in_current_zone() {
+void PlayerInfo::load_entities_in_zone(Zone *zone) {
 	// Make the player start loading all entities in the zone by intitiating the first entity load.
 	// This will start a chain of requests that eventually loads all entities on the player's end.
-	for(const KeyValue<EntityNetworkID_t, Ref<EntityInfo>> &element : get_current_loaded_zone()->m_entitiesInZone){
-		load_entity(element.value);
+	LocalVector<Ref<EntityInfo>> entities;
+	zone->get_entities(entities);
+	for(const Ref<EntityInfo> &entityInfo : entities){
+		load_entity(entityInfo);
 	}
 }
 
@@ -51,51 +67,94 @@ void PlayerInfo::add_owned_entity(Ref<EntityInfo> associatedEntity) {
 	m_playerInfo.ownedEntities.insert(associatedEntity->get_network_id(),associatedEntity);
 }
 
-void PlayerInfo::confirm_player_load(PlayerID_t playerId) {
-	print_line(vformat("CURRENT PLAYER: %d -- PLAYER THAT WAS LOADED: %d", get_player_id() ,playerId));
-	print_line(vformat("ACK waiting in buffer: %d", m_playerInfo.playersWaitingForLoadAck.size()));
+void PlayerInfo::remove_owned_entity(EntityNetworkID_t networkId) {
+	m_playerInfo.ownedEntities.erase(networkId);
+}
+
+void PlayerInfo::confirm_player_load(PlayerID_t playerId, ZoneID_t zoneId) {
+	ZoneSubscription_t *subscription = get_zone_subscription(zoneId);
+	if(!subscription){
+		return;
+	}
+
 	//Remove the player from the ACK buffer
-	m_playerInfo.playersWaitingForLoadAck.erase(playerId);
-	print_line(vformat("ACK waiting in buffer after removal: %d", m_playerInfo.playersWaitingForLoadAck.size()));
-	String option = m_playerInfo.loadedPlayersInZone ? "True" : "False";
-	print_line(vformat("LoadedPlayersInZoneBool: %s", option));
+	subscription->playersWaitingForLoadAck.erase(playerId);
 
 	//Once the ACK buffer is empty and the player has made player info copies for all players in the zone,
 	//start loading in all the entities in the zone
-	if(m_playerInfo.playersWaitingForLoadAck.size() == 0 && !m_playerInfo.loadedPlayersInZone){
-		print_line(vformat("NEW: Starting to load all entites in zone for player %d!", get_player_id()));
+	if(subscription->playersWaitingForLoadAck.size() == 0 && !subscription->loadedPlayersInZone){
 		//Mark that the player has loaded all other players in the zone locally
-		m_playerInfo.loadedPlayersInZone = true;
+		subscription->loadedPlayersInZone = true;
 
 		//Load all entiteis in the zone
-		load_entities_in_current_zone();
+		load_entities_in_zone(subscription->zone);
 	}
 }
 
-void PlayerInfo::confirm_entity_load(EntityNetworkID_t entityNetworkId) {
+void PlayerInfo::confirm_entity_load(EntityNetworkID_t entityNetworkId, ZoneID_t zoneId) {
+	ZoneSubscription_t *subscription = get_zone_subscription(zoneId);
+	if(!subscription){
+		return;
+	}
+
 	//Remove the entity from the ACK buffer
-	m_playerInfo.entitiesWaitingForLoadAck.erase(entityNetworkId);
+	subscription->entitiesWaitingForLoadAck.erase(entityNetworkId);
 
-	if(m_playerInfo.entitiesWaitingForLoadAck.size() == 0 && !m_playerInfo.loadedEntitiesInZone){
+	//A dormant entity wouldnt send the player anything until it changed, so have it send its current state
+	subscription->zone->call_deferred("_wake_entity", entityNetworkId);
+
+	if(subscription->entitiesWaitingForLoadAck.size() == 0 && !subscription->loadedEntitiesInZone){
 		//Mark that this player has loaded all entities in the zone
-		m_playerInfo.loadedEntitiesInZone = true;
+		subscription->loadedEntitiesInZone = true;
 
 		// Inform all players in the zone that this player has fully loaded into the zone
-		for (const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : m_playerInfo.currentLoadedZone->m_playersInZone) {
+		for (const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : subscription->zone->m_playersInZone) {
 			HSteamNetConnection destination = player.value->get_player_conn();
 			SteamNetworkingMessage_t *playerEnteredZoneMssg = create_mini_message(LOAD_ZONE_COMPLETE, get_player_id(), destination);
-			send_message_reliable(playerEnteredZoneMssg);
+			send_message_reliable(playerEnteredZoneMssg, LANE_GAMEPLAY);
 		}
 	}
 }
 
-void PlayerInfo::reset_zone_info() {
-	m_playerInfo.currentLoadedZone = nullptr;
-	m_playerInfo.ownedEntities.clear();
-	m_playerInfo.loadedPlayersInZone = false;
-	m_playerInfo.loadedEntitiesInZone = false;
-	m_playerInfo.entitiesWaitingForLoadAck.clear();
-	m_playerInfo.playersWaitingForLoadAck.clear();
+void PlayerInfo::subscribe_zone(Zone *zone) {
+	ZoneID_t zoneId = zone->get_zone_id();
+	if(m_playerInfo.loadedZones.has(zoneId)){
+		return;
+	}
+
+	ZoneSubscription_t subscription;
+	subscription.zone = zone;
+	subscription.loadedPlayersInZone = false;
+	subscription.loadedEntitiesInZone = false;
+	m_playerInfo.loadedZones.insert(zoneId, subscription);
+
+	//The first zone a player loads into is the one they are in, any others are neighbours until the player moves into them
+	if(!m_playerInfo.currentLoadedZone){
+		m_playerInfo.currentLoadedZone = zone;
+	}
+}
+
+void PlayerInfo::unsubscribe_zone(Zone *zone) {
+	m_playerInfo.loadedZones.erase(zone->get_zone_id());
+
+	//Fall back to one of the remaining loaded zones if the player unloaded the zone they were in
+	if(m_playerInfo.currentLoadedZone == zone){
+		m_playerInfo.currentLoadedZone = m_playerInfo.loadedZones.is_empty() ? nullptr : m_playerInfo.loadedZones.begin()->value.zone;
+	}
+}
+
+bool PlayerInfo::is_zone_loaded(ZoneID_t zoneId) {
+	return m_playerInfo.loadedZones.has(zoneId);
+}
+
+//sendCount counts how many times the update being sent has been sent so far (server tick / the module's tick interval)
+bool PlayerInfo::is_zone_relevant(ZoneID_t zoneId, uint64_t sendCount) {
+	//The zone the player is in always gets every update, neighbouring zones only get every n-th one
+	if(m_playerInfo.currentLoadedZone && m_playerInfo.currentLoadedZone->get_zone_id() == zoneId){
+		return true;
+	}
+
+	return sendCount % GDNet::singleton->world->get_neighbor_zone_update_interval() == 0;
 }
 
 
@@ -111,6 +170,20 @@ Zone *PlayerInfo::get_current_loaded_zone() {
 	return m_playerInfo.currentLoadedZone;
 }
 
+ZoneSubscription_t *PlayerInfo::get_zone_subscription(ZoneID_t zoneId) {
+	return m_playerInfo.loadedZones.getptr(zoneId);
+}
+
+//How far the server clock is ahead of the player's (in seconds)
+double PlayerInfo::get_clock_offset() const {
+	return m_clock.get_offset() / 1000000.0;
+}
+
+//Round trip time between the player and the server (in seconds)
+double PlayerInfo::get_round_trip_time() const {
+	return m_clock.get_round_trip_time() / 1000000.0;
+}
+
 
 void PlayerInfo::set_player_id(PlayerID_t playerId) {
 	m_playerInfo.id = playerId;
@@ -0,0 +1,314 @@
+#include "gdnet.h"
+
+PropertySync::PropertySync() {
+	m_target = nullptr;
+	m_dirtyBits = 0U;
+	m_sendCount = 0;
+}
+
+void PropertySync::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_target"), &PropertySync::get_target);
+	ClassDB::bind_method(D_METHOD("get_properties"), &PropertySync::get_properties);
+	ClassDB::bind_method(D_METHOD("get_property_count"), &PropertySync::get_property_count);
+	ClassDB::bind_method(D_METHOD("set_target", "target"), &PropertySync::set_target);
+	ClassDB::bind_method(D_METHOD("set_properties", "properties"), &PropertySync::set_properties);
+	ClassDB::bind_method(D_METHOD("add_property", "property", "transmission_rate", "owner_only"), &PropertySync::add_property, DEFVAL(0), DEFVAL(false));
+
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "target", PROPERTY_HINT_RESOURCE_TYPE, "Node"), "set_target", "get_target");
+	//Properties synced at the module rate and visible to everyone. Use add_property() for per property rates or owner only properties.
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_STRING_ARRAY, "properties"), "set_properties", "get_properties");
+}
+
+//===============Module===============//
+
+//Changes are sampled on the main thread (see SERVER_SIDE_sample_properties), so all the tick has to do is send them
+void PropertySync::tick() {
+	m_tickCount %= m_maxTickCount;
+
+	if(m_tickCount == 0 && GDNet::singleton->m_isServer && m_target){
+		//Every so often resend everything, covering players that loaded the entity in after a property last changed
+		if(++m_sendCount >= PROPERTY_SYNC_REFRESH_SENDS){
+			std::lock_guard<std::mutex> lock(m_propertyMutex);
+			for(uint32_t i = 0; i < m_properties.size(); i++){
+				if(!m_properties[i].encodedValue.is_empty()){
+					m_properties[i].pendingSends = MAX(m_properties[i].pendingSends, 1);
+					m_dirtyBits |= 1ULL << i;
+				}
+			}
+			m_sendCount = 0;
+		}
+
+		SERVER_SIDE_broadcast_data();
+
+		//Owner only properties go out to the owner on their own
+		PlayerID_t ownerId = m_parentNetworkEntity->m_info->get_owner_id();
+		Ref<PlayerInfo> owner = ownerId != 0 ? m_parentNetworkEntity->m_parentZone->get_player(ownerId) : Ref<PlayerInfo>();
+		EntityUpdateInfo_t updateInfo;
+		if(owner.is_valid() && build_property_update(updateInfo, true, GDNet::singleton->world->SERVER_SIDE_get_tick())){
+			GDNet::singleton->world->queue_entity_update(owner->get_player_conn(), updateInfo);
+		}
+	}
+
+	m_tickCount++;
+}
+
+bool PropertySync::build_update(EntityUpdateInfo_t &updateInfo) {
+	return build_property_update(updateInfo, false, GDNet::singleton->world->SERVER_SIDE_get_tick());
+}
+
+//Call this from the tick thread. Packs every dirty property of the given visibility that is due into one update.
+bool PropertySync::build_property_update(EntityUpdateInfo_t &updateInfo, bool ownerOnly, uint64_t serverTick) {
+	std::lock_guard<std::mutex> lock(m_propertyMutex);
+
+	if(m_dirtyBits == 0U || !m_target){
+		return false;
+	}
+
+	//Payloads have to fit in the recievers mailbox, properties that dont fit this time go out next time
+	unsigned char *payload = allocate_payload(updateInfo, MAX_INBOUND_PAYLOAD_SIZE);
+	MessageWriter writer(payload, MAX_INBOUND_PAYLOAD_SIZE);
+
+	for(uint32_t i = 0; i < m_properties.size(); i++){
+		SyncedProperty_t &property = m_properties[i];
+		if(!(m_dirtyBits & (1ULL << i)) || property.ownerOnly != ownerOnly || serverTick < property.nextSendTick){
+			continue;
+		}
+
+		//Property indices are always below MAX_SYNCED_PROPERTIES, so they take a single byte (plus one for the type)
+		int entrySize = 2 + property.encodedValue.size();
+		if(MAX_INBOUND_PAYLOAD_SIZE - writer.get_size() < entrySize){
+			continue;
+		}
+
+		writer.write_varint(i);
+		writer.write<uint8_t>(property.type);
+		writer.write_bytes(property.encodedValue.ptr(), property.encodedValue.size());
+		property.nextSendTick = serverTick + property.tickInterval;
+
+		property.pendingSends--;
+		if(property.pendingSends == 0){
+			m_dirtyBits &= ~(1ULL << i);
+		}
+	}
+
+	if(writer.get_size() == 0){
+		return false;
+	}
+
+	updateInfo.payloadSize = writer.get_size();
+	updateInfo.parentZone = m_parentNetworkEntity->m_info->m_entityInfo.parentZone;
+	updateInfo.networkId = m_parentNetworkEntity->m_info->m_entityInfo.networkId;
+	updateInfo.authorityEpoch = m_parentNetworkEntity->m_info->m_entityInfo.authorityEpoch;
+	updateInfo.updateType = ownerOnly ? PROPERTY_SYNC_OWNER_UPDATE : PROPERTY_SYNC_UPDATE;
+	return true;
+}
+
+//Must be called from main thread only
+bool PropertySync::recieve_data(EntityUpdateInfo_t updateInfo) {
+	//Properties are server authoritative, clients never get to change them
+	if(GDNet::singleton->m_isServer || !m_target){
+		return false;
+	}
+
+	MessageReader reader(updateInfo.payload, updateInfo.payloadSize);
+	while(reader.get_remaining() > 0){
+		uint32_t propertyIdx;
+		if(!reader.read_varint(propertyIdx) || propertyIdx >= m_properties.size()){
+			return false;
+		}
+
+		//Decode with the type that was sent, so a value that doesnt match the local property can still be skipped over
+		uint8_t type = Variant::VARIANT_MAX;
+		if(!reader.read(type) || type >= Variant::VARIANT_MAX || !is_codec_supported_type(static_cast<Variant::Type>(type))){
+			return false;
+		}
+
+		Variant value;
+		if(!decode_typed_value(reader, static_cast<Variant::Type>(type), value)){
+			return false;
+		}
+
+		const SyncedProperty_t &property = m_properties[propertyIdx];
+		if(property.type != type){
+			WARN_PRINT_ONCE(vformat("PropertySync property \"%s\" was sent as %s but is %s here, the server and client declare different properties!", property.name, Variant::get_type_name(static_cast<Variant::Type>(type)), Variant::get_type_name(property.type)));
+			continue;
+		}
+
+		m_target->set(property.name, value);
+	}
+
+	return true;
+}
+
+//Must be called from main thread only
+void PropertySync::reset() {
+	NetworkModule::reset();
+
+	//Forget the sent values so a reused entity sends all of its properties again
+	std::lock_guard<std::mutex> lock(m_propertyMutex);
+	for(SyncedProperty_t &property : m_properties){
+		property.encodedValue.clear();
+		property.pendingSends = 0;
+		property.nextSendTick = 0U;
+	}
+	m_dirtyBits = 0U;
+	m_sendCount = 0;
+}
+
+//Must be called from main thread only. Marks every property whose value changed since the last sample as dirty.
+void PropertySync::SERVER_SIDE_sample_properties() {
+	if(!m_target){
+		return;
+	}
+
+	unsigned char encoded[MAX_INBOUND_PAYLOAD_SIZE];
+
+	std::lock_guard<std::mutex> lock(m_propertyMutex);
+	for(uint32_t i = 0; i < m_properties.size(); i++){
+		SyncedProperty_t &property = m_properties[i];
+
+		//The type gets picked up from the first value the property has
+		if(property.type == Variant::NIL){
+			Variant::Type type = m_target->get(property.name).get_type();
+			if(!is_codec_supported_type(type)){
+				continue;
+			}
+			property.type = type;
+		}
+
+		//Values that are too big to ever fit in an update (next to the index and type) are left out
+		MessageWriter writer(encoded, MAX_INBOUND_PAYLOAD_SIZE - 2);
+		if(!encode_typed_value(writer, property.type, m_target->get(property.name))){
+			continue;
+		}
+
+		//Compare the wire encodings, a property only counts as changed if what would be sent changed
+		int encodedSize = writer.get_size();
+		if(encodedSize == static_cast<int>(property.encodedValue.size()) && memcmp(encoded, property.encodedValue.ptr(), encodedSize) == 0){
+			continue;
+		}
+
+		property.encodedValue.resize(encodedSize);
+		memcpy(property.encodedValue.ptr(), encoded, encodedSize);
+		property.pendingSends = PROPERTY_SYNC_REDUNDANCY;
+		m_dirtyBits |= 1ULL << i;
+		m_parentNetworkEntity->wake();
+	}
+}
+
+bool PropertySync::add_property(const StringName &property, int transmissionRate, bool ownerOnly) {
+	ERR_FAIL_COND_V_MSG(m_properties.size() >= MAX_SYNCED_PROPERTIES, false, vformat("A PropertySync can sync at most %d properties!", MAX_SYNCED_PROPERTIES));
+
+	SyncedProperty_t syncedProperty;
+	syncedProperty.name = property;
+	syncedProperty.type = Variant::NIL;
+	syncedProperty.tickInterval = transmissionRate > 0 ? 1000 / CLAMP(transmissionRate, 1, 80) : 0;
+	syncedProperty.ownerOnly = ownerOnly;
+	syncedProperty.pendingSends = 0;
+	syncedProperty.nextSendTick = 0U;
+
+	//Clients need the type up front to decode the property, the server picks it up on the first sample
+	if(m_target){
+		Variant::Type type = m_target->get(property).get_type();
+		ERR_FAIL_COND_V_MSG(!is_codec_supported_type(type), false, vformat("Property \"%s\" has a type that cannot be synced!", property));
+		syncedProperty.type = type;
+	}
+
+	std::lock_guard<std::mutex> lock(m_propertyMutex);
+	m_properties.push_back(syncedProperty);
+	return true;
+}
+
+//Reads the property index of the next entry and skips over its value
+static bool read_entry(MessageReader &reader, uint32_t &propertyIdx) {
+	uint8_t type = Variant::VARIANT_MAX;
+	if(!reader.read_varint(propertyIdx) || propertyIdx >= MAX_SYNCED_PROPERTIES || !reader.read(type)){
+		return false;
+	}
+	if(type >= Variant::VARIANT_MAX || !is_codec_supported_type(static_cast<Variant::Type>(type))){
+		return false;
+	}
+
+	Variant value;
+	return decode_typed_value(reader, static_cast<Variant::Type>(type), value);
+}
+
+//Combines two updates of the same entity module, the newer one winning for properties that are in both.
+//Properties of the older update that dont fit next to the newer ones are left for the next refresh.
+bool PropertySync::merge_updates(const unsigned char *older, int olderSize, const unsigned char *newer, int newerSize, unsigned char *merged, int &mergedSize) {
+	if(newerSize > MAX_INBOUND_PAYLOAD_SIZE){
+		return false;
+	}
+
+	//Find which properties the newer update already has
+	uint64_t newerProperties = 0U;
+	uint32_t propertyIdx;
+	MessageReader newerReader(newer, newerSize);
+	while(newerReader.get_remaining() > 0){
+		if(!read_entry(newerReader, propertyIdx)){
+			return false;
+		}
+		newerProperties |= 1ULL << propertyIdx;
+	}
+
+	memcpy(merged, newer, newerSize);
+	mergedSize = newerSize;
+
+	//Entries are self contained, so the ones only the older update has can just be copied after the newer ones
+	MessageReader olderReader(older, olderSize);
+	while(olderReader.get_remaining() > 0){
+		int entryStart = olderReader.get_position();
+		if(!read_entry(olderReader, propertyIdx)){
+			return false;
+		}
+
+		int entrySize = olderReader.get_position() - entryStart;
+		if(!(newerProperties & (1ULL << propertyIdx)) && mergedSize + entrySize <= MAX_INBOUND_PAYLOAD_SIZE){
+			memcpy(merged + mergedSize, older + entryStart, entrySize);
+			mergedSize += entrySize;
+		}
+	}
+
+	return true;
+}
+
+int PropertySync::get_property_count() const {
+	return m_properties.size();
+}
+
+Node *PropertySync::get_target() const {
+	return m_target;
+}
+
+PackedStringArray PropertySync::get_properties() const {
+	return m_propertyNames;
+}
+
+void PropertySync::set_target(Node *target) {
+	m_target = target;
+
+	//Pick up the types of properties that were declared before the target was set
+	if(m_target){
+		for(SyncedProperty_t &property : m_properties){
+			if(property.type == Variant::NIL){
+				Variant::Type type = m_target->get(property.name).get_type();
+				property.type = is_codec_supported_type(type) ? type : Variant::NIL;
+			}
+		}
+	}
+}
+
+//Replaces every declared property with the given ones
+void PropertySync::set_properties(const PackedStringArray &properties) {
+	m_propertyNames = properties;
+
+	{
+		std::lock_guard<std::mutex> lock(m_propertyMutex);
+		m_properties.clear();
+		m_dirtyBits = 0U;
+	}
+
+	for(const String &property : properties){
+		add_property(property);
+	}
+}
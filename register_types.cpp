@@ -2,6 +2,13 @@
 #include "core/object/class_db.h"
 #include "gdnet.h"
 
+#ifdef GDNET_FUZZ
+#include "core/os/os.h"
+
+//See fuzz/fuzz_server_messages.cpp
+int gdnet_run_fuzzer();
+#endif
+
  static GDNet *p_gdnetSingleton = nullptr;
 
 void initialize_gdnet_module(ModuleInitializationLevel p_level) {
@@ -14,6 +21,8 @@ void initialize_gdnet_module(ModuleInitializationLevel p_level) {
 	 ClassDB::register_class<EntityInfo>();
 	 ClassDB::register_class<Transform3DSync>();
 	 ClassDB::register_class<Transform2DSync>();
+	 ClassDB::register_class<PropertySync>();
+	 ClassDB::register_class<AnimationSync>();
 	 ClassDB::register_class<NetworkEntity>();
 	 ClassDB::register_class<Zone>();
 	 ClassDB::register_class<World>();
@@ -22,6 +31,13 @@ void initialize_gdnet_module(ModuleInitializationLevel p_level) {
 	 GDNet::singleton = p_gdnetSingleton;
 
 	 Engine::get_singleton()->add_singleton(Engine::Singleton("GDNet", GDNet::singleton, "GDNet"));
+
+#ifdef GDNET_FUZZ
+	 //Fuzz builds hand the whole process over to libFuzzer when asked to
+	 if (OS::get_singleton()->get_cmdline_user_args().find("--gdnet-fuzz")) {
+	 	exit(gdnet_run_fuzzer());
+	 }
+#endif
 }
 
 void uninitialize_gdnet_module(ModuleInitializationLevel p_level) {
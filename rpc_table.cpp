@@ -0,0 +1,57 @@
+#include "gdnet.h"
+
+bool RpcTable::register_method(const StringName &method, bool reliable) {
+	//Ids have to line up on both ends, so registering a method twice would throw every later id off. Registering it again
+	//the same way keeps the id it has, pooled entities run _ready again every time they get reused.
+	const uint32_t *id = m_methodIds.getptr(method);
+	if (id) {
+		return m_methods[*id].reliable == reliable;
+	}
+
+	m_methodIds.insert(method, m_methods.size());
+	m_methods.push_back({ method, reliable });
+	return true;
+}
+
+bool RpcTable::find_method(const StringName &method, uint32_t &methodId, bool &reliable) const {
+	const uint32_t *id = m_methodIds.getptr(method);
+	if (!id) {
+		return false;
+	}
+
+	methodId = *id;
+	reliable = m_methods[*id].reliable;
+	return true;
+}
+
+const StringName *RpcTable::get_method_name(uint32_t methodId) const {
+	if (methodId >= m_methods.size()) {
+		return nullptr;
+	}
+
+	return &m_methods[methodId].name;
+}
+
+int RpcTable::get_method_count() const {
+	return m_methods.size();
+}
+
+bool RpcTable::get_call_method(const Variant **args, int argCount, Callable::CallError &error, StringName &method) {
+	if (argCount < 1) {
+		error.error = Callable::CallError::CALL_ERROR_TOO_FEW_ARGUMENTS;
+		error.argument = 1;
+		return false;
+	}
+
+	Variant::Type type = args[0]->get_type();
+	if (type != Variant::STRING_NAME && type != Variant::STRING) {
+		error.error = Callable::CallError::CALL_ERROR_INVALID_ARGUMENT;
+		error.argument = 0;
+		error.expected = Variant::STRING_NAME;
+		return false;
+	}
+
+	method = *args[0];
+	error.error = Callable::CallError::CALL_OK;
+	return true;
+}
@@ -0,0 +1,209 @@
+#include "gdnet.h"
+
+//Message type + zone id
+const int StateFrameBuilder::HEADER_SIZE = 1 + sizeof(ZoneID_t);
+
+//Network id varint (max 5 bytes) + update type + authority epoch + payload size varint (max 5 bytes)
+static const int MAX_ENTRY_METADATA_SIZE = 5 + 1 + 1 + 5;
+
+StateFrameBuilder::StateFrameBuilder() {
+	m_destination = k_HSteamNetConnection_Invalid;
+	m_zoneId = 0U;
+	m_frameMssg = nullptr;
+	m_size = 0;
+	m_idleFlushes = 0;
+}
+
+StateFrameBuilder::~StateFrameBuilder() {
+	//Release a frame that was started but never sent
+	if(m_frameMssg){
+		m_frameMssg->Release();
+	}
+}
+
+StateFrameBuilder::StateFrameBuilder(StateFrameBuilder &&other) {
+	m_destination = other.m_destination;
+	m_zoneId = other.m_zoneId;
+	m_frameMssg = other.m_frameMssg;
+	m_size = other.m_size;
+	m_idleFlushes = other.m_idleFlushes;
+
+	//The frame belongs to this builder now
+	other.m_frameMssg = nullptr;
+	other.m_size = 0;
+}
+
+StateFrameBuilder &StateFrameBuilder::operator=(StateFrameBuilder &&other) {
+	if(this == &other){
+		return *this;
+	}
+
+	if(m_frameMssg){
+		m_frameMssg->Release();
+	}
+
+	m_destination = other.m_destination;
+	m_zoneId = other.m_zoneId;
+	m_frameMssg = other.m_frameMssg;
+	m_size = other.m_size;
+	m_idleFlushes = other.m_idleFlushes;
+
+	other.m_frameMssg = nullptr;
+	other.m_size = 0;
+	return *this;
+}
+
+void StateFrameBuilder::begin_frame(ZoneID_t zoneId) {
+	m_zoneId = zoneId;
+
+	//Frames are built directly inside the outgoing message buffer so they never have to be copied
+	if(!m_frameMssg){
+		m_frameMssg = SteamNetworkingUtils()->AllocateMessage(STATE_FRAME_MTU);
+		m_frameMssg->m_conn = m_destination;
+	}
+
+	//Write the frame header. The zone id is only written once per frame.
+	unsigned char *frameData = static_cast<unsigned char *>(m_frameMssg->m_pData);
+	frameData[0] = NETWORK_ENTITY_UPDATE;
+	serialize_basic(codec_byte_order(zoneId), 1, frameData);
+	m_size = HEADER_SIZE;
+}
+
+void StateFrameBuilder::queue_update(const EntityUpdateInfo_t &updateInfo) {
+	int payloadSize = updateInfo.payloadSize;
+	int entrySize = MAX_ENTRY_METADATA_SIZE + payloadSize;
+
+	//A frame can only hold updates from one zone, so send off whatever was built for the previous zone
+	if(!is_empty() && m_zoneId != updateInfo.parentZone){
+		flush();
+	}
+
+	//Send off the current frame if this update wont fit in it
+	if(!is_empty() && m_size + entrySize > STATE_FRAME_MTU){
+		flush();
+	}
+
+	//Updates too big for a frame of their own still get sent, they just get a dedicated (fragmented) message
+	if(HEADER_SIZE + entrySize > STATE_FRAME_MTU){
+		SteamNetworkingMessage_t *oversizedMssg = SteamNetworkingUtils()->AllocateMessage(HEADER_SIZE + entrySize);
+		oversizedMssg->m_conn = m_destination;
+		unsigned char *frameData = static_cast<unsigned char *>(oversizedMssg->m_pData);
+
+		frameData[0] = NETWORK_ENTITY_UPDATE;
+		serialize_basic(codec_byte_order(updateInfo.parentZone), 1, frameData);
+		int frameSize = HEADER_SIZE;
+		frameSize += serialize_varint(updateInfo.networkId, frameData + frameSize);
+		frameData[frameSize++] = updateInfo.updateType;
+		frameData[frameSize++] = updateInfo.authorityEpoch;
+		frameSize += serialize_varint(payloadSize, frameData + frameSize);
+		memcpy(frameData + frameSize, updateInfo.payload, payloadSize);
+		frameSize += payloadSize;
+
+		oversizedMssg->m_cbSize = frameSize;
+		send_message_unreliable(oversizedMssg);
+		return;
+	}
+
+	if(is_empty()){
+		begin_frame(updateInfo.parentZone);
+	}
+
+	//Append the update entry to the frame
+	unsigned char *frameData = static_cast<unsigned char *>(m_frameMssg->m_pData);
+	m_size += serialize_varint(updateInfo.networkId, frameData + m_size);
+	frameData[m_size++] = updateInfo.updateType;
+	frameData[m_size++] = updateInfo.authorityEpoch;
+	m_size += serialize_varint(payloadSize, frameData + m_size);
+	memcpy(frameData + m_size, updateInfo.payload, payloadSize);
+	m_size += payloadSize;
+}
+
+void StateFrameBuilder::flush() {
+	//Keep track of how long this builder has gone without anything to send so unused ones can be dropped
+	if(is_empty()){
+		m_idleFlushes++;
+		return;
+	}
+
+	m_idleFlushes = 0;
+
+	//Send the frame off to the destination. The library takes ownership of the message.
+	m_frameMssg->m_cbSize = m_size;
+	send_message_unreliable(m_frameMssg);
+
+	m_frameMssg = nullptr;
+	m_size = 0;
+}
+
+//Sends the frame to several destinations at once. Every destination gets the same bytes, so the frame is only built once.
+void StateFrameBuilder::flush_shared(const LocalVector<HSteamNetConnection> &destinations) {
+	if(is_empty()){
+		m_idleFlushes++;
+		return;
+	}
+
+	m_idleFlushes = 0;
+
+	//Nobody to send it to, keep the message around for the next frame
+	if(destinations.is_empty()){
+		m_size = 0;
+		return;
+	}
+
+	m_frameMssg->m_cbSize = m_size;
+	send_shared_message_unreliable(m_frameMssg, destinations.ptr(), destinations.size());
+
+	m_frameMssg = nullptr;
+	m_size = 0;
+}
+
+bool StateFrameBuilder::is_empty() const {
+	return m_size <= HEADER_SIZE;
+}
+
+int StateFrameBuilder::get_idle_flushes() const {
+	return m_idleFlushes;
+}
+
+void StateFrameBuilder::set_destination(HSteamNetConnection destination) {
+	m_destination = destination;
+}
+
+bool StateFrameBuilder::fits_in_frame(int payloadSize) {
+	return HEADER_SIZE + MAX_ENTRY_METADATA_SIZE + payloadSize <= STATE_FRAME_MTU;
+}
+
+bool StateFrameBuilder::read_update(const unsigned char *mssgData, const int mssgLen, int &dataIdx, EntityUpdateInfo_t &updateInfo) {
+	//Every frame starts with the zone id, so grab it from the header
+	if(mssgLen < HEADER_SIZE){
+		return false;
+	}
+	updateInfo.parentZone = codec_byte_order(deserialize_basic<ZoneID_t>(1, mssgData));
+
+	//Network id
+	uint32_t networkId;
+	if(!deserialize_varint(mssgData, mssgLen, dataIdx, networkId)){
+		return false;
+	}
+	updateInfo.networkId = networkId;
+
+	//Update type and the authority epoch it was sent under
+	if(dataIdx + 2 > mssgLen){
+		return false;
+	}
+	updateInfo.updateType = mssgData[dataIdx++];
+	updateInfo.authorityEpoch = mssgData[dataIdx++];
+
+	//Payload
+	uint32_t payloadSize;
+	if(!deserialize_varint(mssgData, mssgLen, dataIdx, payloadSize) || payloadSize > static_cast<uint32_t>(mssgLen - dataIdx)){
+		return false;
+	}
+
+	//Point the payload straight at the message data instead of copying it out
+	updateInfo.payload = mssgData + dataIdx;
+	updateInfo.payloadSize = payloadSize;
+	dataIdx += payloadSize;
+
+	return true;
+}
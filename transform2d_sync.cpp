@@ -1,4 +1,5 @@
 #include "gdnet.h"
+#include "core/os/os.h"
 
 Transform2DSync::Transform2DSync() {
 	m_interpolate = false;
@@ -6,6 +7,14 @@ Transform2DSync::Transform2DSync() {
 	m_interpolationTime = 0.1f;
 	m_elapsedTime = 0.0f;
 	m_authority = SyncAuthority::NONE;
+	m_deadReckoning = false;
+	m_deadReckoningThreshold = DEFAULT_DEAD_RECKONING_THRESHOLD;
+	m_deadReckoningMaxSilence = DEFAULT_DEAD_RECKONING_MAX_SILENCE;
+	m_hasVelocity = false;
+	m_angularVelocity = 0.0f;
+	m_lastSampleUsec = 0;
+	m_lastSentAngularVelocity = 0.0f;
+	m_lastSentUsec = 0;
 }
 
 void Transform2DSync::_bind_methods() {
@@ -19,6 +28,13 @@ void Transform2DSync::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_position", "position"), &Transform2DSync::set_position);
 	ClassDB::bind_method(D_METHOD("set_authority", "authority"), &Transform2DSync::set_authority);
 
+	ClassDB::bind_method(D_METHOD("get_dead_reckoning"), &Transform2DSync::get_dead_reckoning);
+	ClassDB::bind_method(D_METHOD("get_dead_reckoning_threshold"), &Transform2DSync::get_dead_reckoning_threshold);
+	ClassDB::bind_method(D_METHOD("get_dead_reckoning_max_silence"), &Transform2DSync::get_dead_reckoning_max_silence);
+	ClassDB::bind_method(D_METHOD("set_dead_reckoning", "dead_reckoning"), &Transform2DSync::set_dead_reckoning);
+	ClassDB::bind_method(D_METHOD("set_dead_reckoning_threshold", "threshold"), &Transform2DSync::set_dead_reckoning_threshold);
+	ClassDB::bind_method(D_METHOD("set_dead_reckoning_max_silence", "max_silence"), &Transform2DSync::set_dead_reckoning_max_silence);
+
 	ClassDB::bind_method(D_METHOD("update_transform_data"), &Transform2DSync::update_transform_data);
 	ClassDB::bind_method(D_METHOD("copy_transform"), &Transform2DSync::copy_transform);
 
@@ -30,19 +46,80 @@ void Transform2DSync::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "target", PROPERTY_HINT_RESOURCE_TYPE, "Node2D"), "set_target", "get_target");
 	ADD_PROPERTY(PropertyInfo(Variant::VECTOR2, "position", PROPERTY_HINT_RANGE, "-99999,99999,0.001,or_greater,or_less,hide_slider,suffix:m", PROPERTY_USAGE_EDITOR), "set_position", "get_position");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "authority", PROPERTY_HINT_ENUM, "NONE, OWNER_AUTHORITATIVE", PROPERTY_USAGE_DEFAULT), "set_authority", "get_authority");
+
+	ADD_GROUP("Dead Reckoning", "dead_reckoning");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "dead_reckoning"), "set_dead_reckoning", "get_dead_reckoning");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "dead_reckoning_threshold", PROPERTY_HINT_RANGE, "0,100,0.001,or_greater,suffix:m"), "set_dead_reckoning_threshold", "get_dead_reckoning_threshold");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "dead_reckoning_max_silence", PROPERTY_HINT_RANGE, "0,10,0.01,or_greater,suffix:s"), "set_dead_reckoning_max_silence", "get_dead_reckoning_max_silence");
+}
+
+//Samples the velocities and checks whether the recievers can still predict where the target is from the last update
+bool Transform2DSync::prediction_still_valid() {
+	uint64_t now = OS::get_singleton()->get_ticks_usec();
+
+	//Estimate the velocities from the previous sample
+	if(m_lastSampleUsec != 0 && now > m_lastSampleUsec){
+		real_t sampleTime = (now - m_lastSampleUsec) / 1000000.0f;
+		m_linearVelocity = (global_transform.get_origin() - m_lastSample.get_origin()) / sampleTime;
+		m_angularVelocity = Math::angle_difference(m_lastSample.get_rotation(), global_transform.get_rotation()) / sampleTime;
+	}
+	m_lastSample = global_transform;
+	m_lastSampleUsec = now;
+
+	if(m_lastSentUsec != 0){
+		real_t silentTime = (now - m_lastSentUsec) / 1000000.0f;
+
+		//Send every so often anyway so recievers that lost an update (or just loaded the entity) get corrected
+		if(silentTime < m_deadReckoningMaxSilence){
+			Vector2 predictedPosition = m_lastSent.get_origin() + m_lastSentLinearVelocity * silentTime;
+			real_t predictedRotation = m_lastSent.get_rotation() + m_lastSentAngularVelocity * silentTime;
+
+			if(predictedPosition.distance_to(global_transform.get_origin()) <= m_deadReckoningThreshold &&
+					Math::abs(Math::angle_difference(predictedRotation, global_transform.get_rotation())) <= DEAD_RECKONING_ROTATION_THRESHOLD){
+				return true;
+			}
+		}
+	}
+
+	//This update goes out, so it is what recievers predict from next
+	m_lastSent = global_transform;
+	m_lastSentLinearVelocity = m_linearVelocity;
+	m_lastSentAngularVelocity = m_angularVelocity;
+	m_lastSentUsec = now;
+	return false;
 }
 
 void Transform2DSync::serialize_payload(EntityUpdateInfo_t &updateInfo) {
-	//Resize the data buffer to accomodate the transform information
-	updateInfo.dataBuffer.resize(METADATA_SIZE + sizeof(Transform2D));
+	if(!m_deadReckoning){
+		//Allocate a payload large enough to accomodate the transform information
+		unsigned char *payload = allocate_payload(updateInfo, sizeof(Transform2D));
 
-	//Serialize the target transform into the message data
-	serialize_basic(global_transform, METADATA_SIZE, updateInfo.dataBuffer);
+		//Serialize the target transform into the payload
+		serialize_basic(global_transform, 0, payload);
+		return;
+	}
+
+	//Dead reckoning payloads carry the velocities after the transform
+	unsigned char *payload = allocate_payload(updateInfo, sizeof(Transform2D) + sizeof(Vector2) + sizeof(real_t));
+	serialize_basic(global_transform, 0, payload);
+	serialize_basic(m_linearVelocity, sizeof(Transform2D), payload);
+	serialize_basic(m_angularVelocity, sizeof(Transform2D) + sizeof(Vector2), payload);
 }
 
-void Transform2DSync::deserialize_payload(const EntityUpdateInfo_t &updateInfo) {
-	//Get the target transform from the payload
-	global_transform = deserialize_basic<Transform2D>(METADATA_SIZE, updateInfo.dataBuffer.ptr());
+bool Transform2DSync::deserialize_payload(const EntityUpdateInfo_t &updateInfo) {
+	//Get the target transform from the payload (as long as the payload actually holds one)
+	if(!deserialize_basic(0, updateInfo.payload, updateInfo.payloadSize, global_transform)){
+		return false;
+	}
+
+	//Velocities are only there if the sender uses dead reckoning
+	m_hasVelocity = updateInfo.payloadSize >= static_cast<int>(sizeof(Transform2D) + sizeof(Vector2) + sizeof(real_t));
+	if(m_hasVelocity){
+		m_linearVelocity = deserialize_basic<Vector2>(sizeof(Transform2D), updateInfo.payload);
+		m_angularVelocity = deserialize_basic<real_t>(sizeof(Transform2D) + sizeof(Vector2), updateInfo.payload);
+	}
+
+	return true;
 }
 
 void Transform2DSync::tick() {
@@ -50,9 +127,7 @@ void Transform2DSync::tick() {
 
 	if(m_tickCount == 0){
 		if(GDNet::singleton->m_isServer){
-			for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : m_parentNetworkEntity->m_parentZone->m_playersInZone){
-				transmit_data(player.value->get_player_conn());
-			}
+			SERVER_SIDE_broadcast_data();
 		}else if(GDNet::singleton->m_isClient && has_authority()){
 			transmit_data(GDNet::singleton->world->m_worldConnection);
 		}
@@ -61,49 +136,82 @@ void Transform2DSync::tick() {
 	m_tickCount++;
 }
 
-void Transform2DSync::transmit_data(HSteamNetConnection destination) {
+bool Transform2DSync::build_update(EntityUpdateInfo_t &updateInfo) {
 	if(!m_target){
-		return;
+		return false;
 	}
 
-	//Create and populate the update info
-	EntityUpdateInfo_t updateInfo;
+	//Nothing to send while the recievers can still work out where the target is on their own
+	if(m_deadReckoning && prediction_still_valid()){
+		return false;
+	}
 
+	//Populate the update info
 	updateInfo.parentZone = m_parentNetworkEntity->m_info->m_entityInfo.parentZone;
 	updateInfo.networkId = m_parentNetworkEntity->m_info->m_entityInfo.networkId;
+	updateInfo.authorityEpoch = m_parentNetworkEntity->m_info->m_entityInfo.authorityEpoch;
 	updateInfo.updateType = TRANSFORM2D_SYNC_UPDATE;
 
-	//Serialize the update info with pertinent information
-	//Metadata
-	NetworkModule::serialize_update_metadata(updateInfo);
-	//Transform info
+	//Serialize the transform info
 	serialize_payload(updateInfo);
-
-	//Create and send the message to the destination.
-	const unsigned char* mssgData = updateInfo.dataBuffer.ptr();
-	int dataLen = updateInfo.dataBuffer.size();
-
-	SteamNetworkingMessage_t *updateMssg = allocate_message(mssgData, dataLen, destination);
-	send_message_unreliable(updateMssg);
+	return true;
 }
 
-void Transform2DSync::recieve_data(EntityUpdateInfo_t updateInfo) {
+bool Transform2DSync::recieve_data(EntityUpdateInfo_t updateInfo) {
 	//Obtain and store the transform information within the class
-	deserialize_payload(updateInfo);
+	if(!deserialize_payload(updateInfo)){
+		return false;
+	}
 
+	//Updates are applied on the main thread, so the target can be touched directly
 	if(GDNet::singleton->m_isServer){
 		//Reset initial position
 		m_parentNetworkEntity->m_info->set_initial_position_2D(global_transform.get_origin());
 		//Set the transform
-		m_target->call_deferred("set_transform", global_transform);
+		m_target->set_transform(global_transform);
+		//The owner is moving it, so the server has to keep relaying it
+		m_parentNetworkEntity->wake();
 	}else if(GDNet::singleton->m_isClient){
-		call_deferred("update_transform_data");
+		update_transform_data();
+	}
+
+	return true;
+}
+
+//Must be called from main thread only
+void Transform2DSync::reset() {
+	NetworkModule::reset();
+
+	//Put the target back where the scene had it so a reused entity doesnt start out where the last one ended
+	global_transform = m_spawnTransform;
+	m_currentPosition = m_spawnTransform.get_origin();
+	m_targetPosition = m_spawnTransform.get_origin();
+	m_elapsedTime = 0.0f;
+	m_hasVelocity = false;
+	m_linearVelocity = Vector2();
+	m_angularVelocity = 0.0f;
+	m_lastSampleUsec = 0;
+	m_lastSentUsec = 0;
+
+	if(m_target){
+		m_target->set_transform(m_spawnTransform);
 	}
 }
 
 //Must be called from main thread only
 void Transform2DSync::interpolate_origin(float delta) {
-	if(m_interpolate){
+	if(m_hasVelocity){
+		//Extrapolate along the velocities from the last update, blending over from where the target was when it came in
+		m_elapsedTime += delta;
+		Vector2 extrapolatedPosition = m_targetPosition + m_linearVelocity * m_elapsedTime;
+		if(m_interpolate){
+			float t = MIN(m_elapsedTime / m_interpolationTime, 1.0f);
+			extrapolatedPosition = (m_currentPosition + m_linearVelocity * m_elapsedTime).lerp(extrapolatedPosition, t);
+		}
+		m_target->set_position(extrapolatedPosition);
+		m_target->set_rotation(global_transform.get_rotation() + m_angularVelocity * m_elapsedTime);
+	}
+	else if(m_interpolate){
 		m_elapsedTime += delta;
 		float t = m_elapsedTime / m_interpolationTime;
 		Vector2 interpolatedPosition = m_currentPosition.lerp(m_targetPosition, t);
@@ -153,8 +261,12 @@ void Transform2DSync::copy_transform() {
 		return;
 	}
 
-	//Set the networked global transform
-	global_transform = m_target->get_transform();
+	//Set the networked global transform, waking the entity up if it moved
+	Transform2D transform = m_target->get_transform();
+	if(transform != global_transform){
+		global_transform = transform;
+		m_parentNetworkEntity->wake();
+	}
 }
 
 bool Transform2DSync::get_interpolate() const {
@@ -182,6 +294,7 @@ void Transform2DSync::set_target(Node2D* target) {
 	m_target = target;
 	//Get the objects transform
 	global_transform = m_target->get_transform();
+	m_spawnTransform = global_transform;
 }
 
 //This method should only ever be called from the main thread
@@ -200,11 +313,36 @@ void Transform2DSync::set_position(const Vector2 &position) {
 
 	//Apply the transform
 	m_target->set_transform(global_transform);
+	m_parentNetworkEntity->wake();
 }
 
 void Transform2DSync::set_authority(SyncAuthority authority) {
 	m_authority = authority;
 }
 
+bool Transform2DSync::get_dead_reckoning() const {
+	return m_deadReckoning;
+}
+
+float Transform2DSync::get_dead_reckoning_threshold() const {
+	return m_deadReckoningThreshold;
+}
+
+float Transform2DSync::get_dead_reckoning_max_silence() const {
+	return m_deadReckoningMaxSilence;
+}
+
+void Transform2DSync::set_dead_reckoning(bool deadReckoning) {
+	m_deadReckoning = deadReckoning;
+}
+
+void Transform2DSync::set_dead_reckoning_threshold(float threshold) {
+	m_deadReckoningThreshold = MAX(threshold, 0.0f);
+}
+
+void Transform2DSync::set_dead_reckoning_max_silence(float maxSilence) {
+	m_deadReckoningMaxSilence = MAX(maxSilence, 0.0f);
+}
+
 
 
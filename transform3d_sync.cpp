@@ -1,10 +1,26 @@
 #include "gdnet.h"
+#include "core/os/os.h"
+
+//Rotation of the given angular velocity (axis scaled by radians per second) over the given time
+static Basis rotation_over_time(const Vector3 &angularVelocity, real_t time) {
+	real_t angle = angularVelocity.length() * time;
+	if(Math::is_zero_approx(angle)){
+		return Basis();
+	}
+	return Basis(angularVelocity.normalized(), angle);
+}
 
 Transform3DSync::Transform3DSync() {
 	m_target = nullptr;
 	m_interpolationTime = 0.1f;
 	m_elapsedTime = 0.0f;
 	m_authority = SyncAuthority::NONE;
+	m_deadReckoning = false;
+	m_deadReckoningThreshold = DEFAULT_DEAD_RECKONING_THRESHOLD;
+	m_deadReckoningMaxSilence = DEFAULT_DEAD_RECKONING_MAX_SILENCE;
+	m_hasVelocity = false;
+	m_lastSampleUsec = 0;
+	m_lastSentUsec = 0;
 }
 
 void Transform3DSync::_bind_methods() {
@@ -14,6 +30,12 @@ void Transform3DSync::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_target"), &Transform3DSync::get_target);
 	ClassDB::bind_method(D_METHOD("get_position"), &Transform3DSync::get_position);
 	ClassDB::bind_method(D_METHOD("get_authority"), &Transform3DSync::get_authority);
+	ClassDB::bind_method(D_METHOD("get_dead_reckoning"), &Transform3DSync::get_dead_reckoning);
+	ClassDB::bind_method(D_METHOD("get_dead_reckoning_threshold"), &Transform3DSync::get_dead_reckoning_threshold);
+	ClassDB::bind_method(D_METHOD("get_dead_reckoning_max_silence"), &Transform3DSync::get_dead_reckoning_max_silence);
+	ClassDB::bind_method(D_METHOD("set_dead_reckoning", "dead_reckoning"), &Transform3DSync::set_dead_reckoning);
+	ClassDB::bind_method(D_METHOD("set_dead_reckoning_threshold", "threshold"), &Transform3DSync::set_dead_reckoning_threshold);
+	ClassDB::bind_method(D_METHOD("set_dead_reckoning_max_silence", "max_silence"), &Transform3DSync::set_dead_reckoning_max_silence);
 	ClassDB::bind_method(D_METHOD("update_transform_data"), &Transform3DSync::update_transform_data);
 
 	BIND_ENUM_CONSTANT(NONE);
@@ -22,65 +44,178 @@ void Transform3DSync::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "target", PROPERTY_HINT_RESOURCE_TYPE, "Node3D"), "set_target", "get_target");
 	ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "position", PROPERTY_HINT_RANGE, "-99999,99999,0.001,or_greater,or_less,hide_slider,suffix:m", PROPERTY_USAGE_EDITOR), "set_position", "get_position");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "authority", PROPERTY_HINT_ENUM, "NONE, OWNER_AUTHORITATIVE", PROPERTY_USAGE_DEFAULT), "set_authority", "get_authority");
+
+	ADD_GROUP("Dead Reckoning", "dead_reckoning");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "dead_reckoning"), "set_dead_reckoning", "get_dead_reckoning");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "dead_reckoning_threshold", PROPERTY_HINT_RANGE, "0,100,0.001,or_greater,suffix:m"), "set_dead_reckoning_threshold", "get_dead_reckoning_threshold");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "dead_reckoning_max_silence", PROPERTY_HINT_RANGE, "0,10,0.01,or_greater,suffix:s"), "set_dead_reckoning_max_silence", "get_dead_reckoning_max_silence");
+}
+
+//Samples the velocities and checks whether the recievers can still predict where the target is from the last update
+bool Transform3DSync::prediction_still_valid() {
+	uint64_t now = OS::get_singleton()->get_ticks_usec();
+
+	//Estimate the velocities from the previous sample
+	if(m_lastSampleUsec != 0 && now > m_lastSampleUsec){
+		real_t sampleTime = (now - m_lastSampleUsec) / 1000000.0f;
+		m_linearVelocity = (global_transform.get_origin() - m_lastSample.get_origin()) / sampleTime;
+
+		//Angular velocity is the axis of the rotation since the last sample scaled by how fast it turned
+		Quaternion rotationDelta = (global_transform.get_basis().get_rotation_quaternion() * m_lastSample.get_basis().get_rotation_quaternion().inverse()).normalized();
+		real_t angle = rotationDelta.get_angle();
+		m_angularVelocity = Math::is_zero_approx(angle) ? Vector3() : rotationDelta.get_axis() * (angle / sampleTime);
+	}
+	m_lastSample = global_transform;
+	m_lastSampleUsec = now;
+
+	if(m_lastSentUsec != 0){
+		real_t silentTime = (now - m_lastSentUsec) / 1000000.0f;
+
+		//Send every so often anyway so recievers that lost an update (or just loaded the entity) get corrected
+		if(silentTime < m_deadReckoningMaxSilence){
+			Vector3 predictedPosition = m_lastSent.get_origin() + m_lastSentLinearVelocity * silentTime;
+			Quaternion predictedRotation = (rotation_over_time(m_lastSentAngularVelocity, silentTime) * m_lastSent.get_basis()).get_rotation_quaternion();
+
+			if(predictedPosition.distance_to(global_transform.get_origin()) <= m_deadReckoningThreshold &&
+					predictedRotation.angle_to(global_transform.get_basis().get_rotation_quaternion()) <= DEAD_RECKONING_ROTATION_THRESHOLD){
+				return true;
+			}
+		}
+	}
+
+	//This update goes out, so it is what recievers predict from next
+	m_lastSent = global_transform;
+	m_lastSentLinearVelocity = m_linearVelocity;
+	m_lastSentAngularVelocity = m_angularVelocity;
+	m_lastSentUsec = now;
+	return false;
 }
 
 void Transform3DSync::serialize_payload(EntityUpdateInfo_t &updateInfo) {
-	//Resize the data buffer to accomodate the transform information
-	updateInfo.dataBuffer.resize(METADATA_SIZE + (12 * sizeof(real_t )));
+	if(!m_deadReckoning){
+		//Allocate a payload large enough to accomodate the transform information
+		unsigned char *payload = allocate_payload(updateInfo, 12 * sizeof(real_t));
+
+		//Serialize the target transform into the payload
+		serialize_transform3d(global_transform, 0, payload);
+		return;
+	}
 
-	//Serialize the target transform into the message data
-	serialize_transform3d(global_transform, METADATA_SIZE, updateInfo.dataBuffer);
+	//Dead reckoning payloads carry the velocities after the transform
+	unsigned char *payload = allocate_payload(updateInfo, 12 * sizeof(real_t) + 2 * sizeof(Vector3));
+	serialize_transform3d(global_transform, 0, payload);
+	serialize_basic(m_linearVelocity, 12 * sizeof(real_t), payload);
+	serialize_basic(m_angularVelocity, 12 * sizeof(real_t) + sizeof(Vector3), payload);
 }
 
-void Transform3DSync::deserialize_payload(const EntityUpdateInfo_t &updateInfo) {
+bool Transform3DSync::deserialize_payload(const EntityUpdateInfo_t &updateInfo) {
+	//Make sure the payload actually holds a transform
+	if(updateInfo.payloadSize < static_cast<int>(12 * sizeof(real_t))){
+		return false;
+	}
+
 	//Get the target transform from the payload
-	global_transform = deserialize_transform3d(METADATA_SIZE, updateInfo.dataBuffer.ptr());
+	global_transform = deserialize_transform3d(0, updateInfo.payload);
+
+	//Velocities are only there if the sender uses dead reckoning
+	m_hasVelocity = updateInfo.payloadSize >= static_cast<int>(12 * sizeof(real_t) + 2 * sizeof(Vector3));
+	if(m_hasVelocity){
+		m_linearVelocity = deserialize_basic<Vector3>(12 * sizeof(real_t), updateInfo.payload);
+		m_angularVelocity = deserialize_basic<Vector3>(12 * sizeof(real_t) + sizeof(Vector3), updateInfo.payload);
+	}
+
+	return true;
 }
 
+void Transform3DSync::tick() {
+	m_tickCount %= m_maxTickCount;
+
+	if(m_tickCount == 0){
+		if(GDNet::singleton->m_isServer){
+			SERVER_SIDE_broadcast_data();
+		}else if(GDNet::singleton->m_isClient && has_authority()){
+			transmit_data(GDNet::singleton->world->m_worldConnection);
+		}
+	}
+
+	m_tickCount++;
+}
 
-void Transform3DSync::transmit_data(HSteamNetConnection destination) {
+bool Transform3DSync::build_update(EntityUpdateInfo_t &updateInfo) {
 	if(!m_target){
-		return;
+		return false;
 	}
 
-	//Create and populate the update info
-	EntityUpdateInfo_t updateInfo;
+	//Nothing to send while the recievers can still work out where the target is on their own
+	if(m_deadReckoning && prediction_still_valid()){
+		return false;
+	}
 
+	//Populate the update info
 	updateInfo.parentZone = m_parentNetworkEntity->m_info->m_entityInfo.parentZone;
 	updateInfo.networkId = m_parentNetworkEntity->m_info->m_entityInfo.networkId;
+	updateInfo.authorityEpoch = m_parentNetworkEntity->m_info->m_entityInfo.authorityEpoch;
 	updateInfo.updateType = TRANSFORM3D_SYNC_UPDATE;
 
-	//Serialize the update info with pertinent information
-	//Metadata
-	NetworkModule::serialize_update_metadata(updateInfo);
-	//Transform info
+	//Serialize the transform info
 	serialize_payload(updateInfo);
-
-	//Create and send the message to the destination.
-	const unsigned char* mssgData = updateInfo.dataBuffer.ptr();
-	int dataLen = updateInfo.dataBuffer.size();
-
-	SteamNetworkingMessage_t *updateMssg = allocate_message(mssgData, dataLen, destination);
-	send_message_unreliable(updateMssg);
+	return true;
 }
 
-void Transform3DSync::recieve_data(EntityUpdateInfo_t updateInfo) {
+bool Transform3DSync::recieve_data(EntityUpdateInfo_t updateInfo) {
 	//Obtain and store the transform information within the class
-	deserialize_payload(updateInfo);
+	if(!deserialize_payload(updateInfo)){
+		return false;
+	}
 
+	//Updates are applied on the main thread, so the target can be touched directly
 	if(GDNet::singleton->m_isServer){
 		//Reset initial position
 		m_parentNetworkEntity->m_info->set_initial_position_3D(global_transform.get_origin());
 		//Set the transform
-		m_target->call_deferred("set_transform", global_transform);
+		m_target->set_transform(global_transform);
+		//The owner is moving it, so the server has to keep relaying it
+		m_parentNetworkEntity->wake();
 	}else if(GDNet::singleton->m_isClient){
-		call_deferred("update_transform_data");
+		update_transform_data();
+	}
+
+	return true;
+}
+
+//Must be called from main thread only
+void Transform3DSync::reset() {
+	NetworkModule::reset();
+
+	//Put the target back where the scene had it so a reused entity doesnt start out where the last one ended
+	global_transform = m_spawnTransform;
+	m_currentPosition = m_spawnTransform.get_origin();
+	m_targetPosition = m_spawnTransform.get_origin();
+	m_elapsedTime = 0.0f;
+	m_hasVelocity = false;
+	m_linearVelocity = Vector3();
+	m_angularVelocity = Vector3();
+	m_lastSampleUsec = 0;
+	m_lastSentUsec = 0;
+
+	if(m_target){
+		m_target->set_transform(m_spawnTransform);
 	}
 }
 
 //Must be called from main thread only
 void Transform3DSync::interpolate_origin(float delta) {
 	m_elapsedTime += delta;
+
+	if(m_hasVelocity){
+		//Extrapolate along the velocities from the last update, blending over from where the target was when it came in
+		float t = MIN(m_elapsedTime / m_interpolationTime, 1.0f);
+		Vector3 travelled = m_linearVelocity * m_elapsedTime;
+		Vector3 extrapolatedPosition = (m_currentPosition + travelled).lerp(m_targetPosition + travelled, t);
+		m_target->set_transform(Transform3D(rotation_over_time(m_angularVelocity, m_elapsedTime) * global_transform.get_basis(), extrapolatedPosition));
+		return;
+	}
+
 	float t = m_elapsedTime / m_interpolationTime;
 	Vector3 interpolatedPosition = m_currentPosition.lerp(m_targetPosition, t);
 	m_target->set_position(interpolatedPosition);
@@ -128,6 +263,7 @@ void Transform3DSync::set_target(Node3D* target) {
 	m_target = target;
 	//Get the objects transform
 	global_transform = m_target->get_transform();
+	m_spawnTransform = global_transform;
 }
 
 //This method should only ever be called from the main thread
@@ -146,10 +282,35 @@ void Transform3DSync::set_position(const Vector3 &position) {
 
 	//Apply the transform
 	m_target->set_transform(global_transform);
+	m_parentNetworkEntity->wake();
 }
 
 void Transform3DSync::set_authority(SyncAuthority authority) {
 	m_authority = authority;
 }
 
+bool Transform3DSync::get_dead_reckoning() const {
+	return m_deadReckoning;
+}
+
+float Transform3DSync::get_dead_reckoning_threshold() const {
+	return m_deadReckoningThreshold;
+}
+
+float Transform3DSync::get_dead_reckoning_max_silence() const {
+	return m_deadReckoningMaxSilence;
+}
+
+void Transform3DSync::set_dead_reckoning(bool deadReckoning) {
+	m_deadReckoning = deadReckoning;
+}
+
+void Transform3DSync::set_dead_reckoning_threshold(float threshold) {
+	m_deadReckoningThreshold = MAX(threshold, 0.0f);
+}
+
+void Transform3DSync::set_dead_reckoning_max_silence(float maxSilence) {
+	m_deadReckoningMaxSilence = MAX(maxSilence, 0.0f);
+}
+
 
@@ -0,0 +1,71 @@
+#include "gdnet.h"
+
+UpdateMailbox::UpdateMailbox(EntityNetworkID_t networkId, unsigned char updateType) {
+	m_writeSlot = 0;
+	m_sharedSlot.store(1);
+	m_readSlot = 2;
+	m_queued.store(false);
+
+	m_networkId = networkId;
+	m_updateType = updateType;
+}
+
+bool UpdateMailbox::post(const EntityUpdateInfo_t &updateInfo, uint64_t sequence) {
+	//Fill the slot only the network thread can see
+	Slot &slot = m_slots[m_writeSlot];
+	slot.parentZone = updateInfo.parentZone;
+	slot.sequence = sequence;
+	slot.authorityEpoch = updateInfo.authorityEpoch;
+	slot.payloadSize = static_cast<uint8_t>(updateInfo.payloadSize);
+	memcpy(slot.payload, updateInfo.payload, updateInfo.payloadSize);
+
+	//Publish it by swapping it with the shared slot. If the main thread never took the previous update, it just gets overwritten next time.
+	uint8_t previousSlot = m_sharedSlot.exchange(m_writeSlot | SLOT_FRESH);
+	m_writeSlot = previousSlot & ~SLOT_FRESH;
+
+	//Property updates only carry what changed, so properties only the overwritten update had would be lost until the next
+	//refresh. The overwritten update is back in the network thread's hands, so merge it with the new one and publish that.
+	bool propertyUpdate = m_updateType == PROPERTY_SYNC_UPDATE || m_updateType == PROPERTY_SYNC_OWNER_UPDATE;
+	Slot &previous = m_slots[m_writeSlot];
+	if(propertyUpdate && (previousSlot & SLOT_FRESH) && previous.parentZone == updateInfo.parentZone && previous.authorityEpoch == updateInfo.authorityEpoch){
+		unsigned char merged[MAX_INBOUND_PAYLOAD_SIZE];
+		int mergedSize;
+		if(PropertySync::merge_updates(previous.payload, previous.payloadSize, updateInfo.payload, updateInfo.payloadSize, merged, mergedSize)){
+			//Keeps the older sequence, if the older update was meant for an earlier entity with this network id the whole thing gets dropped
+			previous.payloadSize = static_cast<uint8_t>(mergedSize);
+			memcpy(previous.payload, merged, mergedSize);
+
+			//The main thread may have taken the unmerged update in the meantime, which is fine, it gets the merged one after
+			m_writeSlot = m_sharedSlot.exchange(m_writeSlot | SLOT_FRESH) & ~SLOT_FRESH;
+		}
+	}
+
+	return !m_queued.exchange(true);
+}
+
+void UpdateMailbox::cancel_queued() {
+	m_queued.store(false);
+}
+
+bool UpdateMailbox::take(EntityUpdateInfo_t &updateInfo, uint64_t &sequence) {
+	//Clear the queued flag before looking at the slot, so an update posted from here on queues the mailbox again
+	m_queued.store(false);
+
+	if(!(m_sharedSlot.load() & SLOT_FRESH)){
+		return false;
+	}
+
+	m_readSlot = m_sharedSlot.exchange(m_readSlot) & ~SLOT_FRESH;
+
+	//The payload stays valid until the next take, the network thread never writes into the read slot
+	const Slot &slot = m_slots[m_readSlot];
+	updateInfo.parentZone = slot.parentZone;
+	updateInfo.networkId = m_networkId;
+	updateInfo.updateType = m_updateType;
+	updateInfo.authorityEpoch = slot.authorityEpoch;
+	updateInfo.payload = slot.payload;
+	updateInfo.payloadSize = slot.payloadSize;
+	sequence = slot.sequence;
+
+	return true;
+}
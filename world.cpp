@@ -1,5 +1,6 @@
 #include "core/core_string_names.h"
 #include "core/error/error_macros.h"
+#include "core/object/callable_method_pointer.h"
 #include "core/os/memory.h"
 #include "core/string/print_string.h"
 #include "gdnet.h"
@@ -15,9 +16,25 @@ World::World() {
 	m_worldConnection = k_HSteamNetConnection_Invalid;
 	m_serverRunLoop = false;
 	m_clientRunLoop = false;
+	m_neighborZoneUpdateInterval = DEFAULT_NEIGHBOR_ZONE_UPDATE_INTERVAL;
+	m_receiveBatchSize.store(DEFAULT_RECEIVE_BATCH_SIZE);
+	m_serverTick = 0;
+	m_inboundSequence = 0;
+	m_snapshotPending = false;
+	m_snapshotWriting = false;
+	m_rpcSender = 0;
+
+	for (int i = 0; i < REJECTION_COUNT; i++) {
+		m_rejectedMessages[i].store(0);
+	}
 }
 
-World::~World() {}
+World::~World() {
+	//A thread that is still joinable when it gets destroyed takes the whole process down with it
+	if(m_snapshotWriterThread.joinable()){
+		m_snapshotWriterThread.join();
+	}
+}
 
 void World::cleanup(){
 	//Cleanup the client if there exists a client connetion
@@ -70,6 +87,9 @@ void World::player_connected(HSteamNetConnection playerConnection) {
 	//Generate a network identifier for the player
 	PlayerID_t playerId = IDGenerator::generatePlayerID();
 
+	//Split the connection into prioritized lanes before anything is sent over it
+	configure_connection_lanes(playerConnection);
+
 	//Populate player info
 	playerInfo->set_player_conn(playerConnection);
 	playerInfo->set_player_id(playerId);
@@ -97,12 +117,10 @@ void World::remove_player(HSteamNetConnection hConn) {
 		Ref<PlayerInfo> playerInfo = m_worldPlayerInfoByConnection.get(hConn);
 		PlayerID_t  playerID = playerInfo->get_player_id();
 
-		//Try to get te zone the player is currently loaded into:
-		Zone *currentZone = playerInfo->get_current_loaded_zone();
-
-		//If the player is indeed in a zone, remove them from said zone
-		if(currentZone){
-			ZoneID_t zoneID = currentZone->get_zone_id();
+		//Remove the player from every zone they are loaded into
+		for(const KeyValue<ZoneID_t, ZoneSubscription_t> &loadedZone : playerInfo->m_playerInfo.loadedZones){
+			Zone *currentZone = loadedZone.value.zone;
+			ZoneID_t zoneID = loadedZone.key;
 			currentZone->call_deferred("_remove_player", playerInfo);
 
 
@@ -116,7 +134,7 @@ void World::remove_player(HSteamNetConnection hConn) {
 				HSteamNetConnection playerEndpoint = playerInZone.value->get_player_conn();
 
 				SteamNetworkingMessage_t* playerLeftMssg = create_small_message(PLAYER_LEFT_ZONE, playerID, zoneID, playerEndpoint);
-				send_message_reliable(playerLeftMssg);
+				send_message_reliable(playerLeftMssg, LANE_GAMEPLAY);
 			}
 		}
 
@@ -124,6 +142,12 @@ void World::remove_player(HSteamNetConnection hConn) {
 		m_worldPlayerInfoByConnection.erase(hConn);
 	}
 
+	//Drop any rpc calls still batched up for the player
+	{
+		std::lock_guard<std::mutex> lock(m_rpcMutex);
+		m_rpcBatches.erase(hConn);
+	}
+
 	//Close connection with the player
 	if (!SteamNetworkingSockets()->CloseConnection(hConn, 0, nullptr, false)) {
 		ERR_PRINT("Cannot close connection, it was already closed.");
@@ -133,14 +157,25 @@ void World::remove_player(HSteamNetConnection hConn) {
 }
 
 
-void World::SERVER_SIDE_load_zone_request(const unsigned char *mssgData, HSteamNetConnection sourceConn) {
+//Size of a message carrying a single value (see create_mini_message) and two values (see create_small_message)
+static const int MINI_MESSAGE_SIZE = 1 + sizeof(uint32_t);
+static const int SMALL_MESSAGE_SIZE = 1 + (2 * sizeof(uint32_t));
+
+MessageRejection World::SERVER_SIDE_load_zone_request(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
 	print_line("Load Zone Request recieved!");
+	if(mssgLen < MINI_MESSAGE_SIZE){
+		return REJECTION_MALFORMED;
+	}
+
 	// Get the zone requested by the player
 	ZoneID_t zoneId = deserialize_mini(mssgData);
-	Zone *zone = GDNet::singleton->m_zoneRegistry.get(zoneId).zone;
+	ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneId);
+	if(!zoneInfo){
+		return REJECTION_UNKNOWN_ZONE;
+	}
 
 	// Try to instantiate the zone (if it hasnt already been)
-	zone->call_deferred("instantiate_callback");
+	zoneInfo->zone->call_deferred("instantiate_callback");
 //	if (!zone->is_instantiated() && !zone->instantiate_zone()) {
 //		ERR_PRINT("Could not instantiate zone!");
 //		return;
@@ -149,14 +184,34 @@ void World::SERVER_SIDE_load_zone_request(const unsigned char *mssgData, HSteamN
 	// Tell the player to load the zone locally on their end
 	SteamNetworkingMessage_t *pOutgoingMssg = create_mini_message(LOAD_ZONE_REQUEST, zoneId, sourceConn);
 	send_message_reliable(pOutgoingMssg);
+
+	return REJECTION_NONE;
 }
 
-void World::SERVER_SIDE_load_zone_acknowledge(const unsigned char *mssgData, HSteamNetConnection sourceConn) {
+MessageRejection World::SERVER_SIDE_load_zone_acknowledge(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
 	print_line("Load Zone Ack recieved!");
+	if(mssgLen < MINI_MESSAGE_SIZE){
+		return REJECTION_MALFORMED;
+	}
+
 	// Get the requesting player's id and the zone they requested
-	Ref<PlayerInfo> playerInfo = m_worldPlayerInfoByConnection[sourceConn];
+	Ref<PlayerInfo> *playerInfoPtr = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!playerInfoPtr){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
+	Ref<PlayerInfo> playerInfo = *playerInfoPtr;
+
 	ZoneID_t zoneId = deserialize_mini(mssgData);
-	Zone *zone = GDNet::singleton->m_zoneRegistry[zoneId].zone;
+	ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneId);
+	if(!zoneInfo){
+		return REJECTION_UNKNOWN_ZONE;
+	}
+	Zone *zone = zoneInfo->zone;
+
+	//Players can be loaded into several zones at once, but only once into each
+	if(playerInfo->is_zone_loaded(zoneId)){
+		return REJECTION_NONE;
+	}
 
 	// Add the player's info to the zone and add the zone to the player's list of loaded zones.
 	zone->add_player(playerInfo);
@@ -166,10 +221,10 @@ void World::SERVER_SIDE_load_zone_acknowledge(const unsigned char *mssgData, HSt
 	if(zone->m_playersInZone.size() == 1){
 		//This is important: mark that the player has loaded in all players (since there are none in the zone).
 		//Otherwise the server will make this player load in all entities in the zone again when another player loads into the zone.
-		playerInfo->m_playerInfo.loadedPlayersInZone = true;
+		playerInfo->get_zone_subscription(zoneId)->loadedPlayersInZone = true;
 
 		//Now make the player load all entities that are currently in the zone
-		playerInfo->load_entities_in_current_zone();
+		playerInfo->load_entities_in_zone(zone);
 	}else{
 		//Tell all current players in the zone that a new player in loading in.
 		//Also tell the new player to load in all other players in the zone.
@@ -182,74 +237,199 @@ void World::SERVER_SIDE_load_zone_acknowledge(const unsigned char *mssgData, HSt
 				continue;
 			}
 			//Tell the selected player in the zone to load info about the new player
-			playerInZone.value->load_player(playerInfo);
+			playerInZone.value->load_player(playerInfo, zone);
 
 			//Make the new player load the info for the selected player
-			playerInfo->load_player(playerInZone.value);
+			playerInfo->load_player(playerInZone.value, zone);
 		}
 	}
+
+	return REJECTION_NONE;
 }
 
-void World::SERVER_SIDE_create_zone_player_info_acknowledge(const unsigned char *mssgData, HSteamNetConnection sourceConn) {
+MessageRejection World::SERVER_SIDE_create_zone_player_info_acknowledge(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	if(mssgLen < SMALL_MESSAGE_SIZE){
+		return REJECTION_MALFORMED;
+	}
+
 	//Get the player who sent the acknowledgement
-	Ref<PlayerInfo> playerInfo = m_worldPlayerInfoByConnection.get(sourceConn);
+	Ref<PlayerInfo> *playerInfo = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!playerInfo){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
 
-	//Deserialize the acknowledged player (info) id from the message data
-	PlayerID_t playerIdAck = deserialize_mini(mssgData);
+	//Deserialize the acknowledged player (info) id and the zone it was created in from the message data
+	PlayerID_t playerIdAck;
+	ZoneID_t zoneId;
+	deserialize_small(mssgData, playerIdAck, zoneId);
 
 	//Confirm that the player info has been created on the client's end
-	playerInfo->confirm_player_load(playerIdAck);
+	(*playerInfo)->confirm_player_load(playerIdAck, zoneId);
+
+	return REJECTION_NONE;
 }
 
-void World::SERVER_SIDE_load_entity_request(const unsigned char *mssgData) {
+MessageRejection World::SERVER_SIDE_load_entity_request(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
 	print_line("Create entity request recieved!");
+	Ref<PlayerInfo> *sourcePlayer = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!sourcePlayer){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
+
 	//Create a new entity info refrence to store on the server side
 	Ref<EntityInfo> entityInfo(memnew(EntityInfo));
 
 	//Deseralize the message data into the reference
-	entityInfo->deserialize_info(mssgData);
+	if(!entityInfo->deserialize_info(mssgData, mssgLen)){
+		return REJECTION_MALFORMED;
+	}
 
 	//Create the entity
 	ZoneID_t parentZoneId = entityInfo->m_entityInfo.parentZone;
-	Zone* parentZone = GDNet::singleton->m_zoneRegistry.get(parentZoneId).zone;
+	ZoneInfo_t *parentZoneInfo = GDNet::singleton->m_zoneRegistry.getptr(parentZoneId);
+	if(!parentZoneInfo){
+		return REJECTION_UNKNOWN_ZONE;
+	}
+
+	//Players can only create entities in zones they are loaded into
+	if(!(*sourcePlayer)->is_zone_loaded(parentZoneId)){
+		return REJECTION_UNAUTHORIZED;
+	}
+
+	//Players can only create entities owned by themselves (or by nobody), whatever the request says
+	if(entityInfo->get_owner_id() != 0){
+		entityInfo->set_owner_id((*sourcePlayer)->get_player_id());
+	}
 
-	parentZone->load_entity(entityInfo);
+	if(!parentZoneInfo->zone->load_entity(entityInfo)){
+		return REJECTION_MALFORMED;
+	}
 
 	print_line("Entity load complete!");
+	return REJECTION_NONE;
 }
 
-void World::SERVER_SIDE_load_entity_acknowledge(const unsigned char *mssgData, HSteamNetConnection sourceConn) {
+MessageRejection World::SERVER_SIDE_load_entity_acknowledge(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	if(mssgLen < SMALL_MESSAGE_SIZE){
+		return REJECTION_MALFORMED;
+	}
+
 	//Get the player who sent the acknowledgement
-	Ref<PlayerInfo> playerInfo = m_worldPlayerInfoByConnection.get(sourceConn);
+	Ref<PlayerInfo> *playerInfo = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!playerInfo){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
 
 	//Deserialize the acknowledgement message
-	EntityNetworkID_t networkIdAck = deserialize_mini(mssgData);
+	EntityNetworkID_t networkIdAck;
+	ZoneID_t zoneId;
+	deserialize_small(mssgData, networkIdAck, zoneId);
 
 	//Confirm by recording that the entity has been created successfully on the client's side
-	playerInfo->confirm_entity_load(networkIdAck);
+	(*playerInfo)->confirm_entity_load(networkIdAck, zoneId);
+
+	return REJECTION_NONE;
+}
+
+//Epochs wrap around, so an epoch is older if it is behind the current one by less than half the range
+static bool is_stale_epoch(uint8_t updateEpoch, uint8_t currentEpoch) {
+	return static_cast<int8_t>(updateEpoch - currentEpoch) < 0;
 }
 
-void World::SERVER_SIDE_handle_entity_update(const unsigned char *mssgData, const int mssgLen) {
-	//Get the update information metadata
-	EntityUpdateInfo_t updateInfo = NetworkModule::deserialize_update_metadata(mssgData, mssgLen);
+MessageRejection World::SERVER_SIDE_handle_entity_update(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	Ref<PlayerInfo> *sourcePlayer = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!sourcePlayer){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
+	PlayerID_t sourcePlayerId = (*sourcePlayer)->get_player_id();
+
+	//The zone id is the same for the whole frame, so it only has to be looked up once
+	if(mssgLen < StateFrameBuilder::HEADER_SIZE){
+		return REJECTION_MALFORMED;
+	}
+	ZoneID_t zoneId = codec_byte_order(deserialize_basic<ZoneID_t>(1, mssgData));
+	ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneId);
+	if(!zoneInfo){
+		return REJECTION_UNKNOWN_ZONE;
+	}
+	Zone* parentZone = zoneInfo->zone;
+
+	EntityUpdateInfo_t updateInfo;
+	int dataIdx = StateFrameBuilder::HEADER_SIZE;
+
+	//Unpack every update in the state frame. Only a frame that cant be parsed gets rejected as a whole, entries that
+	//cant be applied are counted and skipped on their own.
+	while(dataIdx < mssgLen){
+		if(!StateFrameBuilder::read_update(mssgData, mssgLen, dataIdx, updateInfo)){
+			return REJECTION_MALFORMED;
+		}
+
+		if(updateInfo.payloadSize > MAX_INBOUND_PAYLOAD_SIZE){
+			return REJECTION_MALFORMED;
+		}
+
+		//Make sure the entity exists. It may not be spawned in yet, the main thread checks that before applying the update.
+		//Updates for an entity that was just migrated or despawned can still be in flight, so this only drops the entry.
+		//Ownership can change on the main thread at any time, so the owner and epoch are read together
+		PlayerID_t ownerId;
+		uint8_t authorityEpoch;
+		if(!parentZone->get_entity_authority(updateInfo.networkId, ownerId, authorityEpoch)){
+			m_rejectedMessages[REJECTION_UNKNOWN_ENTITY].fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		//Updates the previous owner sent before the entity changed hands are still in flight for a while after, they
+		//are stale rather than unauthorized
+		if(updateInfo.authorityEpoch != authorityEpoch){
+			continue;
+		}
+
+		//Only the owner of an entity gets to send updates for it
+		if(ownerId != sourcePlayerId){
+			m_rejectedMessages[REJECTION_UNAUTHORIZED].fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		//Hand the update over to the main thread, which applies it to the corresponding network entity and module
+		queue_inbound_update(updateInfo);
+	}
 
-	//Send the update information to the corresponding network entity and module
-	Zone* parentZone = GDNet::singleton->m_zoneRegistry.get(updateInfo.parentZone).zone;
-	Ref<EntityInfo> networkEntity = parentZone->m_entitiesInZone.get(updateInfo.networkId);
-	networkEntity->m_entityInfo.entityInstance->SERVER_SIDE_recieve_data(updateInfo);
+	return REJECTION_NONE;
 }
 
-void World::SERVER_SIDE_player_left_zone(const unsigned char *mssgData){
+MessageRejection World::SERVER_SIDE_player_left_zone(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn){
+	if(mssgLen < SMALL_MESSAGE_SIZE){
+		return REJECTION_MALFORMED;
+	}
+
 	PlayerID_t leavingPlayer;
 	ZoneID_t zoneLeft;
 
 	//Get the player ID and zone ID of the zone that the player is leaving some
 	deserialize_small(mssgData, leavingPlayer, zoneLeft);
 	print_line(vformat("LEAVING PLAYER DATA: PID %d ZID %d", leavingPlayer, zoneLeft));
+
+	//Players can only take themselves out of a zone
+	Ref<PlayerInfo> *sourcePlayer = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!sourcePlayer){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
+	if((*sourcePlayer)->get_player_id() != leavingPlayer){
+		return REJECTION_UNAUTHORIZED;
+	}
+
 	//Get the zone object being left
-	Zone* targetZone = GDNet::singleton->m_zoneRegistry.get(zoneLeft).zone;
+	ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneLeft);
+	if(!zoneInfo){
+		return REJECTION_UNKNOWN_ZONE;
+	}
+	Zone* targetZone = zoneInfo->zone;
+
 	//Get the player to remove from zone
 	Ref<PlayerInfo> player = targetZone->get_player(leavingPlayer);
+	if(player.is_null()){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
 
 	//Remove the player from the zone
 	targetZone->call_deferred("_remove_player", player);
@@ -263,10 +443,124 @@ void World::SERVER_SIDE_player_left_zone(const unsigned char *mssgData){
 
 		HSteamNetConnection playerEndpoint = playerInZone.value->get_player_conn();
 
+		//Same lane as entity creations, so the player's entities are never created after the player is gone
 		SteamNetworkingMessage_t* playerLeftMssg = create_small_message(PLAYER_LEFT_ZONE, leavingPlayer, zoneLeft, playerEndpoint);
-		send_message_reliable(playerLeftMssg);
+		send_message_reliable(playerLeftMssg, LANE_GAMEPLAY);
+	}
+
+	return REJECTION_NONE;
+}
+
+MessageRejection World::SERVER_SIDE_set_active_zone(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	if(mssgLen < MINI_MESSAGE_SIZE){
+		return REJECTION_MALFORMED;
+	}
+
+	Ref<PlayerInfo> *playerInfo = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!playerInfo){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
+
+	//Players can only move into zones they are already loaded into
+	ZoneID_t zoneId = deserialize_mini(mssgData);
+	ZoneSubscription_t *subscription = (*playerInfo)->get_zone_subscription(zoneId);
+	if(!subscription){
+		return REJECTION_UNKNOWN_ZONE;
+	}
+
+	//Moving between loaded zones only changes which zone gets full rate updates, nothing gets reloaded
+	(*playerInfo)->set_current_loaded_zone(subscription->zone);
+
+	return REJECTION_NONE;
+}
+
+MessageRejection World::SERVER_SIDE_clock_sync_ping(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	//Read the clock as early as possible so handling the message doesnt count as time in flight
+	SteamNetworkingMicroseconds serverTime = SteamNetworkingUtils()->GetLocalTimestamp();
+
+	Ref<PlayerInfo> *playerInfo = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!playerInfo){
+		return REJECTION_UNKNOWN_PLAYER;
+	}
+
+	//When the player sent the ping, and the estimate it has worked out so far
+	MessageReader reader(mssgData, mssgLen, 1);
+	int64_t pingSent;
+	bool synced;
+	int64_t offset;
+	uint64_t roundTrip;
+	reader.read(pingSent);
+	reader.read_bool(synced);
+	reader.read_zigzag(offset);
+	reader.read_varint(roundTrip);
+	if(reader.has_failed()){
+		return REJECTION_MALFORMED;
+	}
+
+	if(synced){
+		(*playerInfo)->m_clock.set_estimate(offset, static_cast<int64_t>(MIN(roundTrip, static_cast<uint64_t>(CLOCK_SYNC_MAX_ROUND_TRIP_USEC))));
+	}
+
+	//Echo the ping time back along with the server clock. A late pong is useless, so it isnt resent if lost.
+	unsigned char pongData[1 + 2 * sizeof(int64_t)];
+	MessageWriter writer(pongData, sizeof(pongData));
+	writer.write<unsigned char>(CLOCK_SYNC_PONG);
+	writer.write<int64_t>(pingSent);
+	writer.write<int64_t>(serverTime);
+
+	SteamNetworkingMessage_t *pongMssg = allocate_message(pongData, writer.get_size(), sourceConn);
+	send_message_unreliable(pongMssg, LANE_CONTROL);
+
+	return REJECTION_NONE;
+}
+
+MessageRejection World::SERVER_SIDE_rpc_batch(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	if(mssgLen < 2){
+		return REJECTION_MALFORMED;
+	}
+
+	Ref<PlayerInfo> *playerInfo = m_worldPlayerInfoByConnection.getptr(sourceConn);
+	if(!playerInfo){
+		return REJECTION_UNKNOWN_PLAYER;
 	}
 
+	//Calls have to be made on the main thread, which is also where they get checked against the zone or entity they target
+	queue_inbound_rpc_batch(mssgData, mssgLen, (*playerInfo)->get_player_id());
+
+	return REJECTION_NONE;
+}
+
+MessageRejection World::SERVER_SIDE_dispatch_message(const unsigned char *mssgData, const int mssgLen, HSteamNetConnection sourceConn) {
+	//Every message needs at least a type
+	if(mssgLen < 1){
+		return REJECTION_MALFORMED;
+	}
+
+	//Check the type of message recieved
+	switch (mssgData[0]) {
+		case LOAD_ZONE_REQUEST:
+			return SERVER_SIDE_load_zone_request(mssgData, mssgLen, sourceConn);
+		case LOAD_ZONE_ACKNOWLEDGE:
+			return SERVER_SIDE_load_zone_acknowledge(mssgData, mssgLen, sourceConn);
+		case CREATE_ZONE_PLAYER_INFO_ACKNOWLEDGE:
+			return SERVER_SIDE_create_zone_player_info_acknowledge(mssgData, mssgLen, sourceConn);
+		case CREATE_ENTITY_REQUEST:
+			return SERVER_SIDE_load_entity_request(mssgData, mssgLen, sourceConn);
+		case CREATE_ENTITY_ACKNOWLEDGE:
+			return SERVER_SIDE_load_entity_acknowledge(mssgData, mssgLen, sourceConn);
+		case NETWORK_ENTITY_UPDATE:
+			return SERVER_SIDE_handle_entity_update(mssgData, mssgLen, sourceConn);
+		case PLAYER_LEFT_ZONE:
+			return SERVER_SIDE_player_left_zone(mssgData, mssgLen, sourceConn);
+		case SET_ACTIVE_ZONE:
+			return SERVER_SIDE_set_active_zone(mssgData, mssgLen, sourceConn);
+		case CLOCK_SYNC_PING:
+			return SERVER_SIDE_clock_sync_ping(mssgData, mssgLen, sourceConn);
+		case RPC_BATCH:
+			return SERVER_SIDE_rpc_batch(mssgData, mssgLen, sourceConn);
+		default:
+			return REJECTION_UNKNOWN_TYPE;
+	}
 }
 
 
@@ -322,36 +616,18 @@ void World::SERVER_SIDE_poll_incoming_messages() {
 			SteamNetworkingMessage_t *pMessage = pIncomingMsgs[i];
 			const unsigned char *mssgData = static_cast<unsigned char *>(pMessage->m_pData);
 
-			//Check the type of message recieved
-			switch (mssgData[0]) {
-				case LOAD_ZONE_REQUEST:
-					SERVER_SIDE_load_zone_request(mssgData, pMessage->m_conn);
-					break;
-				case LOAD_ZONE_ACKNOWLEDGE:
-					SERVER_SIDE_load_zone_acknowledge(mssgData, pMessage->m_conn);
-					break;
-				case CREATE_ZONE_PLAYER_INFO_ACKNOWLEDGE:
-					SERVER_SIDE_create_zone_player_info_acknowledge(mssgData, pMessage->m_conn);
-					break;
-				case CREATE_ENTITY_REQUEST:
-					SERVER_SIDE_load_entity_request(mssgData);
-					break;
-				case CREATE_ENTITY_ACKNOWLEDGE:
-					SERVER_SIDE_load_entity_acknowledge(mssgData, pMessage->m_conn);
-					break;
-				case NETWORK_ENTITY_UPDATE:
-					SERVER_SIDE_handle_entity_update(mssgData, pMessage->m_cbSize);
-					break;
-				case PLAYER_LEFT_ZONE:
-					SERVER_SIDE_player_left_zone(mssgData);
-					break;
-				default:
-					break;
+			//Client data is never trusted. Anything that fails validation is dropped and counted.
+			MessageRejection rejection = SERVER_SIDE_dispatch_message(mssgData, pMessage->m_cbSize, pMessage->m_conn);
+			if (rejection != REJECTION_NONE) {
+				m_rejectedMessages[rejection].fetch_add(1, std::memory_order_relaxed);
 			}
 
 			//Dispose of the message
 			pMessage->Release();
 		}
+
+		//The whole recieve batch has been handled, so its transient buffers can be reused
+		FrameArena::get_thread_arena().reset();
 	}
 }
 
@@ -369,6 +645,20 @@ void World::server_tick_loop() {
 	while(m_serverRunLoop){
 		emit_signal("_server_side_transmit_entity_data");
 
+		//Entities a headless server did not instantiate arent connected to the signal, so their zones relay them directly
+		if(GDNet::singleton->m_headlessServer){
+			for(const KeyValue<ZoneID_t, ZoneInfo_t> &zoneInfo : GDNet::singleton->m_zoneRegistry){
+				zoneInfo.value.zone->SERVER_SIDE_headless_tick();
+			}
+		}
+
+		flush_state_frames();
+		flush_rpc_batches();
+
+		//Everything serialized this tick has been sent, so the tick's transient buffers can be reused
+		FrameArena::get_thread_arena().reset();
+		m_serverTick++;
+
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
 }
@@ -403,16 +693,23 @@ void World::CLIENT_SIDE_load_zone_request(const unsigned char *mssgData) {
 	ZoneID_t zoneId = deserialize_mini(mssgData);
 	print_line(vformat("Loading zone with id %d", zoneId));
 
-	//If instantiation was successful, send an acknowledgement to the server
-	if(CLIENT_SIDE_instantiate_zone(zoneId)){
-		SteamNetworkingMessage_t *zoneLoadAck = create_mini_message(LOAD_ZONE_ACKNOWLEDGE, zoneId, m_worldConnection);
-		send_message_reliable(zoneLoadAck);
+	//The zone sends the acknowledgement to the server itself once it has finished streaming in
+	if(!CLIENT_SIDE_instantiate_zone(zoneId)){
+		ERR_PRINT(vformat("Server requested unknown zone with id %d!", zoneId));
 	}
 }
 
 void World::CLIENT_SIDE_process_create_zone_player_info_request(const unsigned char *mssgData) {
-	//Get the player ID for the player that needs a player info object to be created
-	PlayerID_t playerId = deserialize_mini(mssgData);
+	//Get the player ID for the player that needs a player info object to be created and the zone they are in
+	PlayerID_t playerId;
+	ZoneID_t zoneId;
+	deserialize_small(mssgData, playerId, zoneId);
+
+	ZoneSubscription_t *subscription = m_localPlayer->get_zone_subscription(zoneId);
+	if(!subscription){
+		ERR_PRINT(vformat("Server sent a player for zone %d which is not loaded!", zoneId));
+		return;
+	}
 
 	//Create the playerinfo object for the incoming player id and populate it
 	Ref<PlayerInfo> incomingPlayerInfo(memnew(PlayerInfo));
@@ -420,21 +717,24 @@ void World::CLIENT_SIDE_process_create_zone_player_info_request(const unsigned c
 	print_line(vformat("Created new player info for %d!", playerId));
 
 	//Add the new player info to the zone's list players
-	m_localPlayer->get_current_loaded_zone()->add_player(incomingPlayerInfo);
+	subscription->zone->add_player(incomingPlayerInfo);
 
 	//Send a "load" acknowledgement back to the server
-	SteamNetworkingMessage_t* ackMssg = create_mini_message(CREATE_ZONE_PLAYER_INFO_ACKNOWLEDGE, playerId, m_worldConnection);
+	SteamNetworkingMessage_t* ackMssg = create_small_message(CREATE_ZONE_PLAYER_INFO_ACKNOWLEDGE, playerId, zoneId, m_worldConnection);
 	send_message_reliable(ackMssg);
 	print_line("Created player and sent ack");
 }
 
-void World::CLIENT_SIDE_load_entity_request(const unsigned char *mssgData) {
+void World::CLIENT_SIDE_load_entity_request(const unsigned char *mssgData, const int mssgLen) {
 	print_line("Create entity request recieved!");
 	//Create a new entity info refrence to store on the client side
 	Ref<EntityInfo> entityInfo(memnew(EntityInfo));
 
 	//Deseralize the message data into the reference
-	entityInfo->deserialize_info(mssgData);
+	if(!entityInfo->deserialize_info(mssgData, mssgLen)){
+		ERR_PRINT("Recieved a malformed entity creation request!");
+		return;
+	}
 
 	//Create the entity
 	ZoneID_t parentZoneId = entityInfo->m_entityInfo.parentZone;
@@ -445,21 +745,19 @@ void World::CLIENT_SIDE_load_entity_request(const unsigned char *mssgData) {
 	EntityNetworkID_t networkId = entityInfo->m_entityInfo.networkId;
 	HSteamNetConnection worldConn = GDNet::singleton->world->m_worldConnection;
 
-	SteamNetworkingMessage_t* ackMssg = create_mini_message(CREATE_ENTITY_ACKNOWLEDGE, networkId, worldConn);
+	SteamNetworkingMessage_t* ackMssg = create_small_message(CREATE_ENTITY_ACKNOWLEDGE, networkId, parentZoneId, worldConn);
 	send_message_reliable(ackMssg);
 }
 
 void World::CLIENT_SIDE_handle_entity_update(const unsigned char *mssgData, const int mssgLen) {
-	//Get the update information metadata
-	EntityUpdateInfo_t updateInfo = NetworkModule::deserialize_update_metadata(mssgData, mssgLen);
+	EntityUpdateInfo_t updateInfo;
+	int dataIdx = StateFrameBuilder::HEADER_SIZE;
 
-	//Send the update information to the corresponding network entity and module
-	Zone* parentZone = GDNet::singleton->m_zoneRegistry.get(updateInfo.parentZone).zone;
-
-	//Make sure the entity was loaded in before trying to apply the update
-	if(parentZone->m_entitiesInZone.has(updateInfo.networkId)){
-		Ref<EntityInfo> networkEntity = parentZone->m_entitiesInZone.get(updateInfo.networkId);
-		networkEntity->m_entityInfo.entityInstance->CLIENT_SIDE_recieve_data(updateInfo);
+	//Unpack every update in the state frame and hand them over to the main thread
+	while(dataIdx < mssgLen && StateFrameBuilder::read_update(mssgData, mssgLen, dataIdx, updateInfo)){
+		if(updateInfo.payloadSize <= MAX_INBOUND_PAYLOAD_SIZE){
+			queue_inbound_update(updateInfo);
+		}
 	}
 }
 
@@ -478,6 +776,123 @@ void World::CLIENT_SIDE_player_left_zone(const unsigned char *mssgData) {
 }
 
 
+void World::CLIENT_SIDE_entity_migrated(const unsigned char *mssgData, const int mssgLen) {
+	MessageReader reader(mssgData, mssgLen, 1);
+	uint32_t networkId;
+	uint32_t sourceZoneId;
+	uint32_t targetZoneId;
+	String parentRelativePath;
+
+	reader.read_varint(networkId);
+	reader.read_varint(sourceZoneId);
+	reader.read_varint(targetZoneId);
+	reader.read_string(parentRelativePath);
+	if(reader.has_failed()){
+		ERR_PRINT("Recieved a malformed entity migration!");
+		return;
+	}
+
+	//The node has to be moved on the main thread
+	callable_mp(this, &World::CLIENT_SIDE_migrate_entity_callback).call_deferred(networkId, sourceZoneId, targetZoneId, parentRelativePath);
+}
+
+void World::CLIENT_SIDE_migrate_entity_callback(EntityNetworkID_t networkId, ZoneID_t sourceZoneId, ZoneID_t targetZoneId, String parentRelativePath) {
+	ZoneInfo_t *sourceZoneInfo = GDNet::singleton->m_zoneRegistry.getptr(sourceZoneId);
+	ZoneInfo_t *targetZoneInfo = GDNet::singleton->m_zoneRegistry.getptr(targetZoneId);
+	if(!sourceZoneInfo || !targetZoneInfo){
+		return;
+	}
+
+	Ref<EntityInfo> entityInfo = sourceZoneInfo->zone->get_entity(networkId);
+	if(entityInfo.is_null()){
+		return;
+	}
+
+	//Entities leaving for a zone this player isnt loaded into are just gone as far as this player is concerned
+	if(!m_localPlayer->is_zone_loaded(targetZoneId)){
+		sourceZoneInfo->zone->destroy_entity(entityInfo);
+		return;
+	}
+
+	entityInfo->set_parent_relative_path(parentRelativePath);
+	sourceZoneInfo->zone->migrate_entity(entityInfo, targetZoneInfo->zone);
+}
+
+void World::CLIENT_SIDE_ownership_transferred(const unsigned char *mssgData, const int mssgLen) {
+	MessageReader reader(mssgData, mssgLen, 1);
+	uint32_t networkId;
+	uint32_t zoneId;
+	uint32_t newOwner;
+	uint8_t authorityEpoch;
+
+	reader.read_varint(networkId);
+	reader.read_varint(zoneId);
+	reader.read_varint(newOwner);
+	reader.read(authorityEpoch);
+	if(reader.has_failed()){
+		ERR_PRINT("Recieved a malformed ownership transfer!");
+		return;
+	}
+
+	//Owned entity lists and the entity node are only touched on the main thread
+	callable_mp(this, &World::CLIENT_SIDE_transfer_ownership_callback).call_deferred(networkId, zoneId, newOwner, authorityEpoch);
+}
+
+void World::CLIENT_SIDE_transfer_ownership_callback(EntityNetworkID_t networkId, ZoneID_t zoneId, PlayerID_t newOwner, uint8_t authorityEpoch) {
+	ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneId);
+	if(!zoneInfo){
+		return;
+	}
+
+	Ref<EntityInfo> entityInfo = zoneInfo->zone->get_entity(networkId);
+	if(entityInfo.is_null() || is_stale_epoch(authorityEpoch, entityInfo->m_entityInfo.authorityEpoch)){
+		return;
+	}
+
+	zoneInfo->zone->set_entity_owner(entityInfo, newOwner, authorityEpoch);
+}
+
+void World::CLIENT_SIDE_clock_sync_pong(const unsigned char *mssgData, const int mssgLen) {
+	SteamNetworkingMicroseconds pongRecieved = SteamNetworkingUtils()->GetLocalTimestamp();
+
+	MessageReader reader(mssgData, mssgLen, 1);
+	int64_t pingSent;
+	int64_t serverTime;
+	reader.read(pingSent);
+	reader.read(serverTime);
+	if(reader.has_failed()){
+		return;
+	}
+
+	m_localPlayer->m_clock.add_sample(pingSent, serverTime, pongRecieved);
+}
+
+//Pings the server every so often to keep the clock estimate fresh. Only ever called from the listen thread.
+void World::CLIENT_SIDE_sync_clock() {
+	//Nothing can be sent until the server has accepted the player
+	if(m_localPlayer->get_player_id() == 0){
+		return;
+	}
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	ClockSync &clock = m_localPlayer->m_clock;
+	if(!clock.should_ping(now)){
+		return;
+	}
+
+	//The ping also reports the current estimate, so the server knows each player's offset and round trip time
+	unsigned char pingData[1 + sizeof(int64_t) + 1 + 10 + 10];
+	MessageWriter writer(pingData, sizeof(pingData));
+	writer.write<unsigned char>(CLOCK_SYNC_PING);
+	writer.write<int64_t>(now);
+	writer.write_bool(clock.is_synced());
+	writer.write_zigzag(clock.get_offset());
+	writer.write_varint(clock.get_round_trip_time());
+
+	SteamNetworkingMessage_t *pingMssg = allocate_message(pingData, writer.get_size(), m_worldConnection);
+	send_message_unreliable(pingMssg, LANE_CONTROL);
+}
+
 void World::CLIENT_SIDE_connection_status_changed(SteamNetConnectionStatusChangedCallback_t *pInfo) {
 	//What's the state of the connection?
 	switch (pInfo->m_info.m_eState) {
@@ -519,6 +934,8 @@ void World::CLIENT_SIDE_connection_status_changed(SteamNetConnectionStatusChange
 			break;
 
 		case k_ESteamNetworkingConnectionState_Connected:
+			//Lanes are configured per direction, so the client has to split its side of the connection as well
+			configure_connection_lanes(pInfo->m_hConn);
 			print_line("Successfully connected to world!");
 			break;
 
@@ -528,64 +945,108 @@ void World::CLIENT_SIDE_connection_status_changed(SteamNetConnectionStatusChange
 	}
 }
 
-void World::CLIENT_SIDE_poll_incoming_messages() {
-	while (m_clientRunLoop) {
-		SteamNetworkingMessage_t *pIncomingMsgs[1];
-		int numMsgs = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_worldConnection, pIncomingMsgs, 1);
+void World::CLIENT_SIDE_dispatch_message(SteamNetworkingMessage_t *pMessage) {
+	const unsigned char *mssgData = static_cast<unsigned char *>(pMessage->m_pData);
+	if (pMessage->m_cbSize < 1) {
+		return;
+	}
 
-		if (numMsgs == 0) {
-			return;
+	//Check the type of message recieved and evaluate accordingly
+	switch (mssgData[0]) {
+		case ASSIGN_PLAYER_ID:
+			CLIENT_SIDE_assign_player_id(mssgData);
+			break;
+		case LOAD_ZONE_REQUEST:
+			CLIENT_SIDE_load_zone_request(mssgData);
+			break;
+		case LOAD_ZONE_COMPLETE:
+			CLIENT_SIDE_zone_load_complete(mssgData);
+			break;
+		case CREATE_ZONE_PLAYER_INFO_REQUEST:
+			CLIENT_SIDE_process_create_zone_player_info_request(mssgData);
+			break;
+		case CREATE_ENTITY_REQUEST:
+			CLIENT_SIDE_load_entity_request(mssgData, pMessage->m_cbSize);
+			break;
+		case NETWORK_ENTITY_UPDATE:
+			CLIENT_SIDE_handle_entity_update(mssgData, pMessage->m_cbSize);
+			break;
+		case PLAYER_LEFT_ZONE:
+			CLIENT_SIDE_player_left_zone(mssgData);
+			break;
+		case ENTITY_MIGRATED:
+			CLIENT_SIDE_entity_migrated(mssgData, pMessage->m_cbSize);
+			break;
+		case ENTITY_OWNERSHIP_TRANSFERRED:
+			CLIENT_SIDE_ownership_transferred(mssgData, pMessage->m_cbSize);
+			break;
+		case CLOCK_SYNC_PONG:
+			CLIENT_SIDE_clock_sync_pong(mssgData, pMessage->m_cbSize);
+			break;
+		case RPC_BATCH:{
+			//Calls from the server are made on the main thread
+			queue_inbound_rpc_batch(mssgData, pMessage->m_cbSize, 0U);
+			break;
 		}
+		default:
+			break;
+	}
+}
+
+//Drains everything waiting on the connection in batches. Returns how many messages were handled.
+int World::CLIENT_SIDE_poll_incoming_messages() {
+	SteamNetworkingMessage_t *pIncomingMsgs[MAX_RECEIVE_BATCH_SIZE];
+	int batchSize = m_receiveBatchSize.load(std::memory_order_relaxed);
+	int totalMsgs = 0;
+
+	while (m_clientRunLoop) {
+		int numMsgs = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_worldConnection, pIncomingMsgs, batchSize);
 
 		if (numMsgs < 0) {
 			ERR_PRINT("Error checking messages");
 			m_clientRunLoop = false;
-			return;
+			break;
 		}
 
 		//Evaluate each message
 		for (int i = 0; i < numMsgs; i++) {
-			SteamNetworkingMessage_t *pMessage = pIncomingMsgs[i];
-			const unsigned char *mssgData = static_cast<unsigned char *>(pMessage->m_pData);
-
-			//Check the type of message recieved and evaluate accordingly
-			switch (mssgData[0]) {
-				case ASSIGN_PLAYER_ID:
-					CLIENT_SIDE_assign_player_id(mssgData);
-					break;
-				case LOAD_ZONE_REQUEST:
-					CLIENT_SIDE_load_zone_request(mssgData);
-					break;
-				case LOAD_ZONE_COMPLETE:
-					CLIENT_SIDE_zone_load_complete(mssgData);
-					break;
-				case CREATE_ZONE_PLAYER_INFO_REQUEST:
-					CLIENT_SIDE_process_create_zone_player_info_request(mssgData);
-					break;
-				case CREATE_ENTITY_REQUEST:
-					CLIENT_SIDE_load_entity_request(mssgData);
-					break;
-				case NETWORK_ENTITY_UPDATE:
-					CLIENT_SIDE_handle_entity_update(mssgData, pMessage->m_cbSize);
-					break;
-				case PLAYER_LEFT_ZONE:
-					CLIENT_SIDE_player_left_zone(mssgData);
-					break;
-				default:
-					break;
-			}
+			CLIENT_SIDE_dispatch_message(pIncomingMsgs[i]);
 
 			//Dispose of the message
-			pMessage->Release();
+			pIncomingMsgs[i]->Release();
+		}
+
+		//The whole recieve batch has been handled, so its transient buffers can be reused.
+		//Entity updates from it are already sitting in their mailboxes for the main thread.
+		FrameArena::get_thread_arena().reset();
+		totalMsgs += numMsgs;
+
+		//A partial batch means the connection has been drained
+		if (numMsgs < batchSize) {
+			break;
 		}
 	}
+
+	return totalMsgs;
 }
 
 void World::client_listen_loop() {
+	int idleSleepUsec = 0;
+
 	while (m_clientRunLoop) {
-		CLIENT_SIDE_poll_incoming_messages();
+		int numMsgs = CLIENT_SIDE_poll_incoming_messages();
 		SteamNetworkingSockets()->RunCallbacks();
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		CLIENT_SIDE_sync_clock();
+
+		//Keep polling right away while messages are coming in, and back off gradually once they stop
+		//so an idle client doesnt spin, without adding a fixed delay to every message.
+		if (numMsgs > 0) {
+			idleSleepUsec = 0;
+			std::this_thread::yield();
+		} else {
+			idleSleepUsec = idleSleepUsec == 0 ? 50 : MIN(idleSleepUsec * 2, MAX_RECEIVE_IDLE_SLEEP_USEC);
+			std::this_thread::sleep_for(std::chrono::microseconds(idleSleepUsec));
+		}
 	}
 }
 
@@ -594,6 +1055,11 @@ void World::client_tick_loop() {
 
 	while(m_clientRunLoop){
 		emit_signal("_client_side_transmit_entity_data");
+		flush_state_frames();
+		flush_rpc_batches();
+
+		//Everything serialized this tick has been sent, so the tick's transient buffers can be reused
+		FrameArena::get_thread_arena().reset();
 
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
@@ -601,21 +1067,428 @@ void World::client_tick_loop() {
 
 //=======================================================================================================================//
 
+void World::flush_state_frames() {
+	//How many ticks a destination can go without any updates before its builder gets dropped
+	const int maxIdleFlushes = 1000;
+
+	List<HSteamNetConnection> idleDestinations;
+
+	//Send off every frame that was built this tick
+	for(KeyValue<HSteamNetConnection, StateFrameBuilder *> &stateFrame : m_stateFrames){
+		stateFrame.value->flush();
+
+		if(stateFrame.value->get_idle_flushes() > maxIdleFlushes){
+			idleDestinations.push_back(stateFrame.key);
+		}
+	}
+
+	//Drop the builders of destinations that stopped recieving updates (left the zone, disconnected, etc.)
+	for(const HSteamNetConnection &destination : idleDestinations){
+		memdelete(m_stateFrames[destination]);
+		m_stateFrames.erase(destination);
+	}
+
+	//Send the shared zone frames to everyone in the zone that should get them
+	List<uint64_t> idleBroadcasts;
+	for(KeyValue<uint64_t, StateFrameBuilder *> &broadcastFrame : m_broadcastFrames){
+		ZoneID_t zoneId = static_cast<ZoneID_t>(broadcastFrame.key >> 1);
+		bool includeNeighbors = broadcastFrame.key & 1;
+
+		m_broadcastDestinations.clear();
+		ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneId);
+		if(zoneInfo){
+			for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : zoneInfo->zone->m_playersInZone){
+				if(includeNeighbors || player.value->get_current_loaded_zone() == zoneInfo->zone){
+					m_broadcastDestinations.push_back(player.value->get_player_conn());
+				}
+			}
+		}
+
+		broadcastFrame.value->flush_shared(m_broadcastDestinations);
+
+		if(broadcastFrame.value->get_idle_flushes() > maxIdleFlushes){
+			idleBroadcasts.push_back(broadcastFrame.key);
+		}
+	}
+
+	for(const uint64_t &broadcastKey : idleBroadcasts){
+		memdelete(m_broadcastFrames[broadcastKey]);
+		m_broadcastFrames.erase(broadcastKey);
+	}
+}
+
+void World::queue_inbound_update(const EntityUpdateInfo_t &updateInfo) {
+	//Find (or create) the mailbox for this entity module
+	uint64_t mailboxKey = (static_cast<uint64_t>(updateInfo.networkId) << 8) | updateInfo.updateType;
+	UpdateMailbox **mailboxPtr = m_updateMailboxes.getptr(mailboxKey);
+	UpdateMailbox *mailbox = mailboxPtr ? *mailboxPtr : nullptr;
+	if(!mailbox){
+		mailbox = memnew(UpdateMailbox(updateInfo.networkId, updateInfo.updateType));
+		m_updateMailboxes.insert(mailboxKey, mailbox);
+	}
+
+	//Only the listen thread advances the sequence
+	uint64_t sequence = m_inboundSequence.load(std::memory_order_relaxed) + 1;
+	m_inboundSequence.store(sequence, std::memory_order_relaxed);
+
+	//Overwrite whatever is waiting in the mailbox, and only queue it if it was clean
+	if(mailbox->post(updateInfo, sequence) && !m_dirtyMailboxes.push(mailbox)){
+		mailbox->cancel_queued();
+		WARN_PRINT_ONCE("Inbound update queue is full, dropping entity updates!");
+	}
+}
+
+//Call this from the listen thread. Batches that dont fit in the queue are dropped, so a client flooding rpcs
+//can only ever have so many waiting on the main thread.
+void World::queue_inbound_rpc_batch(const unsigned char *mssgData, const int mssgLen, PlayerID_t sender) {
+	InboundRpcBatch_t *inboundBatch = memnew(InboundRpcBatch_t);
+	inboundBatch->batch.resize(mssgLen);
+	memcpy(inboundBatch->batch.ptrw(), mssgData, mssgLen);
+	inboundBatch->sender = sender;
+
+	if(!m_inboundRpcBatches.push(inboundBatch)){
+		memdelete(inboundBatch);
+		WARN_PRINT_ONCE("Inbound rpc queue is full, dropping rpc batches!");
+	}
+}
+
+//Runs on the main thread once per frame
+void World::apply_inbound_updates() {
+	//Each dirty mailbox shows up once no matter how many updates it got, so this is bound by the entities that changed
+	UpdateMailbox *mailbox;
+	EntityUpdateInfo_t updateInfo;
+	uint64_t sequence;
+	while(m_dirtyMailboxes.pop(mailbox)){
+		if(!mailbox->take(updateInfo, sequence)){
+			continue;
+		}
+
+		//Make sure the zone and entity still exist (and that the entity was loaded in) before applying the update
+		ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(updateInfo.parentZone);
+		if(!zoneInfo){
+			continue;
+		}
+		Ref<EntityInfo> networkEntity = zoneInfo->zone->get_entity(updateInfo.networkId);
+		if(networkEntity.is_null()){
+			continue;
+		}
+
+		//Updates posted before the entity was created were meant for whatever used its network id before
+		if(sequence <= networkEntity->m_entityInfo.inboundSequence){
+			continue;
+		}
+
+		//The entity may have changed hands since the update was queued. The server only takes updates from the
+		//current epoch, clients can also get updates from an epoch they havent heard about yet.
+		uint8_t authorityEpoch = networkEntity->m_entityInfo.authorityEpoch;
+		if(GDNet::singleton->m_isServer ? updateInfo.authorityEpoch != authorityEpoch : is_stale_epoch(updateInfo.authorityEpoch, authorityEpoch)){
+			continue;
+		}
+
+		NetworkEntity *entityInstance = networkEntity->m_entityInfo.entityInstance;
+		if(!entityInstance){
+			//Entities a headless server did not instantiate only exist in the zone's transform table
+			if(GDNet::singleton->m_isServer && GDNet::singleton->m_headlessServer && !zoneInfo->zone->SERVER_SIDE_store_headless_update(networkEntity, updateInfo)){
+				m_rejectedMessages[REJECTION_MALFORMED].fetch_add(1, std::memory_order_relaxed);
+			}
+			continue;
+		}
+
+		//Send the update information to the corresponding network entity and module
+		if(GDNet::singleton->m_isServer){
+			if(!entityInstance->SERVER_SIDE_recieve_data(updateInfo)){
+				m_rejectedMessages[REJECTION_MALFORMED].fetch_add(1, std::memory_order_relaxed);
+			}
+		}else{
+			entityInstance->CLIENT_SIDE_recieve_data(updateInfo);
+		}
+	}
+
+	//Make the rpc calls after the entity updates, so calls see the state that came in with them
+	InboundRpcBatch_t *inboundBatch;
+	while(m_inboundRpcBatches.pop(inboundBatch)){
+		apply_rpc_batch(inboundBatch->batch, inboundBatch->sender);
+		memdelete(inboundBatch);
+	}
+}
+
+//Sends a batch of rpc calls off and empties it (keeping its capacity for the next batch)
+static void send_rpc_batch(HSteamNetConnection destination, LocalVector<uint8_t> &batch, bool reliable) {
+	SteamNetworkingMessage_t *batchMssg = allocate_message(batch.ptr(), batch.size(), destination);
+	if(reliable){
+		send_message_reliable(batchMssg, LANE_GAMEPLAY);
+	}else{
+		send_message_unreliable(batchMssg, LANE_GAMEPLAY);
+	}
+	batch.clear();
+}
+
+//Call this on the main thread. Encodes a call into the rpc scratch buffer and returns its size (0 if it couldnt be encoded).
+//Entry layout: [flags][varint zone id]([varint network id])[varint method id][varint arg count] followed by [type][value] per arg
+int World::encode_rpc(uint8_t flags, ZoneID_t zoneId, EntityNetworkID_t networkId, uint32_t methodId, const Variant **args, int argCount) {
+	for(int i = 0; i < argCount; i++){
+		Variant::Type type = args[i]->get_type();
+		if(type != Variant::NIL && !is_codec_supported_type(type)){
+			ERR_FAIL_V_MSG(0, vformat("Rpc argument %d is a %s, which cannot be sent!", i, Variant::get_type_name(type)));
+		}
+	}
+
+	if(static_cast<int>(m_rpcScratch.size()) < RPC_BATCH_MTU){
+		m_rpcScratch.resize(RPC_BATCH_MTU);
+	}
+
+	//Grow the scratch buffer until the call fits (only big string arguments ever need this)
+	while(true){
+		MessageWriter writer(m_rpcScratch.ptr(), m_rpcScratch.size());
+		writer.write<uint8_t>(flags);
+		writer.write_varint(zoneId);
+		if(flags & RPC_FLAG_ENTITY){
+			writer.write_varint(networkId);
+		}
+		writer.write_varint(methodId);
+		writer.write_varint(argCount);
+
+		for(int i = 0; i < argCount; i++){
+			Variant::Type type = args[i]->get_type();
+			writer.write<uint8_t>(type);
+			if(type != Variant::NIL){
+				encode_typed_value(writer, type, *args[i]);
+			}
+		}
+
+		if(!writer.has_overflowed()){
+			return writer.get_size();
+		}
+
+		ERR_FAIL_COND_V_MSG(static_cast<int>(m_rpcScratch.size()) >= MAX_RPC_SIZE, 0, "Rpc call is too big to be sent!");
+		m_rpcScratch.resize(m_rpcScratch.size() * 2);
+	}
+}
+
+//Call this on the main thread. Adds the call sitting in the rpc scratch buffer to the destination's batch.
+void World::queue_rpc(HSteamNetConnection destination, int entrySize, bool reliable) {
+	std::lock_guard<std::mutex> lock(m_rpcMutex);
+
+	RpcBatch_t *rpcBatch = m_rpcBatches.getptr(destination);
+	if(!rpcBatch){
+		rpcBatch = &m_rpcBatches.insert(destination, RpcBatch_t())->value;
+	}
+	LocalVector<uint8_t> &batch = reliable ? rpcBatch->reliable : rpcBatch->unreliable;
+
+	//Send off what was batched so far if this call would push the batch past the MTU
+	if(!batch.is_empty() && static_cast<int>(batch.size()) + entrySize > RPC_BATCH_MTU){
+		send_rpc_batch(destination, batch, reliable);
+	}
+
+	if(batch.is_empty()){
+		batch.push_back(RPC_BATCH);
+	}
+
+	uint32_t batchSize = batch.size();
+	batch.resize(batchSize + entrySize);
+	memcpy(batch.ptr() + batchSize, m_rpcScratch.ptr(), entrySize);
+}
+
+//Call this on the tick thread
+void World::flush_rpc_batches() {
+	std::lock_guard<std::mutex> lock(m_rpcMutex);
+
+	for(KeyValue<HSteamNetConnection, RpcBatch_t> &rpcBatch : m_rpcBatches){
+		if(!rpcBatch.value.reliable.is_empty()){
+			send_rpc_batch(rpcBatch.key, rpcBatch.value.reliable, true);
+		}
+		if(!rpcBatch.value.unreliable.is_empty()){
+			send_rpc_batch(rpcBatch.key, rpcBatch.value.unreliable, false);
+		}
+	}
+}
+
+//Call this on the main thread. Makes every call in the batch, sender being 0 for calls from the server.
+void World::apply_rpc_batch(const PackedByteArray &batch, PlayerID_t sender) {
+	bool isServer = GDNet::singleton->m_isServer;
+	MessageReader reader(batch.ptr(), batch.size(), 1);
+	LocalVector<Variant> args;
+	LocalVector<const Variant *> argPtrs;
+
+	bool malformed = false;
+
+	m_rpcSender = sender;
+
+	while(!malformed && reader.get_remaining() > 0){
+		uint8_t flags = 0;
+		uint32_t zoneId;
+		uint32_t networkId = 0U;
+		uint32_t methodId;
+		uint32_t argCount;
+
+		reader.read(flags);
+		reader.read_varint(zoneId);
+		if(flags & RPC_FLAG_ENTITY){
+			reader.read_varint(networkId);
+		}
+		reader.read_varint(methodId);
+		reader.read_varint(argCount);
+
+		//Every arg takes at least its type byte
+		if(reader.has_failed() || argCount > static_cast<uint32_t>(reader.get_remaining())){
+			malformed = true;
+			break;
+		}
+
+		args.resize(argCount);
+		argPtrs.resize(argCount);
+		for(uint32_t i = 0; i < argCount && !malformed; i++){
+			uint8_t type = Variant::VARIANT_MAX;
+			reader.read(type);
+			argPtrs[i] = &args[i];
+
+			if(type == Variant::NIL){
+				args[i] = Variant();
+			}else if(type >= Variant::VARIANT_MAX || !is_codec_supported_type(static_cast<Variant::Type>(type)) || !decode_typed_value(reader, static_cast<Variant::Type>(type), args[i])){
+				malformed = true;
+			}
+		}
+		if(malformed || reader.has_failed()){
+			malformed = true;
+			break;
+		}
+
+		//Find what is being called. The server only lets players call into entities they own and zones they are in.
+		ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(zoneId);
+		Object *target = nullptr;
+		const RpcTable *rpcTable = nullptr;
+		MessageRejection rejection = REJECTION_NONE;
+
+		if(!zoneInfo){
+			rejection = REJECTION_UNKNOWN_ZONE;
+		}else if(flags & RPC_FLAG_ENTITY){
+			Ref<EntityInfo> entityInfo = zoneInfo->zone->get_entity(networkId);
+			NetworkEntity *entityInstance = entityInfo.is_valid() ? entityInfo->m_entityInfo.entityInstance : nullptr;
+			if(!entityInstance){
+				rejection = REJECTION_UNKNOWN_ENTITY;
+			}else if(isServer && entityInfo->get_owner_id() != sender){
+				rejection = REJECTION_UNAUTHORIZED;
+			}else{
+				target = entityInstance;
+				rpcTable = &entityInstance->get_rpc_table();
+			}
+		}else if(isServer && !zoneInfo->zone->player_in_zone(sender)){
+			rejection = REJECTION_UNAUTHORIZED;
+		}else{
+			target = zoneInfo->zone;
+			rpcTable = &zoneInfo->zone->get_rpc_table();
+		}
+
+		const StringName *method = rpcTable ? rpcTable->get_method_name(methodId) : nullptr;
+		if(rejection == REJECTION_NONE && !method){
+			rejection = REJECTION_MALFORMED;
+		}
+
+		if(rejection != REJECTION_NONE){
+			if(isServer){
+				m_rejectedMessages[rejection].fetch_add(1, std::memory_order_relaxed);
+			}
+			continue;
+		}
+
+		Callable::CallError callError;
+		target->callp(*method, argPtrs.ptr(), argCount, callError);
+	}
+
+	//Whatever is left over couldnt be read
+	if(isServer && malformed){
+		m_rejectedMessages[REJECTION_MALFORMED].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	m_rpcSender = 0;
+}
+
+//Only call once the network threads have stopped
+void World::free_update_mailboxes() {
+	UpdateMailbox *mailbox;
+	while(m_dirtyMailboxes.pop(mailbox)){}
+
+	for(KeyValue<uint64_t, UpdateMailbox *> &mailboxEntry : m_updateMailboxes){
+		memdelete(mailboxEntry.value);
+	}
+	m_updateMailboxes.clear();
+
+	//Rpc calls that never made it out are bound for connections that are gone by now
+	m_rpcBatches.clear();
+
+	InboundRpcBatch_t *inboundBatch;
+	while(m_inboundRpcBatches.pop(inboundBatch)){
+		memdelete(inboundBatch);
+	}
+
+	//Same goes for state frames, the builders release whatever frame they were still holding
+	for(KeyValue<HSteamNetConnection, StateFrameBuilder *> &stateFrame : m_stateFrames){
+		memdelete(stateFrame.value);
+	}
+	m_stateFrames.clear();
+
+	for(KeyValue<uint64_t, StateFrameBuilder *> &broadcastFrame : m_broadcastFrames){
+		memdelete(broadcastFrame.value);
+	}
+	m_broadcastFrames.clear();
+}
+
+void World::connect_frame_hook() {
+	Callable frameCallback = callable_mp(this, &World::apply_inbound_updates);
+	if(!SceneTree::get_singleton()->is_connected("process_frame", frameCallback)){
+		SceneTree::get_singleton()->connect("process_frame", frameCallback);
+	}
+}
+
+void World::disconnect_frame_hook() {
+	Callable frameCallback = callable_mp(this, &World::apply_inbound_updates);
+	if(SceneTree::get_singleton() && SceneTree::get_singleton()->is_connected("process_frame", frameCallback)){
+		SceneTree::get_singleton()->disconnect("process_frame", frameCallback);
+	}
+}
+
 //==Protected Mehtods==//
 
 void World::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("start_world", "port"), &World::start_world);
 	ClassDB::bind_method(D_METHOD("stop_world"), &World::stop_world);
+	ClassDB::bind_method(D_METHOD("save_snapshot", "path"), &World::save_snapshot);
+	ClassDB::bind_method(D_METHOD("load_snapshot", "path"), &World::load_snapshot);
+	ClassDB::bind_method(D_METHOD("migrate_entity", "entity_info", "target_zone_id", "parent_relative_path"), &World::migrate_entity, DEFVAL(""));
+	ClassDB::bind_method(D_METHOD("transfer_ownership", "entity_info", "player_id"), &World::transfer_ownership);
 	ClassDB::bind_method(D_METHOD("get_player_id"), &World::get_player_id);
 	ClassDB::bind_method(D_METHOD("join_world", "world", "port"), &World::join_world);
 	ClassDB::bind_method(D_METHOD("leave_world"), &World::leave_world);
 	ClassDB::bind_method(D_METHOD("load_zone_by_name", "zone_name"), &World::load_zone_by_name);
 	ClassDB::bind_method(D_METHOD("load_zone_by_id", "zone_id"), &World::load_zone_by_id);
 	ClassDB::bind_method(D_METHOD("unload_zone"), &World::unload_zone);
+	ClassDB::bind_method(D_METHOD("unload_zone_by_id", "zone_id"), &World::unload_zone_by_id);
+	ClassDB::bind_method(D_METHOD("set_active_zone", "zone_id"), &World::set_active_zone);
+	ClassDB::bind_method(D_METHOD("get_active_zone"), &World::get_active_zone);
+	ClassDB::bind_method(D_METHOD("get_loaded_zones"), &World::get_loaded_zones);
+	ClassDB::bind_method(D_METHOD("get_neighbor_zone_update_interval"), &World::get_neighbor_zone_update_interval);
+	ClassDB::bind_method(D_METHOD("set_neighbor_zone_update_interval", "interval"), &World::set_neighbor_zone_update_interval);
+	ClassDB::bind_method(D_METHOD("get_rejected_message_count", "reason"), &World::get_rejected_message_count);
+	ClassDB::bind_method(D_METHOD("get_server_time"), &World::get_server_time);
+	ClassDB::bind_method(D_METHOD("get_rpc_sender_id"), &World::get_rpc_sender_id);
+	ClassDB::bind_method(D_METHOD("get_round_trip_time"), &World::get_round_trip_time);
+	ClassDB::bind_method(D_METHOD("get_clock_offset"), &World::get_clock_offset);
+	ClassDB::bind_method(D_METHOD("get_receive_batch_size"), &World::get_receive_batch_size);
+	ClassDB::bind_method(D_METHOD("set_receive_batch_size", "batch_size"), &World::set_receive_batch_size);
+
+	BIND_ENUM_CONSTANT(REJECTION_NONE);
+	BIND_ENUM_CONSTANT(REJECTION_MALFORMED);
+	BIND_ENUM_CONSTANT(REJECTION_UNKNOWN_TYPE);
+	BIND_ENUM_CONSTANT(REJECTION_UNKNOWN_PLAYER);
+	BIND_ENUM_CONSTANT(REJECTION_UNKNOWN_ZONE);
+	BIND_ENUM_CONSTANT(REJECTION_UNKNOWN_ENTITY);
+	BIND_ENUM_CONSTANT(REJECTION_UNAUTHORIZED);
 
 	ADD_SIGNAL(MethodInfo("joined_world"));
 	ADD_SIGNAL(MethodInfo("left_world"));
 	ADD_SIGNAL(MethodInfo("loaded_zone", PropertyInfo(Variant::OBJECT, "zone", PROPERTY_HINT_RESOURCE_TYPE, "Node")));
+	//The zone scene could not be streamed in on the client. The zone is left unloaded, so loading it can just be tried again.
+	ADD_SIGNAL(MethodInfo("zone_load_failed", PropertyInfo(Variant::OBJECT, "zone", PROPERTY_HINT_RESOURCE_TYPE, "Node")));
 
 	ADD_SIGNAL(MethodInfo("_client_side_transmit_entity_data"));
 	ADD_SIGNAL(MethodInfo("_server_side_transmit_entity_data"));
@@ -628,8 +1501,8 @@ bool World::CLIENT_SIDE_instantiate_zone(ZoneID_t zoneId) {
 		Zone* requestedZone = GDNet::singleton->m_zoneRegistry.get(zoneId).zone;
 		//Add local player to the zone (locally)
 		requestedZone->add_player(m_localPlayer);
-		//Load the zone
-		requestedZone->call_deferred("instantiate_callback");
+		//Stream the zone in without blocking the main thread
+		requestedZone->call_deferred("stream_callback");
 
 		return true;
 	} else {
@@ -670,6 +1543,9 @@ void World::start_world(int port) {
 		return;
 	}
 
+	//Apply recieved updates on the main thread every frame
+	connect_frame_hook();
+
 	//Start the main server loop
 	m_serverRunLoop = true;
 	//Start the server listen loop
@@ -705,10 +1581,284 @@ void World::stop_world() {
 	SteamNetworkingSockets()->DestroyPollGroup(m_hPollGroup);
 	m_hPollGroup = k_HSteamNetPollGroup_Invalid;
 
+	disconnect_frame_hook();
+	free_update_mailboxes();
+
+	//Let a snapshot that is still being written finish
+	if(m_snapshotWriterThread.joinable()){
+		m_snapshotWriterThread.join();
+	}
+	m_snapshot.close();
+	m_snapshotZoneRestored.clear();
+
 	//Indicate that the world is no longer acting as the server
 	GDNet::singleton->m_isServer = false;
 }
 
+//Call this on the main thread
+bool World::save_snapshot(String path) {
+	if(!GDNet::singleton->m_isServer){
+		ERR_PRINT("Only the server can save a world snapshot!");
+		return false;
+	}
+
+	//Copy the world state out on the main thread. Everything after this works on the copy.
+	WorldSnapshotBuilder builder;
+	for(const KeyValue<ZoneID_t, ZoneInfo_t> &zoneInfo : GDNet::singleton->m_zoneRegistry){
+		Zone *zone = zoneInfo.value.zone;
+		builder.begin_zone(zoneInfo.value.name);
+
+		if(zone->is_instantiated() || zone->is_hibernated()){
+			zone->SERVER_SIDE_capture_snapshot(builder);
+			continue;
+		}
+
+		//Zones that never got loaded since the server resumed still only exist in the old snapshot, carry them over
+		int snapshotZoneIdx = m_snapshot.is_open() ? m_snapshot.find_zone(zoneInfo.value.name) : -1;
+		if(snapshotZoneIdx >= 0 && !m_snapshotZoneRestored[snapshotZoneIdx]){
+			uint32_t entityCount = m_snapshot.get_zone_entity_count(snapshotZoneIdx);
+			for(uint32_t i = 0; i < entityCount; i++){
+				Ref<EntityInfo> entityInfo;
+				entityInfo.instantiate();
+				if(m_snapshot.read_entity(snapshotZoneIdx, i, entityInfo)){
+					builder.add_entity(entityInfo);
+				}
+			}
+		}
+	}
+	Vector<uint8_t> snapshotData = builder.finish();
+
+	//Write the file out on its own thread so neither the main thread or the tick thread wait on the disk.
+	//If the last snapshot is still being written, the writer takes this one next instead of the main thread waiting for it.
+	{
+		std::lock_guard<std::mutex> lock(m_snapshotWriteMutex);
+		m_pendingSnapshotPath = path;
+		m_pendingSnapshotData = snapshotData;
+		m_snapshotPending = true;
+		if(m_snapshotWriting){
+			return true;
+		}
+		m_snapshotWriting = true;
+	}
+
+	//The previous writer already ran out of snapshots, so this doesnt wait on the disk
+	if(m_snapshotWriterThread.joinable()){
+		m_snapshotWriterThread.join();
+	}
+	m_snapshotWriterThread = std::thread(&World::snapshot_writer_loop, this);
+
+	return true;
+}
+
+//Runs on the snapshot writer thread until there are no more snapshots waiting
+void World::snapshot_writer_loop() {
+	while(true){
+		String path;
+		Vector<uint8_t> snapshotData;
+		{
+			std::lock_guard<std::mutex> lock(m_snapshotWriteMutex);
+			if(!m_snapshotPending){
+				m_snapshotWriting = false;
+				return;
+			}
+			path = m_pendingSnapshotPath;
+			snapshotData = m_pendingSnapshotData;
+			m_pendingSnapshotData = Vector<uint8_t>();
+			m_snapshotPending = false;
+		}
+
+		WorldSnapshot::write_file(path, snapshotData);
+	}
+}
+
+//Call this before any zone gets loaded (for example right before start_world)
+bool World::load_snapshot(String path) {
+	//Only the header gets looked at here, zones are restored from the mapped file as they are loaded
+	if(!m_snapshot.open(path)){
+		return false;
+	}
+
+	m_snapshotZoneRestored.clear();
+	m_snapshotZoneRestored.resize(m_snapshot.get_zone_count());
+	for(uint32_t i = 0; i < m_snapshotZoneRestored.size(); i++){
+		m_snapshotZoneRestored[i] = false;
+	}
+
+	//Entities in zones that arent restored yet still own their network ids
+	IDGenerator::reserveNetworkIdentityIDs(m_snapshot.get_max_network_id());
+
+	print_line(vformat("Loaded world snapshot with %d zones.", m_snapshot.get_zone_count()));
+	return true;
+}
+
+//Call this on the main thread
+void World::SERVER_SIDE_restore_zone_from_snapshot(Zone *zone) {
+	if(!GDNet::singleton->m_isServer || !m_snapshot.is_open()){
+		return;
+	}
+
+	//Zones are matched by name, since zone ids depend on the order zones enter the tree
+	int snapshotZoneIdx = m_snapshot.find_zone(zone->get_name());
+	if(snapshotZoneIdx < 0 || m_snapshotZoneRestored[snapshotZoneIdx]){
+		return;
+	}
+	m_snapshotZoneRestored[snapshotZoneIdx] = true;
+
+	uint32_t entityCount = m_snapshot.get_zone_entity_count(snapshotZoneIdx);
+	for(uint32_t i = 0; i < entityCount; i++){
+		Ref<EntityInfo> entityInfo;
+		entityInfo.instantiate();
+		if(!m_snapshot.read_entity(snapshotZoneIdx, i, entityInfo)){
+			continue;
+		}
+
+		entityInfo->m_entityInfo.parentZone = zone->get_zone_id();
+
+		//Players dont survive a restart, so their entities go back to the server until someone takes them over.
+		//Player ids start over after a restart too, so a player with the same id now is someone else.
+		entityInfo->m_entityInfo.owner = 0;
+
+		zone->create_entity(entityInfo);
+	}
+
+	print_line(vformat("Restored %d entities into zone '%s' from the world snapshot.", entityCount, zone->get_name()));
+}
+
+//Call this on the main thread. Moves an entity into another zone without destroying it, so it keeps its
+//network id and node. Players in both zones just move it over, everyone else gets it created or removed.
+bool World::migrate_entity(Ref<EntityInfo> entityInfo, ZoneID_t targetZoneId, String parentRelativePath) {
+	if(!GDNet::singleton->m_isServer){
+		ERR_PRINT("Only the world host can move entities between zones!");
+		return false;
+	}
+
+	ERR_FAIL_COND_V(entityInfo.is_null(), false);
+
+	ZoneInfo_t *sourceZoneInfo = GDNet::singleton->m_zoneRegistry.getptr(entityInfo->m_entityInfo.parentZone);
+	ZoneInfo_t *targetZoneInfo = GDNet::singleton->m_zoneRegistry.getptr(targetZoneId);
+	if(!sourceZoneInfo || !targetZoneInfo){
+		ERR_PRINT(vformat("Cannot migrate entity to zone %d, the zone does not exist!", targetZoneId));
+		return false;
+	}
+	Zone *sourceZone = sourceZoneInfo->zone;
+	Zone *targetZone = targetZoneInfo->zone;
+
+	if(sourceZone == targetZone){
+		return true;
+	}
+
+	if(!targetZone->is_instantiated()){
+		ERR_PRINT(vformat("Cannot migrate entity to zone %d, the zone has not been instantiated!", targetZoneId));
+		return false;
+	}
+
+	//The owner has to be able to keep sending updates for the entity
+	PlayerID_t ownerId = entityInfo->get_owner_id();
+	if(ownerId != 0 && !targetZone->player_in_zone(ownerId)){
+		ERR_PRINT(vformat("Cannot migrate entity to zone %d, its owner (player %d) is not loaded into it!", targetZoneId, ownerId));
+		return false;
+	}
+
+	ZoneID_t sourceZoneId = sourceZone->get_zone_id();
+	String previousPath = entityInfo->get_parent_relative_path();
+	entityInfo->set_parent_relative_path(parentRelativePath);
+	if(!sourceZone->migrate_entity(entityInfo, targetZone)){
+		entityInfo->set_parent_relative_path(previousPath);
+		return false;
+	}
+
+	//Network id, both zone ids and the new parent path
+	Vector<unsigned char> mssgBuffer;
+	mssgBuffer.resize(1 + (3 * 5) + 5 + (entityInfo->get_parent_relative_path().length() * 4));
+	MessageWriter writer(mssgBuffer.ptrw(), mssgBuffer.size());
+	writer.write<unsigned char>(ENTITY_MIGRATED);
+	writer.write_varint(entityInfo->get_network_id());
+	writer.write_varint(sourceZoneId);
+	writer.write_varint(targetZoneId);
+	writer.write_string(entityInfo->get_parent_relative_path());
+
+	//Everyone who had the entity gets told it moved. Clients that arent loaded into the target zone drop it.
+	for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : sourceZone->m_playersInZone){
+		SteamNetworkingMessage_t *migrationMssg = allocate_message(mssgBuffer.ptr(), writer.get_size(), player.value->get_player_conn());
+		send_message_reliable(migrationMssg, LANE_GAMEPLAY);
+	}
+
+	//Players only loaded into the target zone never had the entity, so it has to be created for them
+	for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : targetZone->m_playersInZone){
+		if(!sourceZone->player_in_zone(player.key)){
+			player.value->load_entity(entityInfo);
+		}
+	}
+
+	return true;
+}
+
+//Call this on the main thread. Hands an entity over to another player in its zone, or back to the server (player id 0).
+//The entity's authority epoch goes up with every handoff, which fences off the updates the previous owner still has in flight.
+bool World::transfer_ownership(Ref<EntityInfo> entityInfo, PlayerID_t newOwner) {
+	if(!GDNet::singleton->m_isServer){
+		ERR_PRINT("Only the world host can transfer ownership of entities!");
+		return false;
+	}
+
+	ERR_FAIL_COND_V(entityInfo.is_null(), false);
+
+	ZoneInfo_t *zoneInfo = GDNet::singleton->m_zoneRegistry.getptr(entityInfo->m_entityInfo.parentZone);
+	if(!zoneInfo || zoneInfo->zone->get_entity(entityInfo->get_network_id()).is_null()){
+		ERR_PRINT("Cannot transfer ownership of an entity that is not in a zone!");
+		return false;
+	}
+	Zone *zone = zoneInfo->zone;
+
+	//The new owner has to have the entity loaded to be able to send updates for it
+	if(newOwner != 0 && !zone->player_in_zone(newOwner)){
+		ERR_PRINT(vformat("Cannot transfer ownership to player %d, they are not loaded into the entity's zone!", newOwner));
+		return false;
+	}
+
+	if(entityInfo->get_owner_id() == newOwner){
+		return true;
+	}
+
+	uint8_t authorityEpoch = entityInfo->m_entityInfo.authorityEpoch + 1;
+	zone->set_entity_owner(entityInfo, newOwner, authorityEpoch);
+
+	//Network id, zone id, new owner and the new epoch
+	unsigned char mssgData[1 + (3 * 5) + 1];
+	MessageWriter writer(mssgData, sizeof(mssgData));
+	writer.write<unsigned char>(ENTITY_OWNERSHIP_TRANSFERRED);
+	writer.write_varint(entityInfo->get_network_id());
+	writer.write_varint(zone->get_zone_id());
+	writer.write_varint(newOwner);
+	writer.write<uint8_t>(authorityEpoch);
+
+	//Sent down the same lane as entity creations and migrations, so clients always get the transfer after the entity
+	//was created and while it is still in the zone the transfer names
+	for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : zone->m_playersInZone){
+		SteamNetworkingMessage_t *transferMssg = allocate_message(mssgData, writer.get_size(), player.value->get_player_conn());
+		send_message_reliable(transferMssg, LANE_GAMEPLAY);
+	}
+
+	return true;
+}
+
+uint64_t World::SERVER_SIDE_get_tick() const {
+	return m_serverTick.load(std::memory_order_relaxed);
+}
+
+uint64_t World::get_inbound_sequence() const {
+	return m_inboundSequence.load(std::memory_order_relaxed);
+}
+
+int World::get_neighbor_zone_update_interval() const {
+	return m_neighborZoneUpdateInterval;
+}
+
+void World::set_neighbor_zone_update_interval(int interval) {
+	ERR_FAIL_COND_MSG(interval < 1, "The neighbor zone update interval has to be at least 1!");
+	m_neighborZoneUpdateInterval = interval;
+}
+
 PlayerID_t World::get_player_id() {
 	return m_localPlayer->get_player_id();
 }
@@ -736,6 +1886,9 @@ void World::join_world(String world, int port) {
 	//Create local player info object to store info in
 	m_localPlayer = Ref<PlayerInfo>(memnew(PlayerInfo));
 
+	//Apply recieved updates on the main thread every frame
+	connect_frame_hook();
+
 	//Enable client run loops
 	m_clientRunLoop = true;
 	//Start the client listen loop
@@ -755,9 +1908,12 @@ void World::leave_world() {
 		return;
 	}
 
-	//Check for a zone to unload, and unload it if there is one
-	Zone* loadedZone = m_localPlayer->get_current_loaded_zone();
-	if(loadedZone){
+	//Unload every zone the player is loaded into (collected first, removing the player unsubscribes them)
+	LocalVector<Zone *> loadedZones;
+	for(const KeyValue<ZoneID_t, ZoneSubscription_t> &loadedZone : m_localPlayer->m_playerInfo.loadedZones){
+		loadedZones.push_back(loadedZone.value.zone);
+	}
+	for(Zone *loadedZone : loadedZones){
 		//Remove the player from the zone locally
 		loadedZone->remove_player(m_localPlayer);
 
@@ -781,12 +1937,23 @@ void World::leave_world() {
 	SteamNetworkingSockets()->CloseConnection(m_worldConnection, 0, nullptr, false);
 	m_worldConnection = k_HSteamNetConnection_Invalid;
 
+	disconnect_frame_hook();
+	free_update_mailboxes();
+
 	GDNet::singleton->m_isClient = false;
 
 	//Inform signal connections that client has left the world
 	emit_signal("left_world");
 }
 
+int World::get_receive_batch_size() const {
+	return m_receiveBatchSize.load(std::memory_order_relaxed);
+}
+
+void World::set_receive_batch_size(int batchSize) {
+	m_receiveBatchSize.store(CLAMP(batchSize, 1, MAX_RECEIVE_BATCH_SIZE), std::memory_order_relaxed);
+}
+
 bool World::load_zone_by_name(String zoneName) {
 	if (GDNet::singleton->m_isServer) {
 		print_line("Cannot request to load zone as the world host!");
@@ -800,12 +1967,21 @@ bool World::load_zone_by_name(String zoneName) {
 			print_line("Zone Found! sending load zone request.");
 			ZoneID_t zoneId = element.value.id;
 
+			//Loading a zone the player is already loaded into would resync everything in it for nothing
+			if(m_localPlayer.is_valid() && m_localPlayer->is_zone_loaded(zoneId)){
+				ERR_PRINT(vformat("Zone with ID %d is already loaded!", zoneId));
+				return false;
+			}
+
 			//Make sure the zone has a scene to load
-			if(!element.value.zone->get_zone_scene().is_valid()){
+			if(!element.value.zone->has_zone_scene()){
 				ERR_PRINT(vformat("Zone with ID %d was not given a scene to create!", zoneId));
 				return false;
 			}
 
+			//Start loading the scene while the request makes its way to the server and back
+			element.value.zone->preload_zone_scene();
+
 			SteamNetworkingMessage_t *pLoadZoneRequest = create_mini_message(LOAD_ZONE_REQUEST, zoneId, m_worldConnection);
 			send_message_reliable(pLoadZoneRequest);
 			return true;
@@ -825,12 +2001,22 @@ bool World::load_zone_by_id(ZoneID_t zoneId) {
 	if (GDNet::singleton->m_zoneRegistry.has(zoneId)) {
 		print_line("Zone Found! sending load zone request.");
 
+		//Loading a zone the player is already loaded into would resync everything in it for nothing
+		if(m_localPlayer.is_valid() && m_localPlayer->is_zone_loaded(zoneId)){
+			ERR_PRINT(vformat("Zone with ID %d is already loaded!", zoneId));
+			return false;
+		}
+
 		//Make sure the zone has a scene to load
-		if(!GDNet::singleton->m_zoneRegistry.get(zoneId).zone->get_zone_scene().is_valid()){
+		Zone *requestedZone = GDNet::singleton->m_zoneRegistry.get(zoneId).zone;
+		if(!requestedZone->has_zone_scene()){
 			ERR_PRINT(vformat("Zone with ID %d was not given a scene to create!", zoneId));
 			return false;
 		}
 
+		//Start loading the scene while the request makes its way to the server and back
+		requestedZone->preload_zone_scene();
+
 		SteamNetworkingMessage_t *pLoadZoneRequest = create_mini_message(LOAD_ZONE_REQUEST, zoneId, m_worldConnection);
 		send_message_reliable(pLoadZoneRequest);
 		return true;
@@ -840,7 +2026,17 @@ bool World::load_zone_by_id(ZoneID_t zoneId) {
 	}
 }
 
+//Unloads the zone the player is in
 void World::unload_zone() {
+	if(!m_localPlayer.is_valid() || !m_localPlayer->get_current_loaded_zone()){
+		ERR_PRINT("No zone loaded!");
+		return;
+	}
+
+	unload_zone_by_id(m_localPlayer->get_current_loaded_zone()->get_zone_id());
+}
+
+void World::unload_zone_by_id(ZoneID_t zoneId) {
 	if(GDNet::singleton->m_isServer){
 		ERR_PRINT("Server cant unload zones for now.");
 		return;
@@ -852,16 +2048,17 @@ void World::unload_zone() {
 	}
 
 	//Get the zone to unload
-	Zone* loadedZone = m_localPlayer->get_current_loaded_zone();
+	ZoneSubscription_t *subscription = m_localPlayer->get_zone_subscription(zoneId);
 	//Make sure zone was even loaded
-	if(!loadedZone){
-		ERR_PRINT("No zone loaded!");
+	if(!subscription){
+		ERR_PRINT(vformat("Zone with ID %d is not loaded!", zoneId));
 		return;
 	}
+	Zone* loadedZone = subscription->zone;
 
-	//Tell the server that the player has unloaded the zone
-	SteamNetworkingMessage_t* playerLeftMssg = create_small_message(PLAYER_LEFT_ZONE, m_localPlayer->get_player_id(), loadedZone->get_zone_id(), m_worldConnection);
-	send_message_reliable(playerLeftMssg);
+	//Tell the server that the player has unloaded the zone (after any entity creation requests for it)
+	SteamNetworkingMessage_t* playerLeftMssg = create_small_message(PLAYER_LEFT_ZONE, m_localPlayer->get_player_id(), zoneId, m_worldConnection);
+	send_message_reliable(playerLeftMssg, LANE_GAMEPLAY);
 
 	loadedZone->remove_player(m_localPlayer);
 
@@ -869,6 +2066,152 @@ void World::unload_zone() {
 	loadedZone->uninstantiate_zone();
 }
 
+//Moves the player into another zone they are already loaded into. Everything in it is already synced,
+//so all this does is make the zone the one that gets full rate updates.
+bool World::set_active_zone(ZoneID_t zoneId) {
+	if(!GDNet::singleton->m_isClient){
+		ERR_PRINT("Client must be running!");
+		return false;
+	}
+
+	ZoneSubscription_t *subscription = m_localPlayer->get_zone_subscription(zoneId);
+	if(!subscription){
+		ERR_PRINT(vformat("Zone with ID %d is not loaded, load it before moving into it!", zoneId));
+		return false;
+	}
+
+	m_localPlayer->set_current_loaded_zone(subscription->zone);
+
+	SteamNetworkingMessage_t *activeZoneMssg = create_mini_message(SET_ACTIVE_ZONE, zoneId, m_worldConnection);
+	send_message_reliable(activeZoneMssg);
+	return true;
+}
+
+Zone *World::get_active_zone() {
+	return m_localPlayer.is_valid() ? m_localPlayer->get_current_loaded_zone() : nullptr;
+}
+
+Array World::get_loaded_zones() {
+	Array loadedZones;
+	if(m_localPlayer.is_valid()){
+		for(const KeyValue<ZoneID_t, ZoneSubscription_t> &loadedZone : m_localPlayer->m_playerInfo.loadedZones){
+			loadedZones.push_back(loadedZone.value.zone);
+		}
+	}
+	return loadedZones;
+}
+
+void World::queue_entity_update(HSteamNetConnection destination, const EntityUpdateInfo_t &updateInfo) {
+	StateFrameBuilder **stateFramePtr = m_stateFrames.getptr(destination);
+	StateFrameBuilder *stateFrame = stateFramePtr ? *stateFramePtr : nullptr;
+
+	//Create a builder for the destination the first time it gets an update
+	if(!stateFrame){
+		stateFrame = memnew(StateFrameBuilder);
+		stateFrame->set_destination(destination);
+		m_stateFrames.insert(destination, stateFrame);
+	}
+
+	stateFrame->queue_update(updateInfo);
+}
+
+void World::queue_zone_broadcast(const EntityUpdateInfo_t &updateInfo, bool includeNeighbors) {
+	uint64_t broadcastKey = (static_cast<uint64_t>(updateInfo.parentZone) << 1) | (includeNeighbors ? 1U : 0U);
+	StateFrameBuilder **broadcastFramePtr = m_broadcastFrames.getptr(broadcastKey);
+	StateFrameBuilder *broadcastFrame = broadcastFramePtr ? *broadcastFramePtr : nullptr;
+
+	//Create a builder for the zone the first time something gets broadcast in it
+	if(!broadcastFrame){
+		broadcastFrame = memnew(StateFrameBuilder);
+		m_broadcastFrames.insert(broadcastKey, broadcastFrame);
+	}
+
+	broadcastFrame->queue_update(updateInfo);
+}
+
+//Call this on the main thread. Entity calls target the entity's zone, zone calls pass a null entity.
+Error World::send_rpc(RpcTarget target, Zone *zone, NetworkEntity *entity, const StringName &method, const Variant **args, int argCount) {
+	ERR_FAIL_COND_V_MSG(entity && entity->m_info.is_null(), ERR_UNCONFIGURED, "Rpcs cannot be sent from an entity that hasnt been spawned!");
+	if(entity){
+		zone = entity->m_parentZone;
+	}
+	ERR_FAIL_NULL_V(zone, ERR_UNCONFIGURED);
+
+	uint32_t methodId;
+	bool reliable;
+	const RpcTable &rpcTable = entity ? entity->get_rpc_table() : zone->get_rpc_table();
+	ERR_FAIL_COND_V_MSG(!rpcTable.find_method(method, methodId, reliable), ERR_DOES_NOT_EXIST, vformat("\"%s\" was not registered as an rpc!", method));
+
+	uint8_t flags = entity ? RPC_FLAG_ENTITY : 0;
+	EntityNetworkID_t networkId = entity ? entity->m_info->get_network_id() : 0U;
+
+	switch(target){
+		case RPC_TARGET_SERVER:{
+			ERR_FAIL_COND_V_MSG(!GDNet::singleton->m_isClient || m_worldConnection == k_HSteamNetConnection_Invalid, ERR_UNCONFIGURED, "rpc_server can only be called while connected to a world!");
+			//The server would reject it anyway
+			ERR_FAIL_COND_V_MSG(entity && !entity->has_ownership(), ERR_UNAUTHORIZED, "Only the owner of an entity can call rpcs on the server through it!");
+
+			int entrySize = encode_rpc(flags, zone->get_zone_id(), networkId, methodId, args, argCount);
+			ERR_FAIL_COND_V(entrySize == 0, ERR_INVALID_PARAMETER);
+			queue_rpc(m_worldConnection, entrySize, reliable);
+			break;
+		}
+		case RPC_TARGET_OWNER:{
+			ERR_FAIL_COND_V_MSG(!GDNet::singleton->m_isServer || !entity, ERR_UNCONFIGURED, "rpc_owner can only be called on the server, through an entity!");
+
+			//Server owned entities (and owners that left the zone) have nobody to send to
+			PlayerID_t ownerId = entity->m_info->get_owner_id();
+			Ref<PlayerInfo> owner = ownerId != 0 ? zone->get_player(ownerId) : Ref<PlayerInfo>();
+			if(owner.is_null()){
+				return ERR_UNAVAILABLE;
+			}
+
+			int entrySize = encode_rpc(flags, zone->get_zone_id(), networkId, methodId, args, argCount);
+			ERR_FAIL_COND_V(entrySize == 0, ERR_INVALID_PARAMETER);
+			queue_rpc(owner->get_player_conn(), entrySize, reliable);
+			break;
+		}
+		case RPC_TARGET_ZONE:{
+			ERR_FAIL_COND_V_MSG(!GDNet::singleton->m_isServer, ERR_UNCONFIGURED, "rpc_zone can only be called on the server!");
+
+			//Encoded once, then copied into the batch of every player in the zone
+			int entrySize = encode_rpc(flags, zone->get_zone_id(), networkId, methodId, args, argCount);
+			ERR_FAIL_COND_V(entrySize == 0, ERR_INVALID_PARAMETER);
+			for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : zone->m_playersInZone){
+				queue_rpc(player.value->get_player_conn(), entrySize, reliable);
+			}
+			break;
+		}
+	}
+
+	return OK;
+}
+
+//Player that made the rpc call currently being handled (0 for calls from the server)
+PlayerID_t World::get_rpc_sender_id() const {
+	return m_rpcSender;
+}
+
+uint64_t World::get_rejected_message_count(MessageRejection reason) const {
+	ERR_FAIL_INDEX_V(reason, REJECTION_COUNT, 0);
+	return m_rejectedMessages[reason].load(std::memory_order_relaxed);
+}
+
+//Current time on the server clock (in seconds). Clients get it from their clock estimate, so it is the same everywhere within a few milliseconds.
+double World::get_server_time() const {
+	return (SteamNetworkingUtils()->GetLocalTimestamp() + (m_localPlayer.is_valid() ? m_localPlayer->m_clock.get_offset() : 0)) / 1000000.0;
+}
+
+//Round trip time to the server (in seconds). Always 0 on the server, use PlayerInfo.get_round_trip_time() per player there.
+double World::get_round_trip_time() const {
+	return m_localPlayer.is_valid() ? m_localPlayer->get_round_trip_time() : 0.0;
+}
+
+//How far the server clock is ahead of the local one (in seconds)
+double World::get_clock_offset() const {
+	return m_localPlayer.is_valid() ? m_localPlayer->get_clock_offset() : 0.0;
+}
+
 bool World::player_exists(PlayerID_t playerId) {
 	if(!GDNet::singleton->m_isClient && !GDNet::singleton->m_isServer){
 		ERR_PRINT("Cannot lookup players since there is no world running and there is no connection to a world.");
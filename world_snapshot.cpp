@@ -0,0 +1,365 @@
+#include "gdnet.h"
+#include "core/config/project_settings.h"
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+
+#ifdef WINDOWS_ENABLED
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(WorldSnapshotHeader_t) == 24, "Snapshot header must not have padding!");
+static_assert(sizeof(WorldSnapshotZone_t) == 16, "Snapshot zone records must not have padding!");
+static_assert(sizeof(WorldSnapshotEntity_t) == 44, "Snapshot entity records must not have padding!");
+
+//Records are stored as is, so only the byte order of their fields has to be fixed up
+static WorldSnapshotHeader_t header_byte_order(WorldSnapshotHeader_t header) {
+	header.magic = codec_byte_order(header.magic);
+	header.version = codec_byte_order(header.version);
+	header.zoneCount = codec_byte_order(header.zoneCount);
+	header.entityCount = codec_byte_order(header.entityCount);
+	header.stringTableSize = codec_byte_order(header.stringTableSize);
+	header.maxNetworkId = codec_byte_order(header.maxNetworkId);
+	return header;
+}
+
+static WorldSnapshotZone_t zone_byte_order(WorldSnapshotZone_t zone) {
+	zone.nameOffset = codec_byte_order(zone.nameOffset);
+	zone.nameLength = codec_byte_order(zone.nameLength);
+	zone.firstEntity = codec_byte_order(zone.firstEntity);
+	zone.entityCount = codec_byte_order(zone.entityCount);
+	return zone;
+}
+
+static WorldSnapshotEntity_t entity_byte_order(WorldSnapshotEntity_t entity) {
+	entity.nameOffset = codec_byte_order(entity.nameOffset);
+	entity.nameLength = codec_byte_order(entity.nameLength);
+	entity.networkId = codec_byte_order(entity.networkId);
+	entity.owner = codec_byte_order(entity.owner);
+	entity.pathOffset = codec_byte_order(entity.pathOffset);
+	entity.pathLength = codec_byte_order(entity.pathLength);
+	for (int i = 0; i < 3; i++) {
+		entity.position3D[i] = codec_byte_order(entity.position3D[i]);
+	}
+	for (int i = 0; i < 2; i++) {
+		entity.position2D[i] = codec_byte_order(entity.position2D[i]);
+	}
+	return entity;
+}
+
+//===============World Snapshot Builder===============//
+
+WorldSnapshotBuilder::WorldSnapshotBuilder() {
+	m_maxNetworkId = 0;
+}
+
+uint32_t WorldSnapshotBuilder::add_string(const String &value, uint32_t &length) {
+	CharString utf8 = value.utf8();
+	uint32_t offset = m_strings.size();
+	length = utf8.length();
+
+	m_strings.resize(offset + length);
+	memcpy(m_strings.ptr() + offset, utf8.get_data(), length);
+	return offset;
+}
+
+void WorldSnapshotBuilder::begin_zone(const String &zoneName) {
+	WorldSnapshotZone_t zone{};
+	zone.nameOffset = add_string(zoneName, zone.nameLength);
+	zone.firstEntity = m_entities.size();
+	zone.entityCount = 0;
+	m_zones.push_back(zone);
+}
+
+void WorldSnapshotBuilder::add_entity(const Ref<EntityInfo> &entityInfo) {
+	ERR_FAIL_COND_MSG(m_zones.is_empty(), "Snapshot entities have to be added after their zone!");
+
+	const EntityInfo_t &info = entityInfo->m_entityInfo;
+	WorldSnapshotEntity_t entity{};
+	entity.nameOffset = add_string(info.entityName, entity.nameLength);
+	entity.networkId = info.networkId;
+	entity.owner = info.owner;
+	entity.pathOffset = add_string(info.parentRelativePath, entity.pathLength);
+	entity.position3D[0] = info.initialPosition3D.x;
+	entity.position3D[1] = info.initialPosition3D.y;
+	entity.position3D[2] = info.initialPosition3D.z;
+	entity.position2D[0] = info.initialPosition2D.x;
+	entity.position2D[1] = info.initialPosition2D.y;
+
+	m_entities.push_back(entity);
+	m_zones[m_zones.size() - 1].entityCount++;
+	m_maxNetworkId = MAX(m_maxNetworkId, info.networkId);
+}
+
+Vector<uint8_t> WorldSnapshotBuilder::finish() {
+	WorldSnapshotHeader_t header{};
+	header.magic = WORLD_SNAPSHOT_MAGIC;
+	header.version = WORLD_SNAPSHOT_VERSION;
+	header.zoneCount = m_zones.size();
+	header.entityCount = m_entities.size();
+	header.stringTableSize = m_strings.size();
+	header.maxNetworkId = m_maxNetworkId;
+
+	Vector<uint8_t> snapshotData;
+	snapshotData.resize(sizeof(WorldSnapshotHeader_t) + m_zones.size() * sizeof(WorldSnapshotZone_t) + m_entities.size() * sizeof(WorldSnapshotEntity_t) + m_strings.size());
+	uint8_t *dest = snapshotData.ptrw();
+
+	header = header_byte_order(header);
+	memcpy(dest, &header, sizeof(WorldSnapshotHeader_t));
+	dest += sizeof(WorldSnapshotHeader_t);
+
+	for (const WorldSnapshotZone_t &zone : m_zones) {
+		WorldSnapshotZone_t stored = zone_byte_order(zone);
+		memcpy(dest, &stored, sizeof(WorldSnapshotZone_t));
+		dest += sizeof(WorldSnapshotZone_t);
+	}
+
+	for (const WorldSnapshotEntity_t &entity : m_entities) {
+		WorldSnapshotEntity_t stored = entity_byte_order(entity);
+		memcpy(dest, &stored, sizeof(WorldSnapshotEntity_t));
+		dest += sizeof(WorldSnapshotEntity_t);
+	}
+
+	if (m_strings.size() > 0) {
+		memcpy(dest, m_strings.ptr(), m_strings.size());
+	}
+
+	return snapshotData;
+}
+
+//===============World Snapshot===============//
+
+WorldSnapshot::WorldSnapshot() {
+	m_data = nullptr;
+	m_size = 0;
+	m_header = {};
+#ifdef WINDOWS_ENABLED
+	m_fileHandle = nullptr;
+	m_mappingHandle = nullptr;
+#endif
+}
+
+WorldSnapshot::~WorldSnapshot() {
+	close();
+}
+
+bool WorldSnapshot::open(const String &path) {
+	close();
+
+	String globalPath = ProjectSettings::get_singleton()->globalize_path(path);
+
+	//Map the whole file read only. Pages only get loaded in as the records in them are actually read.
+#ifdef WINDOWS_ENABLED
+	HANDLE fileHandle = CreateFileW((LPCWSTR)globalPath.utf16().get_data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		ERR_PRINT(vformat("Could not open world snapshot '%s'!", path));
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(fileHandle);
+		ERR_PRINT(vformat("World snapshot '%s' is empty!", path));
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle) {
+		CloseHandle(fileHandle);
+		ERR_PRINT(vformat("Could not map world snapshot '%s'!", path));
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data) {
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		ERR_PRINT(vformat("Could not map world snapshot '%s'!", path));
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_mappingHandle = mappingHandle;
+	m_size = fileSize.QuadPart;
+#else
+	int fileDescriptor = ::open(globalPath.utf8().get_data(), O_RDONLY);
+	if (fileDescriptor < 0) {
+		ERR_PRINT(vformat("Could not open world snapshot '%s'!", path));
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(fileDescriptor);
+		ERR_PRINT(vformat("World snapshot '%s' is empty!", path));
+		return false;
+	}
+
+	void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	//The mapping keeps the file alive on its own
+	::close(fileDescriptor);
+	if (mapping == MAP_FAILED) {
+		ERR_PRINT(vformat("Could not map world snapshot '%s'!", path));
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t *>(mapping);
+	m_size = fileStat.st_size;
+#endif
+
+	//Only the header is checked up front, every other record is bounds checked when it is read
+	if (m_size < sizeof(WorldSnapshotHeader_t)) {
+		close();
+		ERR_PRINT(vformat("World snapshot '%s' is too small to be a snapshot!", path));
+		return false;
+	}
+
+	memcpy(&m_header, m_data, sizeof(WorldSnapshotHeader_t));
+	m_header = header_byte_order(m_header);
+
+	if (m_header.magic != WORLD_SNAPSHOT_MAGIC || m_header.version != WORLD_SNAPSHOT_VERSION) {
+		close();
+		ERR_PRINT(vformat("'%s' is not a version %d world snapshot!", path, WORLD_SNAPSHOT_VERSION));
+		return false;
+	}
+
+	uint64_t expectedSize = sizeof(WorldSnapshotHeader_t) + static_cast<uint64_t>(m_header.zoneCount) * sizeof(WorldSnapshotZone_t) + static_cast<uint64_t>(m_header.entityCount) * sizeof(WorldSnapshotEntity_t) + m_header.stringTableSize;
+	if (m_size < expectedSize) {
+		close();
+		ERR_PRINT(vformat("World snapshot '%s' is truncated!", path));
+		return false;
+	}
+
+	return true;
+}
+
+void WorldSnapshot::close() {
+	if (!m_data) {
+		return;
+	}
+
+#ifdef WINDOWS_ENABLED
+	UnmapViewOfFile(m_data);
+	CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+	CloseHandle(static_cast<HANDLE>(m_fileHandle));
+	m_fileHandle = nullptr;
+	m_mappingHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_header = {};
+}
+
+bool WorldSnapshot::is_open() const {
+	return m_data != nullptr;
+}
+
+uint32_t WorldSnapshot::get_zone_count() const {
+	return m_header.zoneCount;
+}
+
+uint32_t WorldSnapshot::get_max_network_id() const {
+	return m_header.maxNetworkId;
+}
+
+bool WorldSnapshot::read_zone(uint32_t zoneIdx, WorldSnapshotZone_t &zone) const {
+	if (!m_data || zoneIdx >= m_header.zoneCount) {
+		return false;
+	}
+
+	memcpy(&zone, m_data + sizeof(WorldSnapshotHeader_t) + zoneIdx * sizeof(WorldSnapshotZone_t), sizeof(WorldSnapshotZone_t));
+	zone = zone_byte_order(zone);
+
+	//Make sure the zone only covers records that are actually in the file
+	return static_cast<uint64_t>(zone.firstEntity) + zone.entityCount <= m_header.entityCount;
+}
+
+String WorldSnapshot::read_string(uint32_t offset, uint32_t length) const {
+	if (static_cast<uint64_t>(offset) + length > m_header.stringTableSize) {
+		return String();
+	}
+
+	const uint8_t *stringTable = m_data + sizeof(WorldSnapshotHeader_t) + m_header.zoneCount * sizeof(WorldSnapshotZone_t) + static_cast<uint64_t>(m_header.entityCount) * sizeof(WorldSnapshotEntity_t);
+
+	String value;
+	value.parse_utf8(reinterpret_cast<const char *>(stringTable + offset), length);
+	return value;
+}
+
+int WorldSnapshot::find_zone(const String &zoneName) const {
+	WorldSnapshotZone_t zone;
+	for (uint32_t i = 0; i < m_header.zoneCount; i++) {
+		if (read_zone(i, zone) && read_string(zone.nameOffset, zone.nameLength) == zoneName) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+uint32_t WorldSnapshot::get_zone_entity_count(uint32_t zoneIdx) const {
+	WorldSnapshotZone_t zone;
+	return read_zone(zoneIdx, zone) ? zone.entityCount : 0;
+}
+
+bool WorldSnapshot::read_entity(uint32_t zoneIdx, uint32_t entityIdx, Ref<EntityInfo> &entityInfo) const {
+	WorldSnapshotZone_t zone;
+	if (!read_zone(zoneIdx, zone) || entityIdx >= zone.entityCount) {
+		return false;
+	}
+
+	WorldSnapshotEntity_t entity;
+	uint64_t entityOffset = sizeof(WorldSnapshotHeader_t) + m_header.zoneCount * sizeof(WorldSnapshotZone_t) + static_cast<uint64_t>(zone.firstEntity + entityIdx) * sizeof(WorldSnapshotEntity_t);
+	memcpy(&entity, m_data + entityOffset, sizeof(WorldSnapshotEntity_t));
+	entity = entity_byte_order(entity);
+
+	//The entity type has to still be registered for the entity to be brought back. It is looked up by name since
+	//the id it had when the snapshot was taken may belong to something else now.
+	String entityName = read_string(entity.nameOffset, entity.nameLength);
+	EntityID_t entityId = GDNet::singleton->get_entity_id_by_name(entityName);
+	if (!GDNet::singleton->m_networkEntityRegistry.has(entityId)) {
+		WARN_PRINT(vformat("World snapshot has an entity of type '%s' which is not registered anymore, skipping it.", entityName));
+		return false;
+	}
+
+	EntityInfo_t &info = entityInfo->m_entityInfo;
+	info.entityId = entityId;
+	info.entityName = entityName;
+	info.networkId = entity.networkId;
+	info.owner = entity.owner;
+	info.parentRelativePath = read_string(entity.pathOffset, entity.pathLength);
+	info.initialPosition3D = Vector3(entity.position3D[0], entity.position3D[1], entity.position3D[2]);
+	info.initialPosition2D = Vector2(entity.position2D[0], entity.position2D[1]);
+
+	return true;
+}
+
+//Safe to call from any thread
+bool WorldSnapshot::write_file(const String &path, const Vector<uint8_t> &snapshotData) {
+	//Write next to the old snapshot first so a crash mid write never leaves a half written snapshot behind
+	String tempPath = path + ".tmp";
+
+	{
+		Ref<FileAccess> file = FileAccess::open(tempPath, FileAccess::WRITE);
+		if (file.is_null()) {
+			ERR_PRINT(vformat("Could not write world snapshot to '%s'!", tempPath));
+			return false;
+		}
+		file->store_buffer(snapshotData.ptr(), snapshotData.size());
+	}
+
+	Ref<DirAccess> dir = DirAccess::create_for_path(path);
+	if (dir->rename(tempPath, path) != OK) {
+		ERR_PRINT(vformat("Could not move world snapshot into '%s'!", path));
+		return false;
+	}
+
+	return true;
+}
@@ -1,30 +1,581 @@
 #include "gdnet.h"
+#include "core/config/engine.h"
+#include "core/io/resource_loader.h"
+#include "core/os/os.h"
+#include "scene/resources/box_shape_3d.h"
+#include "scene/resources/circle_shape_2d.h"
+#include "scene/resources/rectangle_shape_2d.h"
+#include "scene/resources/sphere_shape_3d.h"
 
 //===============Zone Implementation===============//
 Zone::Zone() {
 	m_zoneId = 0U;
 	m_instantiated = false;
 	m_zoneInstance = nullptr;
+	m_streamState = STREAM_IDLE;
+	m_sceneLoadRequested = false;
+	m_zoneSceneFromPath = false;
+	m_streamedInstance = nullptr;
+	m_instantiateTask = WorkerThreadPool::INVALID_TASK_ID;
+	m_spawnBacklogIdx = 0;
+	m_despawnBacklogIdx = 0;
+	m_spawnBudgetUsec = DEFAULT_SPAWN_BUDGET_USEC;
+	m_serverLogic = false;
+	m_headless = false;
+	m_hibernationDelay = 0.0f;
+	m_idleTime = 0.0f;
+	m_hibernated = false;
+	m_rewindHistoryDuration = DEFAULT_REWIND_HISTORY_DURATION;
+	m_rewindHead = 0;
+	m_rewindFrameCount = 0;
 }
 
 Zone::~Zone() {}
 
+//==Private Methods==//
+
+//Runs on a worker thread. Nodes can be built off the main thread as long as they are not in the tree yet.
+void Zone::instantiate_streamed_scene(void *zone) {
+	Zone *streamingZone = static_cast<Zone *>(zone);
+	streamingZone->m_streamedInstance = streamingZone->m_streamedScene->instantiate();
+}
+
+//Scenes given by path only get loaded once they are needed (blocks, used where streaming isnt)
+Ref<PackedScene> Zone::resolve_zone_scene() {
+	if(m_zoneScene.is_null() && !m_zoneScenePath.is_empty()){
+		if(m_sceneLoadRequested){
+			m_zoneScene = ResourceLoader::load_threaded_get(m_zoneScenePath);
+			m_sceneLoadRequested = false;
+		}else{
+			m_zoneScene = ResourceLoader::load(m_zoneScenePath);
+		}
+		m_zoneSceneFromPath = true;
+	}
+
+	return m_zoneScene;
+}
+
+//Call this on the main thread (polled every frame while streaming)
+void Zone::process_streaming() {
+	switch(m_streamState){
+		case STREAM_LOADING: {
+			//Wait for the background load to finish
+			ResourceLoader::ThreadLoadStatus loadStatus = ResourceLoader::load_threaded_get_status(m_zoneScenePath);
+			if(loadStatus == ResourceLoader::THREAD_LOAD_IN_PROGRESS){
+				return;
+			}
+
+			m_zoneScene = ResourceLoader::load_threaded_get(m_zoneScenePath);
+			m_zoneSceneFromPath = true;
+			m_sceneLoadRequested = false;
+			if(loadStatus != ResourceLoader::THREAD_LOAD_LOADED || m_zoneScene.is_null()){
+				ERR_PRINT(vformat("Could not load the scene for zone with ID %d!", m_zoneId));
+				fail_streaming();
+				return;
+			}
+
+			//Build the node tree on a worker thread
+			m_streamedScene = m_zoneScene;
+			m_instantiateTask = WorkerThreadPool::get_singleton()->add_native_task(&Zone::instantiate_streamed_scene, this, false, "Instantiate zone scene");
+			m_streamState = STREAM_INSTANTIATING;
+			break;
+		}
+		case STREAM_INSTANTIATING: {
+			if(!WorkerThreadPool::get_singleton()->is_task_completed(m_instantiateTask)){
+				return;
+			}
+			WorkerThreadPool::get_singleton()->wait_for_task_completion(m_instantiateTask);
+			m_instantiateTask = WorkerThreadPool::INVALID_TASK_ID;
+			m_streamedScene.unref();
+			m_streamState = STREAM_IDLE;
+
+			Node *zoneInstance = m_streamedInstance;
+			m_streamedInstance = nullptr;
+			if(!zoneInstance){
+				ERR_PRINT(vformat("Could not instantiate the scene for zone with ID %d!", m_zoneId));
+				fail_streaming();
+				return;
+			}
+
+			//Entity spawns queued up while the zone was streaming get worked off from here on
+			attach_zone_instance(zoneInstance);
+
+			//Only now is the zone actually ready, so tell the server it can start sending players and entities
+			SteamNetworkingMessage_t *zoneLoadAck = create_mini_message(LOAD_ZONE_ACKNOWLEDGE, m_zoneId, GDNet::singleton->world->m_worldConnection);
+			send_message_reliable(zoneLoadAck);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+//Call this on the main thread. The server only adds the player to the zone once the load is acknowledged, so all that
+//has to be undone is the local side of the load. After that the zone can be requested again like it was never loaded.
+void Zone::fail_streaming() {
+	m_streamState = STREAM_IDLE;
+	if(m_zoneSceneFromPath){
+		m_zoneScene.unref();
+		m_zoneSceneFromPath = false;
+	}
+
+	Ref<PlayerInfo> localPlayer = get_player(GDNet::singleton->world->get_player_id());
+	if(localPlayer.is_valid()){
+		m_playersInZone.erase(localPlayer->get_player_id());
+		localPlayer->unsubscribe_zone(this);
+	}
+
+	GDNet::singleton->world->emit_signal("zone_load_failed", this);
+}
+
+//Call this on the main thread
+void Zone::cancel_streaming() {
+	if(m_streamState == STREAM_INSTANTIATING){
+		//The worker cant be interrupted, so let it finish and throw away what it built
+		WorkerThreadPool::get_singleton()->wait_for_task_completion(m_instantiateTask);
+		m_instantiateTask = WorkerThreadPool::INVALID_TASK_ID;
+		m_streamedScene.unref();
+
+		if(m_streamedInstance){
+			memdelete(m_streamedInstance);
+			m_streamedInstance = nullptr;
+		}
+	}
+
+	//A load that is still running is left alone, the next stream (or resolve) picks the request back up
+	m_streamState = STREAM_IDLE;
+}
+
+//Call this on the main thread
+void Zone::attach_zone_instance(Node *zoneInstance) {
+	m_zoneInstance = zoneInstance;
+
+	//The instance doesnt need the packed scene, so a scene loaded from zone_scene_path gets let go of until next time
+	if(m_zoneSceneFromPath){
+		m_zoneScene.unref();
+		m_zoneSceneFromPath = false;
+	}
+
+	//Indicate that the zone has been instantiated through the boolean flag
+	//Gotta call this before adding the instance to the scene otherwise if any entities are
+	//created, it will think that the zone doenst exist and throw an error.
+	m_instantiated = true;
+
+	//This is using the built in "add_child" mehtod to append the instance to the zone.
+	add_child(m_zoneInstance);
+
+	//Bring back the entities the zone had when it went into hibernation or when the server was shut down
+	if(m_hibernated){
+		restore_from_hibernation();
+	}
+	GDNet::singleton->world->SERVER_SIDE_restore_zone_from_snapshot(this);
+
+	//Raise the "loaded_zone" signal
+	GDNet::singleton->world->emit_signal("loaded_zone", this);
+}
+
+//Call this on the main thread
+void Zone::process_entity_queues(bool ignoreBudget) {
+	//Grab everything the network threads queued up since last time
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+		for(const Ref<EntityInfo> &entityInfo : m_pendingSpawns){
+			m_spawnBacklog.push_back(entityInfo);
+		}
+		for(NetworkEntity *instance : m_pendingDespawns){
+			m_despawnBacklog.push_back(instance);
+		}
+		m_pendingSpawns.clear();
+		m_pendingDespawns.clear();
+	}
+
+	uint64_t deadline = OS::get_singleton()->get_ticks_usec() + m_spawnBudgetUsec;
+
+	//Despawn first so the freed up instances can be reused by the spawns right after. At least one of each goes
+	//through every frame however small the budget is, otherwise the backlogs could only ever grow.
+	uint32_t firstDespawn = m_despawnBacklogIdx;
+	while(m_despawnBacklogIdx < m_despawnBacklog.size()){
+		if(!ignoreBudget && m_despawnBacklogIdx != firstDespawn && OS::get_singleton()->get_ticks_usec() >= deadline){
+			break;
+		}
+		despawn_entity(m_despawnBacklog[m_despawnBacklogIdx++]);
+	}
+
+	uint32_t firstSpawn = m_spawnBacklogIdx;
+	while(m_spawnBacklogIdx < m_spawnBacklog.size()){
+		if(!ignoreBudget && m_spawnBacklogIdx != firstSpawn && OS::get_singleton()->get_ticks_usec() >= deadline){
+			break;
+		}
+		spawn_entity(m_spawnBacklog[m_spawnBacklogIdx++]);
+	}
+
+	//Anything left over carries on next frame
+	if(m_despawnBacklogIdx == m_despawnBacklog.size()){
+		m_despawnBacklog.clear();
+		m_despawnBacklogIdx = 0;
+	}
+	if(m_spawnBacklogIdx == m_spawnBacklog.size()){
+		m_spawnBacklog.clear();
+		m_spawnBacklogIdx = 0;
+	}
+}
+
+//Call this on the main thread
+void Zone::spawn_entity(Ref<EntityInfo> entityInfo) {
+	EntityID_t entityId = entityInfo->get_entity_id();
+	String parentRelativePath = entityInfo->get_parent_relative_path();
+
+	//Dont bother instantiating anything if the entity was destroyed while it was waiting to be spawned
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+		if(!m_entitiesInZone.has(entityInfo->get_network_id())){
+			return;
+		}
+
+		//A headless server only instantiates entities that need to run logic in a zone that has a scene for them
+		NetworkEntityInfo_t *entityType = GDNet::singleton->m_networkEntityRegistry.getptr(entityId);
+		if(GDNet::singleton->m_isServer && GDNet::singleton->m_headlessServer && entityType && (m_headless || !entityType->serverLogic)){
+			add_headless_entity(entityInfo, *entityType);
+			return;
+		}
+	}
+
+	NetworkEntity* instanceAsEntity = GDNet::singleton->acquire_entity_instance(entityId);
+	if(!instanceAsEntity){
+		return;
+	}
+
+	//Check again in case it got destroyed while it was being instantiated
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+		Ref<EntityInfo> *registeredEntity = m_entitiesInZone.getptr(entityInfo->get_network_id());
+		if(!registeredEntity || *registeredEntity != entityInfo){
+			GDNet::singleton->release_entity_instance(entityId, instanceAsEntity);
+			return;
+		}
+		entityInfo->m_entityInfo.entityInstance = instanceAsEntity;
+	}
+
+	//Assign info reference to the instance
+	instanceAsEntity->m_info = entityInfo;
+
+	//Store the parent zone instance in the entity
+	instanceAsEntity->m_parentZone = this;
+
+	//Get a refrence to the requested parent node if one was provided. Otherwise just use the instance as the base node.
+	Node *parentNode;
+	if(parentRelativePath == ""){
+		parentNode = m_zoneInstance;
+	}else {
+		parentNode = m_zoneInstance->get_node_or_null(parentRelativePath);
+		if(!parentNode){
+			WARN_PRINT(vformat("Zone %d has no node at \"%s\", spawning entity %d at the zone root instead.", m_zoneId, parentRelativePath, entityInfo->get_network_id()));
+			parentNode = m_zoneInstance;
+		}
+	}
+
+	//Add the entity to the zone scene
+	parentNode->add_child(instanceAsEntity);
+
+	//Connect the entity to data transmission signals
+	instanceAsEntity->connect_transmit();
+}
+
+//Call this on the main thread
+void Zone::despawn_entity(NetworkEntity *instance) {
+	//Disconnect the entity from data transmission signals
+	instance->disconnect_transmit();
+
+	EntityID_t entityId = instance->m_info->get_entity_id();
+
+	//Hand the node back to the pool (or free it if the type isnt pooled or the pool is full)
+	GDNet::singleton->release_entity_instance(entityId, instance);
+}
+
+//Call with the entity queue lock held
+void Zone::add_headless_entity(Ref<EntityInfo> entityInfo, const NetworkEntityInfo_t &entityType) {
+	HeadlessEntity_t record{};
+	record.networkId = entityInfo->get_network_id();
+	record.authorityEpoch = entityInfo->m_entityInfo.authorityEpoch;
+
+	std::lock_guard<std::mutex> lock(m_headlessMutex);
+
+	//One record per sync module, seeded with the spawn position until the owner sends something
+	if(entityType.transform2DTickInterval > 0){
+		Transform2D spawnTransform;
+		spawnTransform.set_origin(entityInfo->get_initial_position_2D());
+
+		record.updateType = TRANSFORM2D_SYNC_UPDATE;
+		record.tickInterval = entityType.transform2DTickInterval;
+		record.payloadSize = sizeof(Transform2D);
+		serialize_basic(spawnTransform, 0, record.payload);
+
+		m_headlessEntityIndices.insert((static_cast<uint64_t>(record.networkId) << 8) | record.updateType, m_headlessEntities.size());
+		m_headlessEntities.push_back(record);
+	}
+
+	if(entityType.transform3DTickInterval > 0){
+		Transform3D spawnTransform;
+		spawnTransform.set_origin(entityInfo->get_initial_position_3D());
+
+		record.updateType = TRANSFORM3D_SYNC_UPDATE;
+		record.tickInterval = entityType.transform3DTickInterval;
+		record.payloadSize = 12 * sizeof(real_t);
+		serialize_transform3d(spawnTransform, 0, record.payload);
+
+		m_headlessEntityIndices.insert((static_cast<uint64_t>(record.networkId) << 8) | record.updateType, m_headlessEntities.size());
+		m_headlessEntities.push_back(record);
+	}
+}
+
+void Zone::remove_headless_entity(EntityNetworkID_t networkId) {
+	std::lock_guard<std::mutex> lock(m_headlessMutex);
+
+	const unsigned char updateTypes[] = { TRANSFORM2D_SYNC_UPDATE, TRANSFORM3D_SYNC_UPDATE };
+	for(unsigned char updateType : updateTypes){
+		uint64_t recordKey = (static_cast<uint64_t>(networkId) << 8) | updateType;
+		uint32_t *recordIdx = m_headlessEntityIndices.getptr(recordKey);
+		if(!recordIdx){
+			continue;
+		}
+
+		//Swap the last record into the hole so the table stays packed
+		uint32_t removedIdx = *recordIdx;
+		uint32_t lastIdx = m_headlessEntities.size() - 1;
+		if(removedIdx != lastIdx){
+			const HeadlessEntity_t &lastRecord = m_headlessEntities[lastIdx];
+			m_headlessEntities[removedIdx] = lastRecord;
+			m_headlessEntityIndices[(static_cast<uint64_t>(lastRecord.networkId) << 8) | lastRecord.updateType] = removedIdx;
+		}
+		m_headlessEntities.resize(lastIdx);
+		m_headlessEntityIndices.erase(recordKey);
+	}
+}
+
+//Call this on the main thread
+void Zone::update_hibernation(float delta) {
+	//Hibernation is off unless a delay was set
+	if(m_hibernationDelay <= 0.0f || !m_instantiated || !m_playersInZone.is_empty()){
+		m_idleTime = 0.0f;
+		return;
+	}
+
+	m_idleTime += delta;
+	if(m_idleTime >= m_hibernationDelay){
+		hibernate();
+	}
+}
+
+//Call this on the main thread
+void Zone::capture_entity_state(const Ref<EntityInfo> &entityInfo) {
+	//Instantiated entities may have moved since they were created, so save where they are now
+	NetworkEntity *instance = entityInfo->m_entityInfo.entityInstance;
+	if(!instance){
+		return;
+	}
+
+	Ref<Transform2DSync> transform2DSync = instance->get_transform2d_sync();
+	if(transform2DSync.is_valid() && transform2DSync->has_target()){
+		entityInfo->set_initial_position_2D(transform2DSync->get_target()->get_position());
+	}
+
+	Ref<Transform3DSync> transform3DSync = instance->get_transform3d_sync();
+	if(transform3DSync.is_valid() && transform3DSync->has_target()){
+		entityInfo->set_initial_position_3D(transform3DSync->get_target()->get_position());
+	}
+}
+
+//Call this on the main thread
+void Zone::hibernate() {
+	print_line(vformat("Zone %d has been idle for %f seconds, hibernating...", m_zoneId, m_idleTime));
+
+	m_hibernationSnapshot.clear();
+	int snapshotSize = 0;
+
+	LocalVector<Ref<EntityInfo>> entities;
+	get_entities(entities);
+
+	//Pack every entity into the snapshot as [varint info size][serialized entity info]
+	for(const Ref<EntityInfo> &entityInfo : entities){
+		capture_entity_state(entityInfo);
+
+		entityInfo->serialize_info();
+		const Vector<unsigned char> &infoData = entityInfo->m_entityInfo.dataBuffer;
+
+		m_hibernationSnapshot.resize(snapshotSize + 5 + infoData.size());
+		snapshotSize += serialize_varint(infoData.size(), m_hibernationSnapshot.ptrw() + snapshotSize);
+		memcpy(m_hibernationSnapshot.ptrw() + snapshotSize, infoData.ptr(), infoData.size());
+		snapshotSize += infoData.size();
+	}
+	m_hibernationSnapshot.resize(snapshotSize);
+
+	//Free the scene (and every entity in it)
+	uninstantiate_zone();
+	m_hibernated = true;
+	m_idleTime = 0.0f;
+}
+
+//Call this on the main thread
+void Zone::restore_from_hibernation() {
+	const unsigned char *snapshotData = m_hibernationSnapshot.ptr();
+	int snapshotSize = m_hibernationSnapshot.size();
+	int snapshotIdx = 0;
+
+	//Recreate every entity as it was, network ids included, so nothing about them changes for players
+	uint32_t infoSize;
+	while(snapshotIdx < snapshotSize && deserialize_varint(snapshotData, snapshotSize, snapshotIdx, infoSize)){
+		if(infoSize > static_cast<uint32_t>(snapshotSize - snapshotIdx)){
+			break;
+		}
+
+		Ref<EntityInfo> entityInfo;
+		entityInfo.instantiate();
+		if(entityInfo->deserialize_info(snapshotData + snapshotIdx, infoSize)){
+			create_entity(entityInfo);
+		}
+		snapshotIdx += infoSize;
+	}
+
+	m_hibernationSnapshot.clear();
+	m_hibernated = false;
+
+	print_line(vformat("Zone %d restored from hibernation.", m_zoneId));
+}
+
+//Call this on the main thread
+void Zone::record_rewind_frame() {
+	//Size the ring to hold the whole history the first time around (and whenever the duration changed)
+	if(m_rewindFrames.is_empty()){
+		m_rewindFrames.resize(MAX(1, static_cast<int>(Math::ceil(m_rewindHistoryDuration * Engine::get_singleton()->get_physics_ticks_per_second()))));
+		m_rewindHead = 0;
+		m_rewindFrameCount = 0;
+	}
+
+	//Overwrite the oldest frame. Clearing keeps the capacity, so this stops allocating once the ring has wrapped.
+	RewindFrame_t &frame = m_rewindFrames[m_rewindHead];
+	frame.time = SteamNetworkingUtils()->GetLocalTimestamp();
+	frame.entries.clear();
+
+	//Positions are recorded in world space, entities can sit under parent nodes that are offset themselves
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+		for(const KeyValue<EntityNetworkID_t, Ref<EntityInfo>> &entity : m_entitiesInZone){
+			NetworkEntity *instance = entity.value->m_entityInfo.entityInstance;
+			if(!instance){
+				continue;
+			}
+
+			Ref<Transform3DSync> transform3DSync = instance->get_transform3d_sync();
+			if(transform3DSync.is_valid() && transform3DSync->has_target()){
+				frame.entries.push_back({ entity.key, transform3DSync->get_target()->get_global_position() });
+				continue;
+			}
+
+			Ref<Transform2DSync> transform2DSync = instance->get_transform2d_sync();
+			if(transform2DSync.is_valid() && transform2DSync->has_target()){
+				Vector2 position = transform2DSync->get_target()->get_global_position();
+				frame.entries.push_back({ entity.key, Vector3(position.x, position.y, 0.0f) });
+			}
+		}
+	}
+
+	//Entities a headless server did not instantiate are only in the transform table. There is no scene to place them in,
+	//so their synced positions are taken as world space.
+	if(m_headless){
+		std::lock_guard<std::mutex> lock(m_headlessMutex);
+		for(const HeadlessEntity_t &record : m_headlessEntities){
+			if(record.updateType == TRANSFORM3D_SYNC_UPDATE){
+				frame.entries.push_back({ record.networkId, deserialize_transform3d(0, record.payload).get_origin() });
+			}else if(record.updateType == TRANSFORM2D_SYNC_UPDATE){
+				Vector2 position = deserialize_basic<Transform2D>(0, record.payload).get_origin();
+				frame.entries.push_back({ record.networkId, Vector3(position.x, position.y, 0.0f) });
+			}
+		}
+	}
+
+	m_rewindHead = (m_rewindHead + 1) % m_rewindFrames.size();
+	m_rewindFrameCount = MIN(m_rewindFrameCount + 1, m_rewindFrames.size());
+}
+
+//Newest frame recorded at or before the time. Times from before the history are clamped to the oldest frame.
+const RewindFrame_t *Zone::find_rewind_frame(SteamNetworkingMicroseconds time) const {
+	if(m_rewindFrameCount == 0){
+		return nullptr;
+	}
+
+	//Frames are in time order starting from the oldest one, so binary search over the ring
+	uint32_t capacity = m_rewindFrames.size();
+	uint32_t oldest = (m_rewindHead + capacity - m_rewindFrameCount) % capacity;
+	uint32_t low = 0;
+	uint32_t high = m_rewindFrameCount;
+	while(high - low > 1){
+		uint32_t mid = (low + high) / 2;
+		if(m_rewindFrames[(oldest + mid) % capacity].time <= time){
+			low = mid;
+		}else{
+			high = mid;
+		}
+	}
+
+	return &m_rewindFrames[(oldest + low) % capacity];
+}
+
 //==Protected Methods==//
 
 void Zone::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_zone_scene"), &Zone::get_zone_scene);
 	ClassDB::bind_method(D_METHOD("set_zone_scene", "zone_scene"), &Zone::set_zone_scene);
+	ClassDB::bind_method(D_METHOD("get_zone_scene_path"), &Zone::get_zone_scene_path);
+	ClassDB::bind_method(D_METHOD("set_zone_scene_path", "zone_scene_path"), &Zone::set_zone_scene_path);
 	ClassDB::bind_method(D_METHOD("instantiate_zone"), &Zone::instantiate_zone);
+	ClassDB::bind_method(D_METHOD("is_streaming"), &Zone::is_streaming);
 	ClassDB::bind_method(D_METHOD("load_entity", "entity_info"), &Zone::load_entity);
+	ClassDB::bind_method(D_METHOD("get_spawn_budget_usec"), &Zone::get_spawn_budget_usec);
+	ClassDB::bind_method(D_METHOD("set_spawn_budget_usec", "spawn_budget_usec"), &Zone::set_spawn_budget_usec);
+	ClassDB::bind_method(D_METHOD("get_server_logic"), &Zone::get_server_logic);
+	ClassDB::bind_method(D_METHOD("set_server_logic", "server_logic"), &Zone::set_server_logic);
+	ClassDB::bind_method(D_METHOD("is_headless"), &Zone::is_headless);
+	ClassDB::bind_method(D_METHOD("is_hibernated"), &Zone::is_hibernated);
+	ClassDB::bind_method(D_METHOD("get_hibernation_delay"), &Zone::get_hibernation_delay);
+	ClassDB::bind_method(D_METHOD("set_hibernation_delay", "hibernation_delay"), &Zone::set_hibernation_delay);
+	ClassDB::bind_method(D_METHOD("get_rewind_history_duration"), &Zone::get_rewind_history_duration);
+	ClassDB::bind_method(D_METHOD("set_rewind_history_duration", "duration"), &Zone::set_rewind_history_duration);
+	ClassDB::bind_method(D_METHOD("rewind_query", "server_time", "shape", "shape_transform"), &Zone::rewind_query);
+	ClassDB::bind_method(D_METHOD("rewind_query_2d", "server_time", "shape", "shape_transform"), &Zone::rewind_query_2d);
+
+	ClassDB::bind_method(D_METHOD("register_rpc", "method", "reliable"), &Zone::register_rpc, DEFVAL(true));
+
+	{
+		MethodInfo mi;
+		mi.name = "rpc_server";
+		mi.arguments.push_back(PropertyInfo(Variant::STRING_NAME, "method"));
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "rpc_server", &Zone::_rpc_server_bind, mi);
+
+		mi.name = "rpc_zone";
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "rpc_zone", &Zone::_rpc_zone_bind, mi);
+	}
 
 	ClassDB::bind_method(D_METHOD("instantiate_callback"), &Zone::instantiate_zone);
+	ClassDB::bind_method(D_METHOD("stream_callback"), &Zone::begin_streaming);
 	ClassDB::bind_method(D_METHOD("player_loaded_callback", "player_info"), &Zone::player_loaded_callback);
 
 	//Internal methods
 	ClassDB::bind_method(D_METHOD("_remove_player", "player_info"), &Zone::remove_player);
+	ClassDB::bind_method(D_METHOD("_wake_entity", "network_id"), &Zone::wake_entity);
 
 	//Expose zone scene property to be set in the inspector
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "zone_scene", PROPERTY_HINT_RESOURCE_TYPE, "PackedScene"), "set_zone_scene", "get_zone_scene");
+	//Alternative to zone_scene that doesnt keep the scene loaded while the zone isnt, it gets streamed in when needed
+	//and let go of again once the zone is instantiated
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "zone_scene_path", PROPERTY_HINT_FILE, "*.tscn,*.scn"), "set_zone_scene_path", "get_zone_scene_path");
+	//Whether a headless server still has to instantiate the zone scene to run its logic
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "server_logic"), "set_server_logic", "get_server_logic");
+	//Seconds without players before the server hibernates the zone (0 never hibernates it)
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "hibernation_delay", PROPERTY_HINT_RANGE, "0,3600,0.1,or_greater,suffix:s"), "set_hibernation_delay", "get_hibernation_delay");
+	//Microseconds per frame spent spawning and despawning entities (one of each always goes through, even at 0)
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "spawn_budget_usec", PROPERTY_HINT_RANGE, "0,100000,1,or_greater"), "set_spawn_budget_usec", "get_spawn_budget_usec");
+	//Seconds of entity positions the server keeps for rewind queries (0 turns the history off)
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "rewind_history_duration", PROPERTY_HINT_RANGE, "0,10,0.01,or_greater,suffix:s"), "set_rewind_history_duration", "get_rewind_history_duration");
 
 	ADD_SIGNAL(MethodInfo("player_loaded_zone", PropertyInfo(Variant::INT, "player_id")));
 	ADD_SIGNAL(MethodInfo("player_left_zone", PropertyInfo(Variant::INT, "player_id")));
@@ -39,12 +590,33 @@ void Zone::_notification(int n_type) {
 	switch (n_type) {
 		case NOTIFICATION_ENTER_TREE: {
 			GDNet::singleton->register_zone(this);
+			set_process_internal(true);
+			set_physics_process_internal(true);
 			break;
 		}
 		case NOTIFICATION_EXIT_TREE: {
 			GDNet::singleton->unregister_zone(this);
 			break;
 		}
+		case NOTIFICATION_INTERNAL_PROCESS: {
+			if(m_streamState != STREAM_IDLE){
+				process_streaming();
+			}
+			if(m_instantiated){
+				process_entity_queues(false);
+			}
+			if(GDNet::singleton->m_isServer){
+				update_hibernation(get_process_delta_time());
+			}
+			break;
+		}
+		case NOTIFICATION_INTERNAL_PHYSICS_PROCESS: {
+			//Positions are recorded at the physics rate, which is what hits get checked at
+			if(GDNet::singleton->m_isServer && m_rewindHistoryDuration > 0.0f && (m_instantiated || m_headless)){
+				record_rewind_frame();
+			}
+			break;
+		}
 	}
 }
 
@@ -57,52 +629,105 @@ bool Zone::instantiate_zone() {
 		return false;
 	}
 
+	//A headless server keeps zones without server side logic as plain data, so there is no scene to instantiate
+	if(GDNet::singleton->m_isServer && GDNet::singleton->m_headlessServer && !m_serverLogic){
+		m_headless = true;
+		m_instantiated = true;
+		if(m_hibernated){
+			restore_from_hibernation();
+		}
+		GDNet::singleton->world->SERVER_SIDE_restore_zone_from_snapshot(this);
+		GDNet::singleton->world->emit_signal("loaded_zone", this);
+		return true;
+	}
+
 	//Make sure a packed scene was provided for the zone
-	if(!m_zoneScene.is_valid()){
+	if(resolve_zone_scene().is_null()){
 		ERR_PRINT(vformat("Zone with ID %d was not given a scene to create!", m_zoneId));
 		return false;
 	}
-	//Instantiate the actual packed scene
-	m_zoneInstance = m_zoneScene->instantiate();
 
 	//Instantiate the actual packed scene
-	m_zoneInstance = m_zoneScene->instantiate();
-
-	//Indicate that the zone has been instantiated through the boolean flag
-	//Gotta call this before adding the instance to the scene otherwise if any entities are
-	//created, it will think that the zone doenst exist and throw an error.
-	m_instantiated = true;
-
-	//This is using the built in "add_child" mehtod to append the instance to the zone.
-	add_child(m_zoneInstance);
-
-	//Raise the "loaded_zone" signal
-	GDNet::singleton->world->emit_signal("loaded_zone", this);
+	attach_zone_instance(m_zoneScene->instantiate());
 
 	return true;
 }
 
 void Zone::uninstantiate_zone() {
-	//Destory all entities in the zone
-	for(const KeyValue<EntityNetworkID_t, Ref<EntityInfo>> &entity : m_entitiesInZone){
-		destroy_entity(entity.value);
+	//Drop a stream that hasnt finished yet
+	cancel_streaming();
+
+	//Destory all entities in the zone (collected first, destroying them removes them from the map)
+	LocalVector<Ref<EntityInfo>> entitiesToDestroy;
+	get_entities(entitiesToDestroy);
+	for(const Ref<EntityInfo> &entityInfo : entitiesToDestroy){
+		destroy_entity(entityInfo);
 	}
 
+	//The entity nodes are about to go away with the zone instance, so work off the queues right now
+	process_entity_queues(true);
+
 	//Clear all players from the zone
 	m_playersInZone.clear();
 
-	//Destroy the zone instance
-	m_zoneInstance->queue_free();
+	//Destroy the zone instance (headless zones never had one)
+	if(m_zoneInstance){
+		m_zoneInstance->queue_free();
+		m_zoneInstance = nullptr;
+	}
 
 	//Mark that the zone is no longer instantiated
 	m_instantiated = false;
+	m_headless = false;
+}
+
+//Call this on the main thread. Starts loading the zone scene in the background (if it isnt loaded already)
+//so it is ready sooner once the zone actually has to be instantiated.
+void Zone::preload_zone_scene() {
+	if(m_zoneScene.is_valid() || m_zoneScenePath.is_empty() || m_sceneLoadRequested){
+		return;
+	}
+
+	if(ResourceLoader::load_threaded_request(m_zoneScenePath, "PackedScene") == OK){
+		m_sceneLoadRequested = true;
+	}else{
+		ERR_PRINT(vformat("Could not start loading the scene for zone with ID %d!", m_zoneId));
+	}
+}
+
+//Call this on the main thread. Client side counterpart to instantiate_zone that never blocks the main thread.
+void Zone::begin_streaming() {
+	if(m_instantiated || m_streamState != STREAM_IDLE){
+		return;
+	}
+
+	preload_zone_scene();
+
+	if(m_sceneLoadRequested){
+		m_streamState = STREAM_LOADING;
+	}else if(m_zoneScene.is_valid()){
+		//Already loaded, go straight to instantiating it
+		m_streamedScene = m_zoneScene;
+		m_instantiateTask = WorkerThreadPool::get_singleton()->add_native_task(&Zone::instantiate_streamed_scene, this, false, "Instantiate zone scene");
+		m_streamState = STREAM_INSTANTIATING;
+	}else{
+		ERR_PRINT(vformat("Zone with ID %d was not given a scene to create!", m_zoneId));
+	}
+}
+
+bool Zone::has_zone_scene() const {
+	return m_zoneScene.is_valid() || !m_zoneScenePath.is_empty();
+}
+
+bool Zone::is_streaming() const {
+	return m_streamState != STREAM_IDLE;
 }
 
 void Zone::add_player(Ref<PlayerInfo> playerInfo) {
 	//Store the player info within the zone
 	m_playersInZone.insert(playerInfo->get_player_id(), playerInfo);
 	//Add this zone to the player's list of loaded zones
-	playerInfo->set_current_loaded_zone(this);
+	playerInfo->subscribe_zone(this);
 	//Queue the signal emission
 	call_deferred("player_loaded_callback", playerInfo);
 }
@@ -117,15 +742,20 @@ void Zone::remove_player(Ref<PlayerInfo> playerInfo) {
 	}
 	print_line("Killing entities...");
 	//Iterate through the player's owned entities, and remove them
-	//from the player's list and the zone if they exist in this zone
+	//from the player's list and the zone if they exist in this zone.
+	//Entities the player owns in their other loaded zones stay where they are.
 	print_line(vformat("number of entiteis owned: %d", playerInfo->m_playerInfo.ownedEntities.size()));
+	LocalVector<EntityNetworkID_t> entitiesKilled;
 	for(const KeyValue<EntityNetworkID_t, Ref<EntityInfo>> &ownedEntity : playerInfo->m_playerInfo.ownedEntities){
-		print_line(vformat("Killing entity: %d", ownedEntity.key));
-		if(m_entitiesInZone.has(ownedEntity.key)){
+		if(get_entity(ownedEntity.key).is_valid()){
+			print_line(vformat("Killing entity: %d", ownedEntity.key));
 			destroy_entity(ownedEntity.value);
+			entitiesKilled.push_back(ownedEntity.key);
 		}
 	}
-	playerInfo->m_playerInfo.ownedEntities.clear();
+	for(EntityNetworkID_t networkId : entitiesKilled){
+		playerInfo->m_playerInfo.ownedEntities.erase(networkId);
+	}
 
 	print_line("entities killed!");
 	//Remove player from zone's player list (this has to be done after the above bc
@@ -135,36 +765,42 @@ void Zone::remove_player(Ref<PlayerInfo> playerInfo) {
 	//Emit the "player_left_zone" signal
 	emit_signal("player_left_zone", playerId);
 
-	//Reset the player's zone info
-	print_line("cock");
-	playerInfo->reset_zone_info();
-	print_line("balls");
+	//Take this zone out of the player's loaded zones
+	playerInfo->unsubscribe_zone(this);
 	print_line("Player removal finished!");
 }
 
-void Zone::load_entity(Ref<EntityInfo> entityInfo) {
+bool Zone::load_entity(Ref<EntityInfo> entityInfo) {
 	//Make sure a world is being hosted or a world is connected to before trying to instantiate entities.
 	if(!GDNet::singleton->is_client() && !GDNet::singleton->is_server()){
 		ERR_PRINT("Cannot create an entity if not hosting or connected to a world!");
-		return;
+		return false;
 	}
 
 	//Make sure zone has been instantiated before calling
 	if(!m_instantiated){
 		ERR_PRINT("Cannot create entity in zone, zone has not been instantiated!");
-		return;
+		return false;
 	}
 
 	//If an associated player is defined, make sure they are in the zone.
 	if(entityInfo->get_owner_id() > 0 && !player_in_zone(entityInfo->get_owner_id())){
 		ERR_PRINT(vformat("Cannot associate entity with player \"ID: %d\". They are not in this zone!", entityInfo->get_owner_id()));
-		return;
+		return false;
 	}
 
 	//Make sure all other user entered data is valid
 	if(!entityInfo->verify_info()){
 		ERR_PRINT("Cannot create entity, entity info is not valid!");
-		return;
+		return false;
+	}
+
+	//The entity has to go under a node inside the zone scene. This can run on the listen thread, so only the path itself
+	//is checked here. Whether the node exists is checked on the main thread when the entity spawns (see spawn_entity).
+	String parentRelativePath = entityInfo->get_parent_relative_path();
+	if(parentRelativePath != "" && (NodePath(parentRelativePath).is_absolute() || parentRelativePath.contains(".."))){
+		ERR_PRINT(vformat("Cannot create entity, \"%s\" is not a path inside zone %d!", parentRelativePath, m_zoneId));
+		return false;
 	}
 
 	//Set the entity's parent zone id
@@ -181,7 +817,7 @@ void Zone::load_entity(Ref<EntityInfo> entityInfo) {
 
 		//Create and send the message
 		SteamNetworkingMessage_t* mssg = allocate_message(mssgData, mssgDataLen, GDNet::singleton->world->m_worldConnection);
-		send_message_reliable(mssg);
+		send_message_reliable(mssg, LANE_GAMEPLAY);
 		print_line("Sent entity creation request! :)");
 	}else if(GDNet::singleton->is_server()){
 		//Assign a network id for the entity
@@ -197,94 +833,153 @@ void Zone::load_entity(Ref<EntityInfo> entityInfo) {
 			player.value->load_entity(entityInfo);
 		}
 	}
+
+	return true;
 }
 
+//Safe to call from any thread, the entity gets spawned into the scene on the main thread
 void Zone::create_entity(Ref<EntityInfo> entityInfo) {
-	print_line("Creating Entity...");
-	//Store local references to relevant objects
-	EntityID_t entityId = entityInfo->get_entity_id();
-	String parentRelativePath = entityInfo->get_parent_relative_path();
 	PlayerID_t ownerId = entityInfo->get_owner_id();
 
-	//Instantiate the entity
-	Node* instance = GDNet::singleton->m_networkEntityRegistry.get(entityId).scene->instantiate();
-	NetworkEntity* instanceAsEntity = Object::cast_to<NetworkEntity>(instance);
-	entityInfo->m_entityInfo.entityInstance = instanceAsEntity;
+	//Stamp the entity before the listen thread can find it. Anything it queues after seeing the entity in the map
+	//gets a higher sequence, updates still sitting in the mailbox from a previous owner of the network id do not.
+	entityInfo->m_entityInfo.inboundSequence = GDNet::singleton->world->get_inbound_sequence();
 
-	//Assign info reference to the instance
-	instanceAsEntity->m_info = entityInfo;
-
-	//Get a refrence to the requested parent node if one was provided. Otherwise just use the instance as the base node.
-	Node *parentNode;
-	if(parentRelativePath == ""){
-		parentNode = m_zoneInstance;
-	}else {
-		parentNode = m_zoneInstance->get_node(parentRelativePath);
-	}
-
-	//Add the entity to the zone scene
-	parentNode->call_deferred("add_child", instanceAsEntity);
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
 
-	//Add the entity to list of known entities in zone
-	m_entitiesInZone.insert(entityInfo->m_entityInfo.networkId, entityInfo);
+		//Add the entity to list of known entities in zone
+		m_entitiesInZone.insert(entityInfo->m_entityInfo.networkId, entityInfo);
 
-	//Store the parent zone instance in the entity
-	instanceAsEntity->m_parentZone = this;
+		//Queue up the actual instantiation
+		m_pendingSpawns.push_back(entityInfo);
+	}
 
 	//Associate the entity with a player (if such a player was specified)
 	if(ownerId != 0){
-		print_line("gabba goo!");
 		m_playersInZone.get(ownerId)->add_owned_entity(entityInfo);
-		print_line("gooba gaa!");
 	}
+}
 
-	//Connect the entity to data transmission signals
-	if(GDNet::singleton->m_isServer){
-		Callable transmitCallback = Callable(instanceAsEntity, "server_side_transmit_data");
-		GDNet::singleton->world->connect("_server_side_transmit_entity_data", transmitCallback);
-	}else{
-		Callable transmitCallback = Callable(instanceAsEntity, "client_side_transmit_data");
-		GDNet::singleton->world->connect("_client_side_transmit_entity_data", transmitCallback);
+//Call this on the main thread. Moves the entity between the owned entity lists of its previous and new owner.
+void Zone::set_entity_owner(Ref<EntityInfo> entityInfo, PlayerID_t newOwner, uint8_t authorityEpoch) {
+	PlayerID_t previousOwner = entityInfo->get_owner_id();
+
+	Ref<PlayerInfo> *previousOwnerInfo = m_playersInZone.getptr(previousOwner);
+	if(previousOwner != 0 && previousOwnerInfo){
+		(*previousOwnerInfo)->remove_owned_entity(entityInfo->get_network_id());
 	}
 
+	Ref<PlayerInfo> *newOwnerInfo = m_playersInZone.getptr(newOwner);
+	if(newOwner != 0 && newOwnerInfo){
+		(*newOwnerInfo)->add_owned_entity(entityInfo);
+	}
 
-	print_line("Entity Created!");
+	//Everything stamped from here on belongs to the new owner. Both are written under the lock, so the listen thread
+	//(see get_entity_authority) never sees the new owner with the old epoch or the other way around.
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+		entityInfo->m_entityInfo.authorityEpoch = authorityEpoch;
+		entityInfo->m_entityInfo.owner = newOwner;
+	}
+
+	if(entityInfo->m_entityInfo.entityInstance){
+		entityInfo->m_entityInfo.entityInstance->on_ownership_changed(previousOwner);
+	}
+}
+
+//Call this on the main thread
+void Zone::wake_entity(EntityNetworkID_t networkId) {
+	Ref<EntityInfo> entityInfo = get_entity(networkId);
+	if(entityInfo.is_valid() && entityInfo->m_entityInfo.entityInstance){
+		entityInfo->m_entityInfo.entityInstance->wake();
+	}
 }
 
+//Safe to call from any thread, the entity gets despawned from the scene on the main thread
 void Zone::destroy_entity(Ref<EntityInfo> entityInfo) {
-	print_line("Entity destruction started....");
-	//Make sure the provided entity exists in this zone
 	EntityNetworkID_t networkId = entityInfo->get_network_id();
+
+	std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+
+	//Make sure the provided entity exists in this zone
 	if(!m_entitiesInZone.has(networkId)){
-		ERR_PRINT(vformat("Entity with net id %d does not exist in this zone!", entityInfo->get_network_id()));
+		ERR_PRINT(vformat("Entity with net id %d does not exist in this zone!", networkId));
 		return;
-	}else{
-		//Remove the entity reference stored in the zone
-		m_entitiesInZone.erase(networkId);
 	}
 
-	//Disconnect the entity from data transmission signals
+	//Remove the entity reference stored in the zone. If it was never spawned, the pending spawn sees this and gets dropped.
+	m_entitiesInZone.erase(networkId);
+
+	//Queue the node instance for removal and remove the pointer reference from the entity info
 	NetworkEntity* instanceAsEntity = entityInfo->m_entityInfo.entityInstance;
-	if(GDNet::singleton->m_isServer){
-		Callable transmitCallback = Callable(instanceAsEntity, "server_side_transmit_data");
-		GDNet::singleton->world->disconnect("_server_side_transmit_entity_data", transmitCallback);
+	if(instanceAsEntity){
+		m_pendingDespawns.push_back(instanceAsEntity);
+		entityInfo->m_entityInfo.entityInstance = nullptr;
 	}else{
-		Callable transmitCallback = Callable(instanceAsEntity, "client_side_transmit_data");
-		GDNet::singleton->world->disconnect("_client_side_transmit_entity_data", transmitCallback);
+		//The entity was never instantiated, so it might only exist in the headless transform table
+		remove_headless_entity(networkId);
+	}
+}
+
+//Call this on the main thread. Moves the entity (keeping its network id and node) into another zone.
+//Only the local side of the move happens here, telling players about it is up to the world.
+bool Zone::migrate_entity(Ref<EntityInfo> entityInfo, Zone *targetZone) {
+	EntityNetworkID_t networkId = entityInfo->get_network_id();
+	NetworkEntity *instanceAsEntity;
+
+	{
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+
+		if(!m_entitiesInZone.has(networkId)){
+			ERR_PRINT(vformat("Entity with net id %d does not exist in this zone!", networkId));
+			return false;
+		}
+
+		//A spawn still waiting in this zone's queue sees the entity is gone and gets dropped
+		m_entitiesInZone.erase(networkId);
+		instanceAsEntity = entityInfo->m_entityInfo.entityInstance;
+		if(!instanceAsEntity){
+			remove_headless_entity(networkId);
+		}
 	}
 
-	//Unlink the zone from the entity
-	instanceAsEntity->m_parentZone = nullptr;
+	entityInfo->m_entityInfo.parentZone = targetZone->m_zoneId;
+
+	//Find the node the entity goes under in the target zone
+	Node *parentNode = nullptr;
+	if(targetZone->m_instantiated && !targetZone->m_headless){
+		String parentRelativePath = entityInfo->get_parent_relative_path();
+		parentNode = parentRelativePath == "" ? targetZone->m_zoneInstance : targetZone->m_zoneInstance->get_node_or_null(parentRelativePath);
+		if(!parentNode){
+			WARN_PRINT(vformat("Zone %d has no node at \"%s\", migrating entity %d to the zone root instead.", targetZone->m_zoneId, parentRelativePath, networkId));
+			entityInfo->set_parent_relative_path("");
+			parentNode = targetZone->m_zoneInstance;
+		}
+	}
 
-	//Delete the node instance
-	instanceAsEntity->queue_free();
+	//Just move the node over. It stays connected to the transmit signal, so nothing else has to change.
+	if(instanceAsEntity && parentNode && instanceAsEntity->get_parent()){
+		instanceAsEntity->get_parent()->remove_child(instanceAsEntity);
+		parentNode->add_child(instanceAsEntity);
+		instanceAsEntity->m_parentZone = targetZone;
 
-	//Remove the entity instance pointer reference from the entity info
-	entityInfo->m_entityInfo.entityInstance = nullptr;
+		std::lock_guard<std::mutex> lock(targetZone->m_entityQueueMutex);
+		targetZone->m_entitiesInZone.insert(networkId, entityInfo);
+		return true;
+	}
 
-	print_line(vformat("Ref Count for entity %d: %d", networkId, entityInfo->get_reference_count()));
+	//The target zone cant hold the node right now (still streaming in, headless, etc.), so the entity gets respawned over there instead
+	if(instanceAsEntity){
+		std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+		m_pendingDespawns.push_back(instanceAsEntity);
+		entityInfo->m_entityInfo.entityInstance = nullptr;
+	}
 
-	print_line("Entity destoryed");
+	std::lock_guard<std::mutex> lock(targetZone->m_entityQueueMutex);
+	targetZone->m_entitiesInZone.insert(networkId, entityInfo);
+	targetZone->m_pendingSpawns.push_back(entityInfo);
+	return true;
 }
 
 void Zone::player_loaded_callback(Ref<PlayerInfo> playerInfo) {
@@ -301,11 +996,220 @@ bool Zone::is_instantiated() {
 	return m_instantiated;
 }
 
+bool Zone::is_headless() const {
+	return m_headless;
+}
+
+bool Zone::is_hibernated() const {
+	return m_hibernated;
+}
+
+//Call this on the main thread
+bool Zone::SERVER_SIDE_store_headless_update(Ref<EntityInfo> entityInfo, const EntityUpdateInfo_t &updateInfo) {
+	std::lock_guard<std::mutex> lock(m_headlessMutex);
+
+	//Updates for entities that are not in the table (yet) are just ignored
+	uint32_t *recordIdx = m_headlessEntityIndices.getptr((static_cast<uint64_t>(updateInfo.networkId) << 8) | updateInfo.updateType);
+	if(!recordIdx){
+		return true;
+	}
+	HeadlessEntity_t &record = m_headlessEntities[*recordIdx];
+
+	//The payload has to hold the same kind of transform the record was seeded with. Owners using dead reckoning
+	//append their velocities after it, which get relayed along with the transform.
+	int transformSize = updateInfo.updateType == TRANSFORM2D_SYNC_UPDATE ? static_cast<int>(sizeof(Transform2D)) : static_cast<int>(12 * sizeof(real_t));
+	if(updateInfo.payloadSize < transformSize || updateInfo.payloadSize > MAX_INBOUND_PAYLOAD_SIZE){
+		return false;
+	}
+	memcpy(record.payload, updateInfo.payload, updateInfo.payloadSize);
+	record.payloadSize = updateInfo.payloadSize;
+	record.authorityEpoch = updateInfo.authorityEpoch;
+
+	//Keep the initial position up to date for players that load the entity later, like an instantiated entity would
+	if(updateInfo.updateType == TRANSFORM2D_SYNC_UPDATE){
+		entityInfo->set_initial_position_2D(deserialize_basic<Transform2D>(0, record.payload).get_origin());
+	}else if(updateInfo.updateType == TRANSFORM3D_SYNC_UPDATE){
+		entityInfo->set_initial_position_3D(deserialize_transform3d(0, record.payload).get_origin());
+	}
+
+	return true;
+}
+
+//Call this on the main thread
+void Zone::SERVER_SIDE_capture_snapshot(WorldSnapshotBuilder &builder) {
+	//Hibernated zones already have their entities packed up, so just unpack them into the world snapshot
+	if(m_hibernated){
+		const unsigned char *snapshotData = m_hibernationSnapshot.ptr();
+		int snapshotSize = m_hibernationSnapshot.size();
+		int snapshotIdx = 0;
+
+		uint32_t infoSize;
+		while(snapshotIdx < snapshotSize && deserialize_varint(snapshotData, snapshotSize, snapshotIdx, infoSize)){
+			if(infoSize > static_cast<uint32_t>(snapshotSize - snapshotIdx)){
+				break;
+			}
+
+			Ref<EntityInfo> entityInfo;
+			entityInfo.instantiate();
+			if(entityInfo->deserialize_info(snapshotData + snapshotIdx, infoSize)){
+				builder.add_entity(entityInfo);
+			}
+			snapshotIdx += infoSize;
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+	for(const KeyValue<EntityNetworkID_t, Ref<EntityInfo>> &entity : m_entitiesInZone){
+		capture_entity_state(entity.value);
+		builder.add_entity(entity.value);
+	}
+}
+
+//Call this from the tick thread. Queues an update for every player in the zone, tickInterval being the
+//number of ticks between sends of the update (neighbouring players only get every n-th send).
+void Zone::SERVER_SIDE_broadcast_update(const EntityUpdateInfo_t &updateInfo, int tickInterval) {
+	if(m_playersInZone.is_empty()){
+		return;
+	}
+
+	uint64_t sendCount = GDNet::singleton->world->SERVER_SIDE_get_tick() / tickInterval;
+
+	//Updates too big for a shared frame go out to each player on their own
+	if(!StateFrameBuilder::fits_in_frame(updateInfo.payloadSize)){
+		for(const KeyValue<PlayerID_t, Ref<PlayerInfo>> &player : m_playersInZone){
+			if(player.value->is_zone_relevant(m_zoneId, sendCount)){
+				GDNet::singleton->world->queue_entity_update(player.value->get_player_conn(), updateInfo);
+			}
+		}
+		return;
+	}
+
+	bool includeNeighbors = sendCount % GDNet::singleton->world->get_neighbor_zone_update_interval() == 0;
+	GDNet::singleton->world->queue_zone_broadcast(updateInfo, includeNeighbors);
+}
+
+//Call this on the tick thread
+void Zone::SERVER_SIDE_headless_tick() {
+	std::lock_guard<std::mutex> lock(m_headlessMutex);
+
+	EntityUpdateInfo_t updateInfo;
+	updateInfo.parentZone = m_zoneId;
+
+	//Relay each record to the zone at its module's rate, the same way the module would if it was instantiated
+	for(HeadlessEntity_t &record : m_headlessEntities){
+		record.tickCount %= record.tickInterval;
+
+		if(record.tickCount == 0){
+			updateInfo.networkId = record.networkId;
+			updateInfo.updateType = record.updateType;
+			updateInfo.authorityEpoch = record.authorityEpoch;
+			updateInfo.payload = record.payload;
+			updateInfo.payloadSize = record.payloadSize;
+
+			SERVER_SIDE_broadcast_update(updateInfo, record.tickInterval);
+		}
+
+		record.tickCount++;
+	}
+}
+
+//Call this on the main thread. Writes the network ids of the entities that were inside the shape (in world space) at the given
+//server time (in microseconds) into results and returns how many there were (never more than maxResults). Doesnt allocate.
+int Zone::SERVER_SIDE_rewind_query(SteamNetworkingMicroseconds time, const RewindShape_t &shape, EntityNetworkID_t *results, int maxResults) const {
+	const RewindFrame_t *frame = find_rewind_frame(time);
+	if(!frame){
+		return 0;
+	}
+
+	int resultCount = 0;
+	for(const RewindEntry_t &entry : frame->entries){
+		if(resultCount >= maxResults){
+			break;
+		}
+
+		Vector3 localPosition = shape.inverseTransform.xform(entry.position);
+		bool inside = shape.box ? Math::abs(localPosition.x) <= shape.halfExtents.x && Math::abs(localPosition.y) <= shape.halfExtents.y && Math::abs(localPosition.z) <= shape.halfExtents.z
+				: localPosition.length_squared() <= shape.radius * shape.radius;
+		if(inside){
+			results[resultCount++] = entry.networkId;
+		}
+	}
+
+	return resultCount;
+}
+
+//Script friendly rewind query. Supports SphereShape3D and BoxShape3D, the shape transform is in world space. The time is a server time in seconds, usually the
+//World.get_server_time() the shooting client sent along, minus how far behind it was rendering the other entities.
+PackedInt32Array Zone::rewind_query(double serverTime, const Ref<Shape3D> &shape, const Transform3D &shapeTransform) const {
+	PackedInt32Array hits;
+
+	RewindShape_t rewindShape{};
+	rewindShape.inverseTransform = shapeTransform.affine_inverse();
+	Ref<SphereShape3D> sphere = shape;
+	Ref<BoxShape3D> box = shape;
+	if(sphere.is_valid()){
+		rewindShape.radius = sphere->get_radius();
+	}else if(box.is_valid()){
+		rewindShape.halfExtents = box->get_size() * 0.5f;
+		rewindShape.box = true;
+	}else{
+		ERR_FAIL_V_MSG(hits, "Rewind queries only support SphereShape3D and BoxShape3D shapes!");
+	}
+
+	SteamNetworkingMicroseconds time = static_cast<SteamNetworkingMicroseconds>(serverTime * 1000000.0);
+	const RewindFrame_t *frame = find_rewind_frame(time);
+	if(!frame){
+		return hits;
+	}
+
+	hits.resize(frame->entries.size());
+	hits.resize(SERVER_SIDE_rewind_query(time, rewindShape, reinterpret_cast<EntityNetworkID_t *>(hits.ptrw()), hits.size()));
+	return hits;
+}
+
+//Script friendly rewind query for 2D zones. Supports CircleShape2D and RectangleShape2D, the shape transform is in world space.
+//Takes the same time as rewind_query.
+PackedInt32Array Zone::rewind_query_2d(double serverTime, const Ref<Shape2D> &shape, const Transform2D &shapeTransform) const {
+	PackedInt32Array hits;
+
+	//Lift the 2D transform into 3D, positions of 2D entities sit on the z = 0 plane
+	Transform3D shapeTransform3D(Basis(Vector3(shapeTransform.columns[0].x, shapeTransform.columns[0].y, 0.0f), Vector3(shapeTransform.columns[1].x, shapeTransform.columns[1].y, 0.0f), Vector3(0.0f, 0.0f, 1.0f)),
+			Vector3(shapeTransform.columns[2].x, shapeTransform.columns[2].y, 0.0f));
+
+	RewindShape_t rewindShape{};
+	rewindShape.inverseTransform = shapeTransform3D.affine_inverse();
+	Ref<CircleShape2D> circle = shape;
+	Ref<RectangleShape2D> rectangle = shape;
+	if(circle.is_valid()){
+		rewindShape.radius = circle->get_radius();
+	}else if(rectangle.is_valid()){
+		Vector2 halfSize = rectangle->get_size() * 0.5f;
+		rewindShape.halfExtents = Vector3(halfSize.x, halfSize.y, 0.0f);
+		rewindShape.box = true;
+	}else{
+		ERR_FAIL_V_MSG(hits, "2D rewind queries only support CircleShape2D and RectangleShape2D shapes!");
+	}
+
+	SteamNetworkingMicroseconds time = static_cast<SteamNetworkingMicroseconds>(serverTime * 1000000.0);
+	const RewindFrame_t *frame = find_rewind_frame(time);
+	if(!frame){
+		return hits;
+	}
+
+	hits.resize(frame->entries.size());
+	hits.resize(SERVER_SIDE_rewind_query(time, rewindShape, reinterpret_cast<EntityNetworkID_t *>(hits.ptrw()), hits.size()));
+	return hits;
+}
 
 Ref<PackedScene> Zone::get_zone_scene() const {
 	return m_zoneScene;
 }
 
+String Zone::get_zone_scene_path() const {
+	return m_zoneScenePath;
+}
+
 Ref<PlayerInfo> Zone::get_player(PlayerID_t playerId) const {
 	if(m_playersInZone.has(playerId)){
 		return m_playersInZone.get(playerId);
@@ -314,15 +1218,116 @@ Ref<PlayerInfo> Zone::get_player(PlayerID_t playerId) const {
 	}
 }
 
+//Safe to call from any thread. The returned reference keeps the entity info alive even if it gets destroyed right after.
+Ref<EntityInfo> Zone::get_entity(EntityNetworkID_t networkId) {
+	std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+	Ref<EntityInfo> *entityInfo = m_entitiesInZone.getptr(networkId);
+	return entityInfo ? *entityInfo : Ref<EntityInfo>();
+}
+
+//Safe to call from any thread. Reads the owner and authority epoch of an entity as one consistent pair.
+bool Zone::get_entity_authority(EntityNetworkID_t networkId, PlayerID_t &owner, uint8_t &authorityEpoch) {
+	std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+	Ref<EntityInfo> *entityInfo = m_entitiesInZone.getptr(networkId);
+	if(!entityInfo){
+		return false;
+	}
+
+	owner = (*entityInfo)->m_entityInfo.owner;
+	authorityEpoch = (*entityInfo)->m_entityInfo.authorityEpoch;
+	return true;
+}
+
+//Safe to call from any thread. Copies every entity in the zone out, so they can be gone through without holding the lock.
+void Zone::get_entities(LocalVector<Ref<EntityInfo>> &entities) {
+	std::lock_guard<std::mutex> lock(m_entityQueueMutex);
+	entities.reserve(entities.size() + m_entitiesInZone.size());
+	for(const KeyValue<EntityNetworkID_t, Ref<EntityInfo>> &entity : m_entitiesInZone){
+		entities.push_back(entity.value);
+	}
+}
+
 ZoneID_t Zone::get_zone_id() const {
 	return m_zoneId;
 }
 
+int Zone::get_spawn_budget_usec() const {
+	return m_spawnBudgetUsec;
+}
+
+bool Zone::get_server_logic() const {
+	return m_serverLogic;
+}
+
+float Zone::get_hibernation_delay() const {
+	return m_hibernationDelay;
+}
+
+float Zone::get_rewind_history_duration() const {
+	return m_rewindHistoryDuration;
+}
+
 
 void Zone::set_zone_scene(const Ref<PackedScene> &zoneScene) {
 	m_zoneScene = zoneScene;
+	m_zoneSceneFromPath = false;
+}
+
+void Zone::set_zone_scene_path(const String &zoneScenePath) {
+	m_zoneScenePath = zoneScenePath;
 }
 
 void Zone::set_zone_id(const ZoneID_t zoneId) {
 	m_zoneId = zoneId;
 }
+
+void Zone::set_spawn_budget_usec(int spawnBudgetUsec) {
+	m_spawnBudgetUsec = MAX(spawnBudgetUsec, 0);
+}
+
+void Zone::set_server_logic(bool serverLogic) {
+	m_serverLogic = serverLogic;
+}
+
+void Zone::set_hibernation_delay(float hibernationDelay) {
+	m_hibernationDelay = MAX(hibernationDelay, 0.0f);
+}
+
+//Call this on the main thread
+void Zone::set_rewind_history_duration(float duration) {
+	m_rewindHistoryDuration = MAX(duration, 0.0f);
+
+	//The ring gets resized to the new duration on the next physics frame
+	m_rewindFrames.clear();
+	m_rewindHead = 0;
+	m_rewindFrameCount = 0;
+}
+
+//Same as NetworkEntity::register_rpc, the order methods get registered in has to match on every peer
+bool Zone::register_rpc(const StringName &method, bool reliable) {
+	ERR_FAIL_COND_V_MSG(!m_rpcTable.register_method(method, reliable), false, vformat("\"%s\" is already registered as an rpc with a different reliability!", method));
+	return true;
+}
+
+const RpcTable &Zone::get_rpc_table() const {
+	return m_rpcTable;
+}
+
+
+Error Zone::_rpc_server_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+	StringName method;
+	if(!RpcTable::get_call_method(p_args, p_argcount, r_error, method)){
+		return ERR_INVALID_PARAMETER;
+	}
+
+	return GDNet::singleton->world->send_rpc(RPC_TARGET_SERVER, this, nullptr, method, p_args + 1, p_argcount - 1);
+}
+
+Error Zone::_rpc_zone_bind(const Variant **p_args, int p_argcount, Callable::CallError &r_error) {
+	StringName method;
+	if(!RpcTable::get_call_method(p_args, p_argcount, r_error, method)){
+		return ERR_INVALID_PARAMETER;
+	}
+
+	return GDNet::singleton->world->send_rpc(RPC_TARGET_ZONE, this, nullptr, method, p_args + 1, p_argcount - 1);
+}